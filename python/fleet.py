@@ -0,0 +1,672 @@
+#!/usr/bin/env python
+#
+# Fleet-scale LoRa channel simulator for the host build of the modem firmware
+#
+# The simulator spawns N instances of the firmware built with `make host`,
+# activates them in ABP mode over the AT command interface, and has each
+# instance send periodic uplinks. The emulated radios do not send their
+# transmissions to each other. Instead, they send them to the simulator
+# (LORA_MODEM_ETHER_TX) which plays the role of a single gateway. A channel
+# model decides which transmissions the gateway receives, taking into account
+# path loss, channel overlap, spreading factor (SF) orthogonality, and the
+# capture effect. Uplinks received by the gateway are relayed to the ether
+# multicast group (LORA_MODEM_ETHER) with RSSI and SNR rewritten, so that a
+# network server stand-in listening on the group can respond with downlinks.
+#
+# At the end, the simulator reports packet delivery ratio (PDR), airtime
+# utilisation, and radio transmit energy per delivered payload byte.
+#
+# The simulator runs in wall-clock time since the instances cannot share a
+# virtual clock. Each idle instance costs very little CPU time, so fleets of
+# 1000+ instances can be simulated on a single Linux machine. Make sure that
+# the limit on the number of open files (ulimit -n) and the number of
+# pseudo-terminals (/proc/sys/kernel/pty/max) are large enough.
+#
+# Licensed under the Revised BSD License, see LICENSE for full details.
+
+from __future__ import annotations
+import os
+import sys
+import math
+import time
+import heapq
+import random
+import signal
+import socket
+import struct
+import resource
+import selectors
+import subprocess
+import tempfile
+import binascii
+import tty
+from dataclasses import dataclass
+from collections import defaultdict
+from typing import Callable, Dict, List, Optional, Tuple
+
+import click
+from tabulate import tabulate
+
+
+# The header of the datagrams exchanged by the emulated radios, see the
+# description of the datagram format in src/host/radio.c.
+HEADER = struct.Struct('<IIIBBBBhbbH')
+FLAG_IQ_INVERTED = 1 << 0
+FLAG_CRC         = 1 << 1
+FLAG_FIX_LEN     = 1 << 2
+FLAG_RELAYED     = 1 << 4
+
+MODEM_FSK  = 0
+MODEM_LORA = 1
+
+BANDWIDTH = {0: 125000, 1: 250000, 2: 500000}
+
+# Minimum SNR [dB] required to demodulate a LoRa packet with the given spreading
+# factor (SX1276 datasheet, section 4.1.1.3)
+SNR_THRESHOLD = {6: -5, 7: -7.5, 8: -10, 9: -12.5, 10: -15, 11: -17.5, 12: -20}
+
+# Signal-to-interference ratio [dB] required for a packet with the spreading
+# factor given by the row to survive an interferer with the spreading factor
+# given by the column. Packets with different spreading factors are only
+# quasi-orthogonal. The diagonal (same SF) is replaced with the capture
+# threshold. Source: Croce et al., Impact of LoRa Imperfect Orthogonality:
+# Analysis of Link-Level Performance, IEEE Communications Letters, 2018.
+SIR_THRESHOLD = {
+    7:  {7:   0, 8:  -8, 9:  -9, 10:  -9, 11:  -9, 12:  -9},
+    8:  {7: -11, 8:   0, 9: -11, 10: -12, 11: -13, 12: -13},
+    9:  {7: -15, 8: -13, 9:   0, 10: -13, 11: -14, 12: -15},
+    10: {7: -19, 8: -18, 9: -17, 10:   0, 11: -17, 12: -18},
+    11: {7: -22, 8: -22, 9: -21, 10: -20, 11:   0, 12: -20},
+    12: {7: -25, 8: -25, 9: -25, 10: -24, 11: -23, 12:   0}
+}
+
+# Noise figure of the gateway receiver [dB]
+NOISE_FIGURE = 6
+
+# Supply current [mA] of the SX1276 transmitting at the given RF output power
+# [dBm] (SX1276 datasheet, section 2.5.5), and supply voltage [V]
+TX_CURRENT = ((2, 24), (5, 25), (8, 25), (11, 32), (14, 44), (17, 87), (20, 120))
+SUPPLY_VOLTAGE = 3.3
+
+# LoRaWAN message types (MHDR bits 7..5)
+MTYPE_UNCONFIRMED_UP = 2
+MTYPE_CONFIRMED_UP   = 4
+
+
+def time_on_air(bandwidth: int, sf: int, cr: int, preamble: int, fix_len: bool, size: int, crc: bool) -> float:
+    '''Return the time on air of a LoRa packet in seconds.
+
+    This is the same calculation as in the SX1276 driver (SX1276GetTimeOnAir)
+    and the emulated radio of the host build.
+    '''
+    if sf in (5, 6) and preamble < 12:
+        preamble = 12
+
+    low_dr_optimize = (bandwidth == 0 and sf in (11, 12)) or (bandwidth == 1 and sf == 12)
+
+    num = (size << 3) + (16 if crc else 0) - 4 * sf
+    if sf <= 6:
+        denom = 4 * sf
+    else:
+        num += 8
+        denom = 4 * (sf - 2) if low_dr_optimize else 4 * sf
+
+    if not fix_len:
+        num += 20
+    num = max(num, 0)
+
+    symbols = ((num + denom - 1) // denom) * (cr + 4) + preamble + 12
+    if sf <= 6:
+        symbols += 2
+
+    return (4 * symbols + 1) * (1 << (sf - 2)) / BANDWIDTH[bandwidth]
+
+
+def noise_floor(bandwidth: int) -> float:
+    return -174 + 10 * math.log10(BANDWIDTH[bandwidth]) + NOISE_FIGURE
+
+
+def tx_current(power: int) -> float:
+    current = TX_CURRENT[0][1]
+    for p, i in TX_CURRENT:
+        if power >= p:
+            current = i
+    return current
+
+
+@dataclass
+class Frame:
+    '''A datagram received from an emulated radio'''
+    sender: int
+    freq: int
+    datarate: int
+    modem: int
+    bandwidth: int
+    coderate: int
+    flags: int
+    rssi: int
+    snr: int
+    power: int
+    preamble: int
+    payload: bytes
+
+    @staticmethod
+    def parse(data: bytes) -> Optional['Frame']:
+        if len(data) < HEADER.size:
+            return None
+        return Frame(*HEADER.unpack_from(data), payload=data[HEADER.size:])
+
+    def pack(self) -> bytes:
+        return HEADER.pack(self.sender, self.freq, self.datarate, self.modem,
+            self.bandwidth, self.coderate, self.flags, self.rssi, self.snr,
+            self.power, self.preamble) + self.payload
+
+    @property
+    def time_on_air(self) -> float:
+        return time_on_air(self.bandwidth, self.datarate, self.coderate,
+            self.preamble, bool(self.flags & FLAG_FIX_LEN), len(self.payload),
+            bool(self.flags & FLAG_CRC))
+
+    @property
+    def uplink(self) -> bool:
+        return not (self.flags & FLAG_IQ_INVERTED)
+
+    def data_frame(self) -> Optional[Tuple[int, int, int]]:
+        '''Return (DevAddr, FCnt, FRMPayload size) of a data uplink'''
+        if len(self.payload) < 12:
+            return None
+        mtype = self.payload[0] >> 5
+        if mtype not in (MTYPE_UNCONFIRMED_UP, MTYPE_CONFIRMED_UP):
+            return None
+        devaddr, fctrl, fcnt = struct.unpack_from('<IBH', self.payload, 1)
+        # MHDR, DevAddr, FCtrl, FCnt, FOpts, MIC
+        overhead = 1 + 7 + (fctrl & 0x0f) + 4
+        # FPort, if present
+        size = len(self.payload) - overhead
+        if size > 0:
+            size -= 1
+        return devaddr, fcnt, size
+
+
+@dataclass
+class Transmission:
+    frame: Frame
+    node: Optional['Node']
+    start: float
+    end: float
+    rssi: float
+
+
+class ChannelModel:
+    '''A single gateway receiving transmissions from nodes in a disk
+
+    Path loss follows the log-distance model with log-normal shadowing. A
+    transmission is received if its SNR is above the demodulation threshold of
+    its spreading factor and if, for each spreading factor, the combined power
+    of all transmissions that overlap it in time on the same channel is below
+    the SIR threshold.
+    '''
+    def __init__(self, rng: random.Random, exponent: float, pl0: float, d0: float, sigma: float, capture: float):
+        self.rng = rng
+        self.exponent = exponent
+        self.pl0 = pl0
+        self.d0 = d0
+        self.sigma = sigma
+        self.capture = capture
+
+    def path_loss(self, distance: float) -> float:
+        loss = self.pl0 + 10 * self.exponent * math.log10(max(distance, self.d0) / self.d0)
+        if self.sigma > 0:
+            loss += self.rng.gauss(0, self.sigma)
+        return loss
+
+    def snr(self, tx: Transmission) -> float:
+        return tx.rssi - noise_floor(tx.frame.bandwidth)
+
+    def sir_threshold(self, sf: int, interferer_sf: int) -> float:
+        if sf == interferer_sf:
+            return self.capture
+        try:
+            return SIR_THRESHOLD[sf][interferer_sf]
+        except KeyError:
+            return self.capture
+
+    def evaluate(self, tx: Transmission, others: List[Transmission]) -> Optional[str]:
+        '''Return None if tx was received or the reason why it was lost'''
+        sf = tx.frame.datarate
+        if self.snr(tx) < SNR_THRESHOLD.get(sf, 0):
+            return 'sensitivity'
+
+        interference: Dict[int, float] = defaultdict(float)
+        for o in others:
+            if o is tx or o.frame.freq != tx.frame.freq:
+                continue
+            if o.start >= tx.end or o.end <= tx.start:
+                continue
+            interference[o.frame.datarate] += 10 ** (o.rssi / 10)
+
+        for isf, power in interference.items():
+            if tx.rssi - 10 * math.log10(power) < self.sir_threshold(sf, isf):
+                return 'collision'
+        return None
+
+
+class Node:
+    '''One instance of the host build of the firmware'''
+    def __init__(self, sim: 'Simulator', index: int):
+        self.sim = sim
+        self.index = index
+        self.devaddr = sim.netid_prefix | index
+        self.distance = sim.radius * math.sqrt(sim.rng.random())
+
+        self.eeprom = os.path.join(sim.workdir, f'node{index}.bin')
+        self.pty = os.path.join(sim.workdir, f'node{index}.pty')
+        self.log = os.path.join(sim.workdir, f'node{index}.log')
+
+        self.process: Optional[subprocess.Popen] = None
+        self.fd = -1
+        self.rx = b''
+        self.commands: List[Tuple[bytes, Optional[Callable[[str], None]]]] = []
+        self.pending: Optional[Callable[[str], None]] = None
+        self.ready = False
+        self.waiting_for_boot = False
+
+        self.offered = 0
+        self.accepted = 0
+        self.rejected = 0
+        self.busy = 0
+        self.acks = 0
+        self.noacks = 0
+
+    def spawn(self):
+        env = dict(os.environ)
+        env.update({
+            'LORA_MODEM_EEPROM'  : self.eeprom,
+            'LORA_MODEM_PTY'     : self.pty,
+            'LORA_MODEM_ID'      : f'{self.index + 1:016x}',
+            'LORA_MODEM_ETHER'   : self.sim.group,
+            'LORA_MODEM_ETHER_TX': f'127.0.0.1:{self.sim.port}'
+        })
+        with open(self.log, 'wb') as log:
+            self.process = subprocess.Popen([self.sim.firmware], env=env,
+                stdin=subprocess.DEVNULL, stdout=log, stderr=log,
+                start_new_session=True)
+
+    def open(self) -> bool:
+        if self.fd >= 0:
+            return True
+        if not os.path.exists(self.pty):
+            return False
+        self.fd = os.open(self.pty, os.O_RDWR | os.O_NOCTTY | os.O_NONBLOCK)
+        tty.setraw(self.fd)
+        self.sim.sel.register(self.fd, selectors.EVENT_READ, self)
+        return True
+
+    def kill(self):
+        if self.fd >= 0:
+            self.sim.sel.unregister(self.fd)
+            os.close(self.fd)
+            self.fd = -1
+        if self.process is not None and self.process.poll() is None:
+            self.process.terminate()
+
+    def AT(self, cmd: str, payload: bytes = b'', callback: Optional[Callable[[str], None]] = None):
+        self.commands.append((b'AT' + cmd.encode('ascii') + b'\r' + payload, callback))
+        self.pump()
+
+    def pump(self):
+        if self.pending is not None or self.waiting_for_boot or not self.commands:
+            return
+        data, callback = self.commands.pop(0)
+        self.pending = callback or (lambda r: None)
+        try:
+            os.write(self.fd, data)
+        except BlockingIOError:
+            # The pseudo-terminal buffer is large enough for a single command,
+            # this should not happen
+            self.pending = None
+            self.commands.insert(0, (data, callback))
+
+    def configure(self):
+        s = self.sim
+
+        def check(response: str):
+            if not response.startswith('+OK'):
+                raise Exception(f'Node {self.index}: Unexpected response {response}')
+
+        def band(response: str):
+            if response != f'+OK={s.band}':
+                self.AT(f'+BAND={s.band}', callback=check)
+                self.waiting_for_boot = True
+            self.AT(f'+DEVADDR={self.devaddr:08X}', callback=check)
+            self.AT(f'+NWKSKEY={s.nwkskey}', callback=check)
+            self.AT(f'+APPSKEY={s.appskey}', callback=check)
+            self.AT('+MODE=0', callback=check)
+            self.AT('+DFORMAT=1', callback=check)
+            self.AT(f'+ADR={int(s.adr)}', callback=check)
+            if s.dr is not None:
+                self.AT(f'+DR={s.dr}', callback=check)
+            self.AT(f'+REP={s.rep}', callback=check)
+            self.AT(f'+RTYNUM={s.rtynum}', callback=check)
+            self.AT(f'+DUTYCYCLE={int(s.dutycycle)}', callback=check)
+            self.AT('', callback=done)
+
+        def done(response: str):
+            self.ready = True
+
+        self.AT('+BAND?', callback=band)
+
+    def uplink(self):
+        self.offered += 1
+        if not self.ready or self.pending is not None or self.commands:
+            self.busy += 1
+            return
+
+        def result(response: str):
+            if response.startswith('+OK'):
+                self.accepted += 1
+            else:
+                self.rejected += 1
+
+        data = self.sim.rng.randbytes(self.sim.size)
+        cmd = '+CTX' if self.sim.confirmed else '+UTX'
+        self.AT(f'{cmd} {len(data)}', binascii.hexlify(data), callback=result)
+
+    def on_readable(self):
+        try:
+            data = os.read(self.fd, 4096)
+        except BlockingIOError:
+            return
+        except OSError:
+            data = b''
+
+        if not data:
+            self.sim.sel.unregister(self.fd)
+            os.close(self.fd)
+            self.fd = -1
+            return
+
+        self.rx += data
+        while b'\r\n' in self.rx:
+            line, self.rx = self.rx.split(b'\r\n', 1)
+            if line:
+                self.on_line(line.decode('ascii', errors='replace'))
+
+    def on_line(self, line: str):
+        if line.startswith('+OK') or line.startswith('+ERR'):
+            callback, self.pending = self.pending, None
+            if callback is not None:
+                callback(line)
+        elif line == '+EVENT=0,0':
+            self.waiting_for_boot = False
+        elif line == '+ACK':
+            self.acks += 1
+        elif line == '+NOACK':
+            self.noacks += 1
+        self.pump()
+
+
+class Simulator:
+    def __init__(self, firmware: str, workdir: str, rng: random.Random, model: ChannelModel,
+            group: str, port: int, radius: float, band: int, adr: bool,
+            dr: Optional[int], rep: int, rtynum: int, confirmed: bool,
+            dutycycle: bool, size: int, nwkskey: str, appskey: str):
+        self.firmware = firmware
+        self.workdir = workdir
+        self.rng = rng
+        self.model = model
+        self.group = group
+        self.port = port
+        self.radius = radius
+        self.band = band
+        self.adr = adr
+        self.dr = dr
+        self.rep = rep
+        self.rtynum = rtynum
+        self.confirmed = confirmed
+        self.dutycycle = dutycycle
+        self.size = size
+        self.nwkskey = nwkskey
+        self.appskey = appskey
+        self.netid_prefix = 0x26000000
+
+        self.sel = selectors.DefaultSelector()
+        self.timers: List[Tuple[float, int, Callable[[], None]]] = []
+        self.seq = 0
+        self.nodes: List[Node] = []
+        self.by_devaddr: Dict[int, Node] = {}
+
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.bind(('127.0.0.1', port))
+        self.sock.setblocking(False)
+        self.sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF, socket.inet_aton('127.0.0.1'))
+        self.sel.register(self.sock, selectors.EVENT_READ, None)
+
+        addr, _, gport = group.partition(':')
+        self.group_addr = (addr, int(gport or 4321))
+
+        self.on_air: List[Transmission] = []
+        self.max_toa = 0.0
+        self.lost: Dict[str, int] = defaultdict(int)
+        self.transmissions = 0
+        self.airtime: Dict[int, float] = defaultdict(float)
+        self.energy = 0.0
+        self.sent: set = set()
+        self.delivered: set = set()
+        self.delivered_bytes = 0
+
+    def at(self, delay: float, fn: Callable[[], None]):
+        self.seq += 1
+        heapq.heappush(self.timers, (time.monotonic() + delay, self.seq, fn))
+
+    def loop(self, until: Callable[[], bool], deadline: float):
+        while not until() and time.monotonic() < deadline:
+            timeout = deadline - time.monotonic()
+            if self.timers:
+                timeout = min(timeout, self.timers[0][0] - time.monotonic())
+            for key, _ in self.sel.select(max(timeout, 0)):
+                if key.data is None:
+                    self.on_datagrams()
+                else:
+                    key.data.on_readable()
+            now = time.monotonic()
+            while self.timers and self.timers[0][0] <= now:
+                heapq.heappop(self.timers)[2]()
+
+    def on_datagrams(self):
+        while True:
+            try:
+                data = self.sock.recv(4096)
+            except BlockingIOError:
+                return
+            frame = Frame.parse(data)
+            if frame is not None and frame.modem == MODEM_LORA and frame.uplink:
+                self.on_frame(frame)
+
+    def on_frame(self, frame: Frame):
+        now = time.monotonic()
+        toa = frame.time_on_air
+        info = frame.data_frame()
+        node = self.by_devaddr.get(info[0]) if info else None
+        distance = node.distance if node else self.radius / 2
+
+        tx = Transmission(frame, node, now, now + toa, frame.power - self.model.path_loss(distance))
+        self.on_air.append(tx)
+        self.max_toa = max(self.max_toa, toa)
+
+        self.transmissions += 1
+        self.airtime[frame.freq] += toa
+        self.energy += toa * tx_current(frame.power) / 1000 * SUPPLY_VOLTAGE
+        if info is not None:
+            self.sent.add(info[:2])
+
+        self.at(toa, lambda: self.on_frame_end(tx))
+
+    def on_frame_end(self, tx: Transmission):
+        reason = self.model.evaluate(tx, self.on_air)
+
+        # Forget transmissions that can no longer overlap with any transmission
+        # still on the air
+        horizon = time.monotonic() - 2 * self.max_toa
+        self.on_air = [t for t in self.on_air if t.end > horizon]
+
+        if reason is not None:
+            self.lost[reason] += 1
+            return
+
+        info = tx.frame.data_frame()
+        if info is not None and info[:2] not in self.delivered:
+            self.delivered.add(info[:2])
+            self.delivered_bytes += info[2]
+
+        # Relay the received uplink to the ether group so that a network
+        # server listening there can process it
+        tx.frame.flags |= FLAG_RELAYED
+        tx.frame.rssi = int(round(tx.rssi))
+        tx.frame.snr = max(-128, min(127, int(round(self.model.snr(tx)))))
+        self.sock.sendto(tx.frame.pack(), self.group_addr)
+
+    def start(self, n: int, timeout: float):
+        soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+        if soft < hard:
+            resource.setrlimit(resource.RLIMIT_NOFILE, (hard, hard))
+
+        for i in range(n):
+            node = Node(self, i)
+            self.nodes.append(node)
+            self.by_devaddr[node.devaddr] = node
+            node.spawn()
+
+        deadline = time.monotonic() + timeout
+        pending = list(self.nodes)
+        while pending and time.monotonic() < deadline:
+            pending = [node for node in pending if not node.open()]
+            time.sleep(0.01)
+        if pending:
+            raise Exception(f'{len(pending)} node(s) did not start, see logs in {self.workdir}')
+
+        for node in self.nodes:
+            node.configure()
+        self.loop(lambda: all(node.ready for node in self.nodes), time.monotonic() + timeout)
+        ready = sum(node.ready for node in self.nodes)
+        if ready != n:
+            raise Exception(f'Only {ready} of {n} nodes could be configured')
+
+    def run(self, duration: float, period: float, poisson: bool, drain: float):
+        def schedule(node: Node, delay: float):
+            def fire():
+                node.uplink()
+                schedule(node, self.rng.expovariate(1 / period) if poisson else period)
+            if time.monotonic() + delay < stop:
+                self.at(delay, fire)
+
+        start = time.monotonic()
+        stop = start + duration
+        for node in self.nodes:
+            schedule(node, self.rng.uniform(0, period))
+
+        self.loop(lambda: False, stop + drain)
+        return time.monotonic() - start
+
+    def stop(self):
+        for node in self.nodes:
+            node.kill()
+        for node in self.nodes:
+            if node.process is not None:
+                try:
+                    node.process.wait(timeout=5)
+                except subprocess.TimeoutExpired:
+                    node.process.kill()
+
+    def report(self, elapsed: float):
+        offered = sum(n.offered for n in self.nodes)
+        accepted = sum(n.accepted for n in self.nodes)
+        delivered = len(self.delivered)
+
+        rows = [
+            ('Nodes', len(self.nodes)),
+            ('Elapsed time', f'{elapsed:.1f} s'),
+            ('Uplinks offered by application', offered),
+            ('Uplinks rejected by modem', sum(n.rejected for n in self.nodes)),
+            ('Uplinks skipped (modem busy)', sum(n.busy for n in self.nodes)),
+            ('Uplinks accepted by modem', accepted),
+            ('Unique uplinks transmitted', len(self.sent)),
+            ('Transmissions (incl. repetitions)', self.transmissions),
+            ('Lost below sensitivity', self.lost['sensitivity']),
+            ('Lost in collisions', self.lost['collision']),
+            ('Unique uplinks delivered', delivered),
+            ('PDR', f'{100 * delivered / accepted:.2f} %' if accepted else '-'),
+            ('Delivered payload', f'{self.delivered_bytes} B'),
+            ('TX energy', f'{self.energy:.3f} J'),
+            ('TX energy per delivered byte', f'{1000 * self.energy / self.delivered_bytes:.3f} mJ/B' if self.delivered_bytes else '-'),
+        ]
+        if self.confirmed:
+            rows.append(('Confirmed uplinks ACKed', sum(n.acks for n in self.nodes)))
+            rows.append(('Confirmed uplinks not ACKed', sum(n.noacks for n in self.nodes)))
+        print(tabulate(rows, tablefmt='grid'))
+
+        channels = [(f'{freq / 1e6:.3f} MHz', f'{t:.2f} s', f'{100 * t / elapsed:.2f} %')
+            for freq, t in sorted(self.airtime.items())]
+        total = sum(self.airtime.values())
+        channels.append(('All', f'{total:.2f} s', f'{100 * total / elapsed / max(len(self.airtime), 1):.2f} %'))
+        print(tabulate(channels, headers=['Channel', 'Airtime', 'Utilisation'], tablefmt='grid'))
+
+
+@click.command()
+@click.option('--firmware', '-f', default='./firmware-host', show_default=True, help='Host build of the firmware (make host)')
+@click.option('--nodes', '-n', default=10, show_default=True, help='Number of modem instances')
+@click.option('--duration', '-d', default=600.0, show_default=True, help='Duration of the traffic phase [s]')
+@click.option('--drain', default=30.0, show_default=True, help='Time to wait for retransmissions after the traffic phase [s]')
+@click.option('--period', '-p', default=60.0, show_default=True, help='Mean uplink period of each node [s]')
+@click.option('--poisson/--periodic', default=True, show_default=True, help='Exponential or fixed uplink intervals')
+@click.option('--size', '-s', default=10, show_default=True, help='Uplink payload size [B]')
+@click.option('--confirmed/--unconfirmed', default=False, show_default=True, help='Send confirmed uplinks (requires a network server)')
+@click.option('--rep', default=1, show_default=True, help='Unconfirmed uplink repetitions (AT+REP)')
+@click.option('--rtynum', default=8, show_default=True, help='Confirmed uplink retries (AT+RTYNUM)')
+@click.option('--adr/--no-adr', default=False, show_default=True, help='Adaptive data rate (AT+ADR)')
+@click.option('--dr', type=int, default=None, help='Data rate (AT+DR)')
+@click.option('--band', default=5, show_default=True, help='Region (AT+BAND), 5 is EU868')
+@click.option('--dutycycle/--no-dutycycle', default=True, show_default=True, help='Duty cycle restrictions (AT+DUTYCYCLE)')
+@click.option('--radius', default=2000.0, show_default=True, help='Radius of the disk with nodes around the gateway [m]')
+@click.option('--exponent', default=2.32, show_default=True, help='Path loss exponent')
+@click.option('--pl0', default=128.95, show_default=True, help='Path loss at the reference distance [dB]')
+@click.option('--d0', default=1000.0, show_default=True, help='Reference distance [m]')
+@click.option('--sigma', default=7.8, show_default=True, help='Standard deviation of shadowing [dB]')
+@click.option('--capture', default=6.0, show_default=True, help='Capture threshold for equal spreading factors [dB]')
+@click.option('--nwkskey', default='2B7E151628AED2A6ABF7158809CF4F3C', show_default=True, help='NwkSKey of all nodes (AT+NWKSKEY)')
+@click.option('--appskey', default='2B7E151628AED2A6ABF7158809CF4F3C', show_default=True, help='AppSKey of all nodes (AT+APPSKEY)')
+@click.option('--group', default='239.76.82.1:4321', show_default=True, help='Ether multicast group (LORA_MODEM_ETHER)')
+@click.option('--port', default=4322, show_default=True, help='UDP port of the channel model (LORA_MODEM_ETHER_TX)')
+@click.option('--workdir', '-w', default=None, help='Directory for EEPROM images, pseudo-terminal links, and logs')
+@click.option('--seed', default=None, type=int, help='Random number generator seed')
+@click.option('--startup-timeout', default=60.0, show_default=True, help='Time limit for starting and configuring the nodes [s]')
+def cli(firmware, nodes, duration, drain, period, poisson, size, confirmed, rep, rtynum, adr, dr, band,
+        dutycycle, radius, exponent, pl0, d0, sigma, capture, nwkskey, appskey, group, port, workdir, seed, startup_timeout):
+    '''Simulate a fleet of modems sharing a LoRa gateway.
+
+    The default path loss parameters are those of the LoRaSim model (Bor et
+    al., Do LoRa Low-Power Wide-Area Networks Scale?, MSWiM 2016).
+    '''
+    rng = random.Random(seed)
+    if workdir is None:
+        workdir = tempfile.mkdtemp(prefix='lora-fleet-')
+    else:
+        os.makedirs(workdir, exist_ok=True)
+
+    model = ChannelModel(rng, exponent, pl0, d0, sigma, capture)
+    sim = Simulator(os.path.abspath(firmware), workdir, rng, model, group, port, radius, band,
+        adr, dr, rep, rtynum, confirmed, dutycycle, size, nwkskey, appskey)
+
+    signal.signal(signal.SIGTERM, lambda *_: sys.exit(1))
+    try:
+        click.echo(f'Starting {nodes} node(s) in {workdir}...', err=True)
+        sim.start(nodes, startup_timeout)
+        click.echo(f'Running traffic for {duration} s...', err=True)
+        elapsed = sim.run(duration, period, poisson, drain)
+    finally:
+        sim.stop()
+    sim.report(elapsed)
+
+
+if __name__ == '__main__':
+    cli()
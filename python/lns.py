@@ -0,0 +1,691 @@
+#!/usr/bin/env python
+#
+# A minimal LoRaWAN network server stand-in for the host build of the firmware
+#
+# The server listens on the UDP multicast group shared by the emulated radios
+# of the host build (LORA_MODEM_ETHER), either directly or behind the channel
+# model of fleet.py, and answers uplinks with downlinks transmitted in the RX1
+# window. It implements just enough of LoRaWAN 1.0.4 and 1.1 to exercise the
+# network-facing code paths of the firmware end-to-end without a live network:
+#
+#   - OTAA JoinRequest / JoinAccept (1.0.4, and 1.1 with OptNeg set)
+#   - ABP sessions for a fixed set of session keys
+#   - acknowledgements of confirmed uplinks
+#   - LinkCheckReq / LinkCheckAns
+#   - DeviceTimeReq / DeviceTimeAns
+#   - LinkADRReq / LinkADRAns driven by a simple ADR algorithm
+#   - RekeyInd / RekeyConf and ResetInd / ResetConf (1.1)
+#
+# Only the EU868 region with its three default channels is supported. All
+# events are written to standard output as JSON objects, one per line, with a
+# timestamp, so that join latency, acknowledgement round-trip time, or ADR
+# convergence time can be computed by a test script.
+#
+# The server needs AES-128. To keep the tool free of dependencies on native
+# crypto libraries, a small pure-Python implementation is included below. It
+# is slow, but more than fast enough for the traffic of emulated modems.
+#
+# Licensed under the Revised BSD License, see LICENSE for full details.
+
+from __future__ import annotations
+import sys
+import json
+import time
+import heapq
+import random
+import socket
+import struct
+import selectors
+from dataclasses import dataclass, field
+from typing import Callable, Dict, List, Optional, Tuple
+
+import click
+
+
+################################################################################
+# AES-128 and AES-CMAC (FIPS-197, RFC 4493)                                    #
+################################################################################
+
+def _xtime(a: int) -> int:
+    a <<= 1
+    return (a ^ 0x11b) if a & 0x100 else a
+
+
+def _mul(a: int, b: int) -> int:
+    r = 0
+    while b:
+        if b & 1:
+            r ^= a
+        a = _xtime(a)
+        b >>= 1
+    return r
+
+
+def _make_sbox() -> Tuple[List[int], List[int]]:
+    sbox = [0] * 256
+    inv = [0] * 256
+    for x in range(256):
+        # Multiplicative inverse in GF(2^8) followed by the affine transform
+        y = next((c for c in range(1, 256) if _mul(x, c) == 1), 0) if x else 0
+        s = y
+        for i in range(1, 5):
+            s ^= ((y << i) | (y >> (8 - i))) & 0xff
+        s ^= 0x63
+        sbox[x] = s
+        inv[s] = x
+    return sbox, inv
+
+
+SBOX, INV_SBOX = _make_sbox()
+
+
+class AES:
+    '''AES-128 block cipher'''
+
+    def __init__(self, key: bytes):
+        if len(key) != 16:
+            raise ValueError('AES-128 key must be 16 bytes long')
+
+        w = [list(key[i:i + 4]) for i in range(0, 16, 4)]
+        rcon = 1
+        for i in range(4, 44):
+            t = list(w[i - 1])
+            if i % 4 == 0:
+                t = [SBOX[b] for b in t[1:] + t[:1]]
+                t[0] ^= rcon
+                rcon = _xtime(rcon)
+            w.append([a ^ b for a, b in zip(w[i - 4], t)])
+        self.round_keys = [sum(w[r * 4:r * 4 + 4], []) for r in range(11)]
+
+    @staticmethod
+    def _add(s: List[int], k: List[int]) -> List[int]:
+        return [a ^ b for a, b in zip(s, k)]
+
+    @staticmethod
+    def _shift(s: List[int], d: int) -> List[int]:
+        # The state is stored column by column; row r is rotated by r*d columns
+        return [s[((c + r * d) % 4) * 4 + r] for c in range(4) for r in range(4)]
+
+    @staticmethod
+    def _mix(s: List[int], m: Tuple[int, int, int, int]) -> List[int]:
+        out = []
+        for c in range(4):
+            col = s[c * 4:c * 4 + 4]
+            for r in range(4):
+                v = 0
+                for i in range(4):
+                    v ^= _mul(col[i], m[(i - r) % 4])
+                out.append(v)
+        return out
+
+    def encrypt(self, block: bytes) -> bytes:
+        s = self._add(list(block), self.round_keys[0])
+        for r in range(1, 11):
+            s = self._shift([SBOX[b] for b in s], 1)
+            if r != 10:
+                s = self._mix(s, (2, 3, 1, 1))
+            s = self._add(s, self.round_keys[r])
+        return bytes(s)
+
+    def decrypt(self, block: bytes) -> bytes:
+        s = self._add(list(block), self.round_keys[10])
+        for r in range(9, -1, -1):
+            s = [INV_SBOX[b] for b in self._shift(s, -1)]
+            s = self._add(s, self.round_keys[r])
+            if r != 0:
+                s = self._mix(s, (14, 11, 13, 9))
+        return bytes(s)
+
+
+def aes_encrypt(key: bytes, block: bytes) -> bytes:
+    return AES(key).encrypt(block)
+
+
+def aes_cmac(key: bytes, msg: bytes) -> bytes:
+    cipher = AES(key)
+
+    def shift(b: bytes) -> bytes:
+        v = int.from_bytes(b, 'big') << 1
+        if b[0] & 0x80:
+            v ^= 0x87
+        return (v & ((1 << 128) - 1)).to_bytes(16, 'big')
+
+    k1 = shift(cipher.encrypt(bytes(16)))
+    k2 = shift(k1)
+
+    n = max((len(msg) + 15) // 16, 1)
+    last = msg[(n - 1) * 16:]
+    if len(last) == 16:
+        last = bytes(a ^ b for a, b in zip(last, k1))
+    else:
+        last = last + b'\x80' + bytes(15 - len(last))
+        last = bytes(a ^ b for a, b in zip(last, k2))
+
+    x = bytes(16)
+    for i in range(n - 1):
+        x = cipher.encrypt(bytes(a ^ b for a, b in zip(x, msg[i * 16:i * 16 + 16])))
+    return cipher.encrypt(bytes(a ^ b for a, b in zip(x, last)))
+
+
+################################################################################
+# Radio ether and EU868 regional parameters                                    #
+################################################################################
+
+# The header of the datagrams exchanged by the emulated radios, see the
+# description of the datagram format in src/host/radio.c.
+HEADER = struct.Struct('<IIIBBBBhbbH')
+FLAG_IQ_INVERTED = 1 << 0
+FLAG_CRC         = 1 << 1
+FLAG_FIX_LEN     = 1 << 2
+FLAG_PUBLIC      = 1 << 3
+FLAG_RELAYED     = 1 << 4
+
+MODEM_LORA = 1
+
+BANDWIDTH = {0: 125000, 1: 250000, 2: 500000}
+
+# EU868 data rates as (spreading factor, bandwidth index)
+EU868_DR = [(12, 0), (11, 0), (10, 0), (9, 0), (8, 0), (7, 0), (7, 1)]
+EU868_CHANNELS = [868100000, 868300000, 868500000]
+EU868_MAX_TX_POWER = 7
+EU868_MAX_DR = 5
+
+# Minimum SNR [dB] required to demodulate a packet with the given spreading
+# factor (SX1276 datasheet, section 4.1.1.3)
+SNR_THRESHOLD = {7: -7.5, 8: -10, 9: -12.5, 10: -15, 11: -17.5, 12: -20}
+
+RECEIVE_DELAY1 = 1
+JOIN_ACCEPT_DELAY1 = 5
+
+GPS_EPOCH = 315964800
+LEAP_SECONDS = 18
+
+
+def time_on_air(bandwidth: int, sf: int, cr: int, preamble: int, fix_len: bool, size: int, crc: bool) -> float:
+    '''Return the time on air of a LoRa packet in seconds (see fleet.py)'''
+    low_dr_optimize = (bandwidth == 0 and sf in (11, 12)) or (bandwidth == 1 and sf == 12)
+    num = (size << 3) + (16 if crc else 0) - 4 * sf + 8 + (0 if fix_len else 20)
+    denom = 4 * (sf - 2) if low_dr_optimize else 4 * sf
+    symbols = ((max(num, 0) + denom - 1) // denom) * (cr + 4) + preamble + 12
+    return (4 * symbols + 1) * (1 << (sf - 2)) / BANDWIDTH[bandwidth]
+
+
+################################################################################
+# LoRaWAN MAC                                                                  #
+################################################################################
+
+MTYPE_JOIN_REQUEST     = 0
+MTYPE_JOIN_ACCEPT      = 1
+MTYPE_UNCONFIRMED_UP   = 2
+MTYPE_UNCONFIRMED_DOWN = 3
+MTYPE_CONFIRMED_UP     = 4
+
+CID_RESET         = 0x01
+CID_LINK_CHECK    = 0x02
+CID_LINK_ADR      = 0x03
+CID_DUTY_CYCLE    = 0x04
+CID_RX_PARAM      = 0x05
+CID_DEV_STATUS    = 0x06
+CID_NEW_CHANNEL   = 0x07
+CID_RX_TIMING     = 0x08
+CID_TX_PARAM      = 0x09
+CID_DL_CHANNEL    = 0x0a
+CID_REKEY         = 0x0b
+CID_ADR_PARAM     = 0x0c
+CID_DEVICE_TIME   = 0x0d
+CID_REJOIN_PARAM  = 0x0f
+
+# Length of the payload of uplink MAC commands (excluding CID)
+UPLINK_MAC_LENGTH = {
+    CID_RESET: 1, CID_LINK_CHECK: 0, CID_LINK_ADR: 1, CID_DUTY_CYCLE: 0,
+    CID_RX_PARAM: 1, CID_DEV_STATUS: 2, CID_NEW_CHANNEL: 1, CID_RX_TIMING: 0,
+    CID_TX_PARAM: 0, CID_DL_CHANNEL: 1, CID_REKEY: 1, CID_ADR_PARAM: 0,
+    CID_DEVICE_TIME: 0, CID_REJOIN_PARAM: 1
+}
+
+DIR_UP = 0
+DIR_DOWN = 1
+
+
+def b0(dir: int, devaddr: int, fcnt: int, length: int, conf_fcnt=0, tx_dr=0, tx_ch=0) -> bytes:
+    '''Return the B0 (or B1 in LoRaWAN 1.1) block for MIC calculation'''
+    return struct.pack('<BHBBBIIBB', 0x49, conf_fcnt, tx_dr, tx_ch, dir, devaddr, fcnt, 0, length)
+
+
+def encrypt_payload(key: bytes, dir: int, devaddr: int, fcnt: int, data: bytes, block4=0) -> bytes:
+    '''Encrypt or decrypt FRMPayload or FOpts (LoRaWAN 1.1 section 4.3.3)'''
+    cipher = AES(key)
+    out = bytearray()
+    for i in range(0, len(data), 16):
+        a = struct.pack('<BBHBBIIBB', 0x01, block4, 0, 0, dir, devaddr, fcnt, 0, i // 16 + 1)
+        s = cipher.encrypt(a)
+        out += bytes(x ^ y for x, y in zip(data[i:i + 16], s))
+    return bytes(out)
+
+
+def encrypt_fopts(key: bytes, dir: int, devaddr: int, fcnt: int, data: bytes, fcnt_id: int) -> bytes:
+    '''Encrypt or decrypt FOpts (LoRaWAN 1.1.1)
+
+    The A block uses the counter 0 and byte 4 identifies the frame counter:
+    0x01 for FCntUp and NFCntDown, 0x02 for AFCntDown.
+    '''
+    a = struct.pack('<BBHBBIIBB', 0x01, fcnt_id, 0, 0, dir, devaddr, fcnt, 0, 0x01)
+    s = aes_encrypt(key, a)
+    return bytes(x ^ y for x, y in zip(data, s))
+
+
+def derive(key: bytes, prefix: int, *parts: bytes) -> bytes:
+    block = bytes([prefix]) + b''.join(parts)
+    return aes_encrypt(key, block + bytes(16 - len(block)))
+
+
+@dataclass
+class Session:
+    devaddr: int
+    version: int                # 10 (LoRaWAN 1.0.x) or 11 (LoRaWAN 1.1)
+    fnwksintkey: bytes
+    snwksintkey: bytes
+    nwksenckey: bytes
+    appskey: bytes
+    deveui: Optional[bytes] = None
+    fcnt_up: int = -1
+    nfcnt_down: int = 0
+    afcnt_down: int = 0
+    rekeyed: bool = False
+    # ADR state
+    snr: List[float] = field(default_factory=list)
+    dr: int = 0
+    tx_power: int = 0
+    adr_pending: Optional[Tuple[int, int]] = None
+    mac: List[bytes] = field(default_factory=list)
+
+
+@dataclass
+class Device:
+    deveui: bytes
+    joineui: bytes
+    nwkkey: bytes
+    appkey: bytes
+    version: int
+    join_nonce: int = 0
+
+
+class Server:
+    def __init__(self, group: Tuple[str, int], netid: int, version: int,
+            nwkkey: Optional[bytes], appkey: Optional[bytes],
+            abp_nwkskey: Optional[bytes], abp_appskey: Optional[bytes],
+            adr_history: int, adr_margin: float):
+        self.group = group
+        self.netid = netid
+        self.version = version
+        self.nwkkey = nwkkey
+        self.appkey = appkey
+        self.abp_nwkskey = abp_nwkskey
+        self.abp_appskey = abp_appskey
+        self.adr_history = adr_history
+        self.adr_margin = adr_margin
+
+        self.devices: Dict[bytes, Device] = {}
+        self.sessions: Dict[int, Session] = {}
+        self.next_devaddr = (netid & 0x7f) << 25 | 1
+        self.sender = random.getrandbits(32)
+
+        self.timers: List[Tuple[float, int, Callable[[], None]]] = []
+        self.seq = 0
+
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.sock.bind(('', group[1]))
+        mreq = socket.inet_aton(group[0]) + socket.inet_aton('127.0.0.1')
+        self.sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+        self.sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF, socket.inet_aton('127.0.0.1'))
+        self.sock.setblocking(False)
+
+        self.sel = selectors.DefaultSelector()
+        self.sel.register(self.sock, selectors.EVENT_READ)
+
+    def event(self, name: str, **kwargs):
+        kwargs = {k: (v.hex().upper() if isinstance(v, bytes) else v) for k, v in kwargs.items()}
+        print(json.dumps({'time': round(time.time(), 6), 'event': name, **kwargs}), flush=True)
+
+    def add_device(self, deveui: bytes, joineui: bytes, nwkkey: bytes, appkey: bytes, version: int):
+        self.devices[deveui] = Device(deveui, joineui, nwkkey, appkey, version)
+
+    def at(self, when: float, fn: Callable[[], None]):
+        self.seq += 1
+        heapq.heappush(self.timers, (when, self.seq, fn))
+
+    def run(self):
+        while True:
+            timeout = None
+            if self.timers:
+                timeout = max(self.timers[0][0] - time.monotonic(), 0)
+            for _ in self.sel.select(timeout):
+                self.on_datagrams()
+            now = time.monotonic()
+            while self.timers and self.timers[0][0] <= now:
+                heapq.heappop(self.timers)[2]()
+
+    def on_datagrams(self):
+        while True:
+            try:
+                data = self.sock.recv(4096)
+            except BlockingIOError:
+                return
+            now = time.monotonic()
+            if len(data) < HEADER.size:
+                continue
+            sender, freq, sf, modem, bw, cr, flags, rssi, snr, power, preamble = HEADER.unpack_from(data)
+            payload = data[HEADER.size:]
+            if sender == self.sender or modem != MODEM_LORA or flags & FLAG_IQ_INVERTED:
+                continue
+
+            # Relayed datagrams are sent when the transmission ends, all other
+            # datagrams when it starts
+            end = now
+            if not flags & FLAG_RELAYED:
+                end += time_on_air(bw, sf, cr, preamble, bool(flags & FLAG_FIX_LEN), len(payload), bool(flags & FLAG_CRC))
+
+            try:
+                dr = EU868_DR.index((sf, bw))
+            except ValueError:
+                continue
+            rx = Uplink(freq, dr, rssi, snr, bool(flags & FLAG_PUBLIC), end)
+
+            try:
+                self.on_uplink(rx, payload)
+            except Exception as e:
+                self.event('error', message=str(e))
+
+    def on_uplink(self, rx: 'Uplink', msg: bytes):
+        if len(msg) < 1:
+            return
+        mtype = msg[0] >> 5
+        if mtype == MTYPE_JOIN_REQUEST:
+            self.on_join_request(rx, msg)
+        elif mtype in (MTYPE_UNCONFIRMED_UP, MTYPE_CONFIRMED_UP):
+            self.on_data(rx, msg, mtype == MTYPE_CONFIRMED_UP)
+
+    def transmit(self, rx: 'Uplink', delay: float, payload: bytes):
+        sf, bw = EU868_DR[rx.dr]
+        flags = FLAG_IQ_INVERTED | (FLAG_PUBLIC if rx.public else 0)
+        data = HEADER.pack(self.sender, rx.freq, sf, MODEM_LORA, bw, 1, flags, -60, 10, 14, 8) + payload
+        self.at(rx.end + delay, lambda: self.sock.sendto(data, self.group))
+
+    def on_join_request(self, rx: 'Uplink', msg: bytes):
+        if len(msg) != 23:
+            return
+        joineui, deveui, devnonce = msg[1:9][::-1], msg[9:17][::-1], msg[17:19]
+        self.event('join_request', deveui=deveui, joineui=joineui, devnonce=struct.unpack('<H', devnonce)[0])
+
+        dev = self.devices.get(deveui)
+        if dev is None:
+            if self.nwkkey is None:
+                self.event('error', message='Unknown DevEUI', deveui=deveui)
+                return
+            self.add_device(deveui, joineui, self.nwkkey, self.appkey or self.nwkkey, self.version)
+            dev = self.devices[deveui]
+
+        if aes_cmac(dev.nwkkey, msg[:19])[:4] != msg[19:]:
+            self.event('error', message='Invalid JoinRequest MIC', deveui=deveui)
+            return
+
+        dev.join_nonce += 1
+        join_nonce = dev.join_nonce.to_bytes(3, 'little')
+        netid = self.netid.to_bytes(3, 'little')
+        devaddr = self.next_devaddr
+        self.next_devaddr += 1
+
+        opt_neg = dev.version == 11
+        # OptNeg, RX1DROffset 0, RX2 data rate DR0
+        dl_settings = 0x80 if opt_neg else 0x00
+        body = bytes([MTYPE_JOIN_ACCEPT << 5]) + join_nonce + netid + struct.pack('<IBB', devaddr, dl_settings, RECEIVE_DELAY1)
+
+        if opt_neg:
+            jsintkey = derive(dev.nwkkey, 0x06, deveui[::-1])
+            mic = aes_cmac(jsintkey, b'\xff' + joineui[::-1] + devnonce + body)[:4]
+            s = Session(devaddr, 11,
+                fnwksintkey=derive(dev.nwkkey, 0x01, join_nonce, joineui[::-1], devnonce),
+                snwksintkey=derive(dev.nwkkey, 0x03, join_nonce, joineui[::-1], devnonce),
+                nwksenckey=derive(dev.nwkkey, 0x04, join_nonce, joineui[::-1], devnonce),
+                appskey=derive(dev.appkey, 0x02, join_nonce, joineui[::-1], devnonce),
+                deveui=deveui)
+        else:
+            mic = aes_cmac(dev.nwkkey, body)[:4]
+            nwkskey = derive(dev.nwkkey, 0x01, join_nonce, netid, devnonce)
+            s = Session(devaddr, 10, nwkskey, nwkskey, nwkskey,
+                appskey=derive(dev.nwkkey, 0x02, join_nonce, netid, devnonce),
+                deveui=deveui)
+
+        s.dr = rx.dr
+        self.sessions[devaddr] = s
+
+        # The network server encrypts the JoinAccept with the AES decrypt
+        # operation so that the device only needs AES encrypt
+        plain = body[1:] + mic
+        cipher = AES(dev.nwkkey)
+        enc = b''.join(cipher.decrypt(plain[i:i + 16]) for i in range(0, len(plain), 16))
+        self.transmit(rx, JOIN_ACCEPT_DELAY1, body[:1] + enc)
+        self.event('join_accept', deveui=deveui, devaddr=f'{devaddr:08X}', version='1.1' if opt_neg else '1.0.4')
+
+    def abp_session(self, devaddr: int) -> Optional[Session]:
+        if self.abp_nwkskey is None:
+            return None
+        k = self.abp_nwkskey
+        s = Session(devaddr, 10, k, k, k, self.abp_appskey or k)
+        self.sessions[devaddr] = s
+        return s
+
+    def on_data(self, rx: 'Uplink', msg: bytes, confirmed: bool):
+        if len(msg) < 12:
+            return
+        devaddr, fctrl, fcnt16 = struct.unpack_from('<IBH', msg, 1)
+        fopts_len = fctrl & 0x0f
+        adr = bool(fctrl & 0x80)
+        adr_ack_req = bool(fctrl & 0x40)
+
+        s = self.sessions.get(devaddr) or self.abp_session(devaddr)
+        if s is None:
+            self.event('error', message='Unknown DevAddr', devaddr=f'{devaddr:08X}')
+            return
+
+        # Reconstruct the 32-bit frame counter
+        last = max(s.fcnt_up, 0)
+        fcnt = (last & ~0xffff) | fcnt16
+        if fcnt < last:
+            fcnt += 0x10000
+
+        body, mic = msg[:-4], msg[-4:]
+        cmacf = aes_cmac(s.fnwksintkey, b0(DIR_UP, devaddr, fcnt, len(body)) + body)
+        if s.version == 10:
+            expected = cmacf[:4]
+        else:
+            ch = EU868_CHANNELS.index(rx.freq) if rx.freq in EU868_CHANNELS else 0
+            cmacs = aes_cmac(s.snwksintkey, b0(DIR_UP, devaddr, fcnt, len(body), 0, rx.dr, ch) + body)
+            expected = cmacs[:2] + cmacf[:2]
+        if mic != expected:
+            self.event('error', message='Invalid MIC', devaddr=f'{devaddr:08X}', fcnt=fcnt)
+            return
+        s.fcnt_up = fcnt
+        s.dr = rx.dr
+
+        fopts = msg[8:8 + fopts_len]
+        if s.version == 11 and fopts:
+            fopts = encrypt_fopts(s.nwksenckey, DIR_UP, devaddr, fcnt, fopts, 0x01)
+
+        port = None
+        payload = b''
+        if len(body) > 8 + fopts_len:
+            port = body[8 + fopts_len]
+            payload = body[9 + fopts_len:]
+            key = s.nwksenckey if port == 0 else s.appskey
+            payload = encrypt_payload(key, DIR_UP, devaddr, fcnt, payload)
+
+        self.event('uplink', devaddr=f'{devaddr:08X}', fcnt=fcnt, port=port, size=len(payload),
+            confirmed=confirmed, adr=adr, dr=rx.dr, freq=rx.freq, rssi=rx.rssi, snr=rx.snr)
+
+        answers = self.on_mac(s, rx, payload if port == 0 else fopts)
+
+        if adr:
+            answers += self.adr(s, rx)
+
+        if confirmed or answers or adr_ack_req:
+            self.downlink(s, rx, fcnt if confirmed else None, answers[:15])
+
+    def on_mac(self, s: Session, rx: 'Uplink', data: bytes) -> bytes:
+        out = b''
+        i = 0
+        while i < len(data):
+            cid = data[i]
+            length = UPLINK_MAC_LENGTH.get(cid)
+            if length is None:
+                self.event('error', message=f'Unsupported MAC command {cid:#04x}', devaddr=f'{s.devaddr:08X}')
+                break
+            arg = data[i + 1:i + 1 + length]
+            i += 1 + length
+
+            if cid == CID_LINK_CHECK:
+                margin = max(0, int(rx.snr - SNR_THRESHOLD[EU868_DR[rx.dr][0]]))
+                out += bytes([CID_LINK_CHECK, min(margin, 254), 1])
+                self.event('link_check', devaddr=f'{s.devaddr:08X}', margin=margin)
+
+            elif cid == CID_DEVICE_TIME:
+                # The time at the end of the uplink transmission, in 1/256 s
+                t = time.time() - (time.monotonic() - rx.end) - GPS_EPOCH + LEAP_SECONDS
+                ticks = int(t * 256)
+                out += bytes([CID_DEVICE_TIME]) + struct.pack('<IB', ticks >> 8, ticks & 0xff)
+                self.event('device_time', devaddr=f'{s.devaddr:08X}', gps_time=round(t, 3))
+
+            elif cid == CID_LINK_ADR:
+                status = arg[0]
+                if s.adr_pending is not None:
+                    if status & 0x07 == 0x07:
+                        s.dr, s.tx_power = s.adr_pending
+                    self.event('link_adr_ans', devaddr=f'{s.devaddr:08X}', status=status,
+                        dr=s.adr_pending[0], tx_power=s.adr_pending[1])
+                    s.adr_pending = None
+
+            elif cid == CID_REKEY:
+                if not s.rekeyed:
+                    self.event('rekey', devaddr=f'{s.devaddr:08X}', version=arg[0])
+                s.rekeyed = True
+                out += bytes([CID_REKEY, 1])
+
+            elif cid == CID_RESET:
+                out += bytes([CID_RESET, 1])
+                s.nfcnt_down = s.afcnt_down = 0
+                self.event('reset', devaddr=f'{s.devaddr:08X}', version=arg[0])
+
+        return out
+
+    def adr(self, s: Session, rx: 'Uplink') -> bytes:
+        '''A simple ADR algorithm based on the maximum SNR of recent uplinks
+
+        Each 3 dB of link margin above the demodulation threshold and the
+        installation margin first increases the data rate and then decreases
+        the TX power by one step.
+        '''
+        if s.adr_pending is not None:
+            return b''
+
+        s.snr.append(rx.snr)
+        if len(s.snr) < self.adr_history:
+            return b''
+
+        margin = max(s.snr) - SNR_THRESHOLD[EU868_DR[s.dr][0]] - self.adr_margin
+        del s.snr[:]
+        steps = int(margin // 3)
+        dr, power = s.dr, s.tx_power
+        while steps > 0 and dr < EU868_MAX_DR:
+            dr += 1
+            steps -= 1
+        while steps > 0 and power < EU868_MAX_TX_POWER:
+            power += 1
+            steps -= 1
+        while steps < 0 and power > 0:
+            power -= 1
+            steps += 1
+
+        if (dr, power) == (s.dr, s.tx_power):
+            return b''
+
+        s.adr_pending = (dr, power)
+        self.event('link_adr_req', devaddr=f'{s.devaddr:08X}', dr=dr, tx_power=power)
+        # Enable the three default channels, NbTrans unchanged
+        return bytes([CID_LINK_ADR, dr << 4 | power]) + struct.pack('<HB', 0x0007, 0)
+
+    def downlink(self, s: Session, rx: 'Uplink', ack_fcnt: Optional[int], fopts: bytes):
+        devaddr = s.devaddr
+        fcnt = s.nfcnt_down
+        s.nfcnt_down += 1
+        self.event('downlink', devaddr=f'{devaddr:08X}', fcnt=fcnt, ack=ack_fcnt is not None, fopts=fopts)
+
+        if s.version == 11 and fopts:
+            fopts = encrypt_fopts(s.nwksenckey, DIR_DOWN, devaddr, fcnt, fopts, 0x01)
+
+        fctrl = 0x80 | (0x20 if ack_fcnt is not None else 0) | len(fopts)
+        body = bytes([MTYPE_UNCONFIRMED_DOWN << 5]) + struct.pack('<IBH', devaddr, fctrl, fcnt & 0xffff) + fopts
+
+        conf_fcnt = (ack_fcnt or 0) & 0xffff if s.version == 11 else 0
+        mic = aes_cmac(s.snwksintkey, b0(DIR_DOWN, devaddr, fcnt, len(body), conf_fcnt) + body)[:4]
+
+        self.transmit(rx, RECEIVE_DELAY1, body + mic)
+
+
+@dataclass
+class Uplink:
+    freq: int
+    dr: int
+    rssi: int
+    snr: int
+    public: bool
+    end: float
+
+
+def key(value: Optional[str]) -> Optional[bytes]:
+    if value is None:
+        return None
+    v = bytes.fromhex(value)
+    if len(v) != 16:
+        raise click.BadParameter('Key must be 16 bytes long')
+    return v
+
+
+@click.command()
+@click.option('--group', default='239.76.82.1:4321', show_default=True, help='Ether multicast group (LORA_MODEM_ETHER)')
+@click.option('--netid', default='000013', show_default=True, help='NetID (hexadecimal)')
+@click.option('--lorawan', type=click.Choice(['1.0.4', '1.1']), default='1.1', show_default=True, help='LoRaWAN version negotiated in JoinAccept')
+@click.option('--device', '-d', multiple=True, help='OTAA device DEVEUI:JOINEUI:NWKKEY[:APPKEY]; NWKKEY is the AppKey in 1.0')
+@click.option('--nwkkey', default=None, help='NwkKey (AppKey in 1.0) of any OTAA device not given with --device')
+@click.option('--appkey', default=None, help='AppKey (1.1) of any OTAA device not given with --device')
+@click.option('--abp-nwkskey', default=None, help='NwkSKey of any unknown DevAddr (LoRaWAN 1.0.x ABP)')
+@click.option('--abp-appskey', default=None, help='AppSKey of any unknown DevAddr (LoRaWAN 1.0.x ABP)')
+@click.option('--adr-history', default=20, show_default=True, help='Number of uplinks considered by ADR')
+@click.option('--adr-margin', default=10.0, show_default=True, help='ADR installation margin [dB]')
+def cli(group, netid, lorawan, device, nwkkey, appkey, abp_nwkskey, abp_appskey, adr_history, adr_margin):
+    '''Run a LoRaWAN network server stand-in for emulated modems.
+
+    The server writes one JSON object per event to standard output.
+    '''
+    addr, _, port = group.partition(':')
+    version = 11 if lorawan == '1.1' else 10
+    server = Server((addr, int(port or 4321)), int(netid, 16), version, key(nwkkey), key(appkey),
+        key(abp_nwkskey), key(abp_appskey), adr_history, adr_margin)
+
+    for d in device:
+        parts = d.split(':')
+        if len(parts) not in (3, 4):
+            raise click.BadParameter(f'Invalid device {d}')
+        nk = key(parts[2])
+        assert nk is not None
+        server.add_device(bytes.fromhex(parts[0]), bytes.fromhex(parts[1]), nk,
+            key(parts[3]) if len(parts) == 4 else nk, version)
+
+    try:
+        server.run()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    cli()
@@ -0,0 +1,211 @@
+#!/usr/bin/env python
+#
+# Decoder for the binary debugging log of the modem firmware (LOG_BINARY=1)
+#
+# In binary mode, the firmware does not format debugging messages. The format
+# strings are stored in the non-loaded ELF section .log_fmt and each message is
+# sent over the debugging USART (or Segger RTT) as a COBS-encoded record with a
+# CRC, carrying the offset of the format string in .log_fmt, a timestamp, and
+# raw argument values. This tool reads the format strings from the firmware ELF
+# file and turns the records back into the same text the firmware would have
+# produced with LOG_BINARY=0. See src/debug/log.c for the record layout.
+#
+# Examples:
+#   python logdec.py out/debug/firmware.elf -p /dev/ttyUSB1
+#   python logdec.py out/debug/firmware.elf < capture.bin
+#
+# The ELF file must come from the same build as the firmware running on the
+# modem, otherwise the messages will be garbled.
+#
+# Licensed under the Revised BSD License, see LICENSE for full details.
+
+from __future__ import annotations
+import re
+import sys
+import struct
+import click
+from typing import BinaryIO, Iterator, Tuple
+from lora import cobs_decode, crc16
+
+
+NO_HEADER = 0x01
+NO_EOL    = 0x02
+TS_ABS    = 0x04
+TS_REL    = 0x08
+TRUNCATED = 0x10
+
+DUMP_WIDTH = 8
+
+conversion = re.compile(r'%(?P<flags>[-+ #0]*)(?P<width>\*|\d+)?(?:\.(?P<prec>\*|\d*))?(?P<length>hh|h|ll|l|j|z|t|L)?(?P<conv>[diouxXeEfFgGaAcsp%])')
+
+
+def load_formats(filename: str) -> Tuple[bytes, int]:
+    '''Return the contents and the address of the .log_fmt section'''
+    with open(filename, 'rb') as f:
+        elf = f.read()
+
+    if elf[:4] != b'\x7fELF':
+        raise ValueError(f'{filename} is not an ELF file')
+
+    e = '<' if elf[5] == 1 else '>'
+    if elf[4] == 1:
+        shoff, = struct.unpack_from(f'{e}I', elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(f'{e}HHH', elf, 0x2e)
+        section = lambda i: struct.unpack_from(f'{e}IIIIII', elf, shoff + i * shentsize)
+    else:
+        shoff, = struct.unpack_from(f'{e}Q', elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(f'{e}HHH', elf, 0x3a)
+        section = lambda i: struct.unpack_from(f'{e}IIQQQQ', elf, shoff + i * shentsize)
+
+    strtab = section(shstrndx)
+    for i in range(shnum):
+        name, _, _, addr, offset, size = section(i)
+        start = strtab[4] + name
+        if elf[start:elf.index(b'\0', start)] == b'.log_fmt':
+            return elf[offset:offset + size], addr
+
+    raise ValueError(f'{filename} has no .log_fmt section, was it built with LOG_BINARY=1?')
+
+
+class Record:
+    def __init__(self, data: bytes):
+        self.data = data
+        self.offset = 0
+
+    def take(self, fmt: str):
+        rv = struct.unpack_from(f'<{fmt}', self.data, self.offset)
+        self.offset += struct.calcsize(fmt)
+        return rv[0]
+
+    def string(self) -> str:
+        end = self.data.index(b'\0', self.offset)
+        rv = self.data[self.offset:end].decode('utf-8', errors='replace')
+        self.offset = end + 1
+        return rv
+
+
+def render(format: str, record: Record) -> str:
+    '''Substitute arguments from the record into a printf-style format string'''
+    def replace(m: re.Match) -> str:
+        conv = m['conv']
+        if conv == '%':
+            return '%'
+
+        width, prec = m['width'] or '', m['prec']
+        if width == '*':
+            width = str(record.take('i'))
+        if prec == '*':
+            prec = str(record.take('i'))
+        spec = '%' + m['flags'] + width + (f'.{prec}' if prec is not None else '')
+
+        if conv == 's':
+            return (spec + 's') % record.string()
+        if conv in 'eEfFgGaA':
+            return (spec + ('f' if conv in 'aA' else conv)) % record.take('d')
+        if conv == 'p':
+            return '0x%x' % record.take('I')
+
+        signed = conv in 'di'
+        if m['length'] == 'll':
+            value = record.take('q' if signed else 'Q')
+        else:
+            value = record.take('i' if signed else 'I')
+
+        if conv == 'c':
+            return (spec + 'c') % chr(value & 0xff)
+        return (spec + ('d' if conv in 'diu' else conv)) % value
+
+    try:
+        return conversion.sub(replace, format)
+    except (struct.error, ValueError):
+        return format + ' <missing arguments>'
+
+
+def hexdump(prefix: str, data: bytes) -> Iterator[str]:
+    for position in range(0, len(data), DUMP_WIDTH):
+        line = data[position:position + DUMP_WIDTH]
+        cells = ['%02X ' % b for b in line] + ['   '] * (DUMP_WIDTH - len(line))
+        cells.insert(DUMP_WIDTH // 2, '| ')
+        text = ''.join(chr(b) if 32 <= b <= 126 else '.' for b in line)
+        yield f'{prefix}{position:3d}: {"".join(cells)} {text:{DUMP_WIDTH}}\r\n'
+
+
+def decode(formats: bytes, base: int, frame: bytes) -> str:
+    if len(frame) < 6 or crc16(frame[:-2]) != struct.unpack('<H', frame[-2:])[0]:
+        return '# <?> Corrupted record\r\n'
+
+    record = Record(frame[:-2])
+    id = chr(record.take('B'))
+    flags = record.take('B')
+    address = record.take('H')
+    offset = (address - base) & 0xffff
+
+    # Records that only terminate a composite message carry no format string
+    if address == 0:
+        format = ''
+    elif offset >= len(formats):
+        return f'# <?> Unknown format string {offset}\r\n'
+    else:
+        format = formats[offset:formats.index(b'\0', offset)].decode('utf-8', errors='replace')
+
+    prefix = ''
+    if not flags & NO_HEADER:
+        if flags & (TS_ABS | TS_REL):
+            ts = record.take('I') // 10
+            prefix = '# %s%d.%02d <%s> ' % ('+' if flags & TS_REL else '', ts // 100, ts % 100, id)
+        else:
+            prefix = f'# <{id}> '
+
+    rv = prefix + render(format, record)
+    if flags & TRUNCATED:
+        rv += '...'
+    if not flags & NO_EOL:
+        rv += '\r\n'
+
+    if id == 'X' and not flags & TRUNCATED:
+        length = record.take('H')
+        rv += ''.join(hexdump(prefix, record.data[record.offset:record.offset + length]))
+    return rv
+
+
+def frames(input: BinaryIO) -> Iterator[bytes]:
+    buffer = bytearray()
+    while True:
+        data = input.read(1)
+        if not data:
+            break
+        if data[0] != 0:
+            buffer += data
+            continue
+        if buffer:
+            try:
+                yield cobs_decode(bytes(buffer))
+            except ValueError:
+                yield b''
+            buffer.clear()
+
+
+@click.command()
+@click.argument('elf', type=click.Path(exists=True, dir_okay=False))
+@click.option('--port', '-p', help='Read the log from a serial port rather than standard input')
+@click.option('--baudrate', '-b', default=115200, show_default=True, help='Serial port baud rate')
+def cli(elf, port, baudrate):
+    '''Decode the binary debugging log of the modem firmware.
+
+    ELF is the firmware file from the build running on the modem.
+    '''
+    formats, base = load_formats(elf)
+
+    if port is not None:
+        import serial
+        input = serial.Serial(port, baudrate)
+    else:
+        input = sys.stdin.buffer
+
+    for frame in frames(input):
+        sys.stdout.write(decode(formats, base, frame))
+        sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    cli()
@@ -34,6 +34,7 @@ import sys
 import re
 import serial
 import binascii
+import struct
 import select
 from abc import ABC
 from functools import lru_cache
@@ -93,8 +94,30 @@ class NetworkEventSubtype(Enum):
 EventSubtype = Union[ModuleEventSubtype, JoinEventSubtype, NetworkEventSubtype]
 
 
+# Events recorded in the modem's post-mortem log (see src/pmlog.h)
+@unique
+class PostMortemEvent(Enum):
+    BOOT            = 1
+    JOIN            = 2
+    MLME_CONFIRM    = 3
+    MCPS_CONFIRM    = 4
+    MCPS_INDICATION = 5
+    NVM_WRITE       = 6
+    UART_OVERRUN    = 7
+    HALT            = 8
+
+
+# Reset flags recorded with PostMortemEvent.BOOT (RCC_CSR bits 24-31)
+RESET_FLAGS = ['FW', 'OBL', 'PIN', 'POR', 'SOFT', 'IWDG', 'WWDG', 'LPWR']
+
+
 UARTConfig = namedtuple('UARTConfig', 'baudrate data_bits stop_bits parity flow_control')
+UARTStats = namedtuple('UARTStats', 'rx_bytes tx_bytes rx_lost framing_errors noise_errors parity_errors rx_fifo_high tx_fifo_high tx_blocked wakeups tx_bursts tx_dma_starts overrun_errors')
+NVMStats = namedtuple('NVMStats', 'written uplink uplink_max')
 RFConfig   = namedtuple('RFConfig',   'id frequency min_dr max_dr')
+LogModuleConfig = namedtuple('LogModuleConfig', 'level burst interval')
+PostMortemEntry = namedtuple('PostMortemEntry', 'time event arg value')
+PostMortemLog   = namedtuple('PostMortemLog',   'count entries halt_message')
 Delay      = namedtuple('Delay',      'join_accept_1 join_accept_2 rx_window_1 rx_window_2')
 McastAddr  = namedtuple('McastAddr',  'id addr nwkskey appskey')
 
@@ -133,13 +156,13 @@ class ModemError(Exception):
 
 
 class UnknownCommand(ModemError):
-    def __init__(self, message):
-        super().__init__(message, -1)
+    def __init__(self, message, errno=-1):
+        super().__init__(message, errno)
 
 
 class AccessDenied(ModemError):
-    def __init__(self, message):
-        super().__init__(message, -50)
+    def __init__(self, message, errno=-50):
+        super().__init__(message, errno)
 
 
 modem_error_classes = {
@@ -194,6 +217,18 @@ class MissingValue(Exception):
         super().__init__(message)
 
 
+class RecordedCommand(BaseException):
+    '''Raised by TypeABZ.AT in recording mode instead of sending the command.
+
+    The class derives from BaseException so that it passes through generic
+    exception handlers in the property implementations.
+    '''
+    def __init__(self, cmd: str, batchable: bool):
+        super().__init__(cmd)
+        self.cmd = cmd
+        self.batchable = batchable
+
+
 class JoinFailed(Exception):
     def __init__(self, message):
         super().__init__(message)
@@ -404,6 +439,22 @@ class LogLevel(Enum):
         return self.name.lower()
 
 
+# Firmware log modules (log_module_t in src/debug/log.h)
+@unique
+class LogModule(Enum):
+    DEFAULT = 0
+    ATCI    = 1
+    LPUART  = 2
+    NVM     = 3
+    PART    = 4
+    RADIO   = 5
+    LORAMAC = 6
+    ADC     = 7
+
+    def __str__(self):
+        return self.name.lower()
+
+
 @unique
 class DataFormat(Enum):
     BINARY = 0
@@ -428,12 +479,96 @@ class EventSubscription(EventEmitter):
             raise TimeoutError('Timed out')
 
 
+class FrameType(Enum):
+    '''Frame types of the binary framed mode (see src/frame.h)'''
+    COMMAND  = 0x01
+    DATA     = 0x02
+    EXIT     = 0x03
+    RESPONSE = 0x81
+    PARTIAL  = 0x82
+    EVENT    = 0x83
+    MESSAGE  = 0x84
+    NAK      = 0x8f
+
+
+class FrameTag(Enum):
+    TEXT = 0x01
+    DATA = 0x02
+    PORT = 0x03
+
+
+def crc16(data: bytes) -> int:
+    '''CRC-16/CCITT-FALSE'''
+    crc = 0xffff
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021 if crc & 0x8000 else crc << 1) & 0xffff
+    return crc
+
+
+def cobs_encode(data: bytes) -> bytes:
+    rv = bytearray()
+    block = bytearray()
+    for b in data:
+        if b == 0:
+            rv += bytes([len(block) + 1]) + block
+            block = bytearray()
+        else:
+            block.append(b)
+            if len(block) == 254:
+                rv += b'\xff' + block
+                block = bytearray()
+    rv += bytes([len(block) + 1]) + block
+    return bytes(rv)
+
+
+def cobs_decode(data: bytes) -> bytes:
+    rv = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError('Malformed COBS block')
+        rv += data[i + 1:i + code]
+        i += code
+        if code != 0xff and i < len(data):
+            rv.append(0)
+    return bytes(rv)
+
+
+def encode_frame(type: FrameType, seq: int, *tlvs: Tuple[FrameTag, bytes]) -> bytes:
+    frame = bytes([type.value, seq & 0xff])
+    for tag, value in tlvs:
+        if len(value) > 255:
+            raise ValueError('TLV value too long')
+        frame += bytes([tag.value, len(value)]) + value
+    frame += crc16(frame).to_bytes(2, 'little')
+    return cobs_encode(frame) + b'\0'
+
+
+def decode_frame(data: bytes) -> "Tuple[FrameType, int, dict[FrameTag, bytes]]":
+    frame = cobs_decode(data)
+    if len(frame) < 4 or crc16(frame[:-2]) != int.from_bytes(frame[-2:], 'little'):
+        raise ValueError('Frame CRC error')
+
+    tlvs: "dict[FrameTag, bytes]" = {}
+    i = 2
+    while i + 2 <= len(frame) - 2:
+        tag, length = frame[i], frame[i + 1]
+        # Silently skip tags unknown to this version
+        if tag in FrameTag._value2member_map_:
+            tlvs[FrameTag(tag)] = frame[i + 2:i + 2 + length]
+        i += 2 + length
+    return FrameType(frame[0]), frame[1], tlvs
+
+
 class TypeABZ:
     port: Optional[serial.Serial]
     subscriptions: Set[EventSubscription]
     prev_at: datetime | None
 
-    def __init__(self, pathname: str, verbose: bool = False, guard: Optional[float] = None, rts: bool | None = None, dtr: bool | None = None):
+    def __init__(self, pathname: str, verbose: bool = False, guard: Optional[float] = None, rts: bool | None = None, dtr: bool | None = None, rtscts: bool = False):
         self.pathname = pathname
         self.verbose = verbose
         self.hide_value = False
@@ -443,6 +578,15 @@ class TypeABZ:
         self.prev_at = None
         self.rts = rts
         self.dtr = dtr
+        self.rtscts = rtscts
+        self.cache: "dict[str, Union[bytes, None, Exception]]" = {}
+        self.recording: Optional[List[str]] = None
+        self.framed = False
+        self.switching = False
+        self.seq = 0
+        self.discard = 0
+        self.next_tag = 0
+        self.pending: "dict[int, Queue[bytes]]" = {}
 
     def __str__(self):
         return self.pathname
@@ -467,7 +611,7 @@ class TypeABZ:
             self.subscriptions.remove(sub)
             sub.off_all()
 
-    def detect_baud_rate(self, speeds=[9600, 19200, 38400, 4800], response=b'+OK\r', timeout=0.3) -> Optional[int]:
+    def detect_baud_rate(self, speeds=[9600, 19200, 38400, 4800, 115200, 57600, 230400], response=b'+OK\r', timeout=0.3) -> Optional[int]:
         if self.port is not None:
             raise Exception('Baudrate detection must be performed before the device is open')
 
@@ -535,9 +679,10 @@ class TypeABZ:
         # Open the port and configure reads to be non-blocking so that we can
         # specify a different timeout in different read requests.
         self.speed = speed
-        self.port = serial.Serial(self.pathname, speed, timeout=0)
+        self.port = serial.Serial(self.pathname, speed, timeout=0, rtscts=self.rtscts)
 
-        if self.rts is not None:
+        # With hardware flow control, the RTS signal is controlled by the driver
+        if self.rts is not None and not self.rtscts:
             self.port.rts = self.rts
 
         if self.dtr is not None:
@@ -573,20 +718,86 @@ class TypeABZ:
                 return line
             line += c
 
+    def read_frame(self) -> bytes:
+        assert self.port is not None
+
+        frame: bytes = b''
+        while True:
+            select.select([self.port.fd], [], [])
+            c = self.port.read()
+            if len(c) == 0:
+                raise Exception('No data')
+
+            # Skip the remainder of the text response that switched the modem
+            # into framed mode
+            if self.discard and c in b'\r\n':
+                self.discard -= 1
+                continue
+            self.discard = 0
+
+            if c == b'\0':
+                if len(frame) == 0:
+                    continue
+                return frame
+            frame += c
+
+    def print_received(self, data: bytes):
+        if self.hide_value:
+            msg = re.sub(b'^(.*)([= ]).+$', b'\\1\\2<redacted>', data)
+        else:
+            msg = data
+        print(f'> {msg.decode("ascii", errors="replace")}')
+
+    def receive_frame(self, data: bytes):
+        type, seq, tlvs = decode_frame(data)
+
+        if type == FrameType.MESSAGE:
+            port, payload = tlvs[FrameTag.PORT][0], tlvs.get(FrameTag.DATA, b'')
+            if self.verbose:
+                print(f'> [{seq}] message port={port} length={len(payload)}')
+            self.emit('message', port, payload)
+        elif type == FrameType.NAK:
+            if self.verbose:
+                print(f'> [{seq}] NAK')
+            self.response.put_nowait(b'+NAK')
+        else:
+            for line in tlvs.get(FrameTag.TEXT, b'').split(b'\r\n'):
+                if len(line) == 0:
+                    continue
+                if self.verbose:
+                    self.print_received(line)
+                self.receive(line)
+
+            # The modem leaves framed mode after it has responded to the exit
+            # frame
+            if self.switching and type == FrameType.RESPONSE:
+                self.framed = False
+                self.switching = False
+
     def reader(self):
         try:
             while True:
                 try:
-                    data = self.read_line()
+                    data = self.read_frame() if self.framed else self.read_line()
                 except:
                     break
 
+                if self.framed:
+                    try:
+                        self.receive_frame(data)
+                    except Exception as error:
+                        print(f'Ignoring invalid frame: {error}')
+                    continue
+
                 if self.verbose:
-                    if self.hide_value:
-                        msg = re.sub(b'^(.*)([= ]).+$', b'\\1\\2<redacted>', data)
-                    else:
-                        msg = data
-                    print(f'> {msg.decode("ascii", errors="replace")}')
+                    self.print_received(data)
+
+                # The modem switches to framed mode right after it has sent the
+                # response to AT$FRAMED
+                if self.switching and data == b'+OK':
+                    self.framed = True
+                    self.switching = False
+                    self.discard = 2
 
                 try:
                     self.receive(data)
@@ -596,6 +807,33 @@ class TypeABZ:
             if self.verbose:
                 print('Terminating reader thread')
 
+    def enter_framed(self):
+        '''Switch the AT command interface into binary framed mode.
+
+        In framed mode, AT commands and their responses, asynchronous events,
+        and payloads are exchanged in COBS-encoded frames protected with a CRC.
+        Payloads are always sent and received in binary form, regardless of
+        the data format configured with AT+DFORMAT. Only supported by the open
+        firmware.
+        '''
+        with self.lock:
+            self.switching = True
+            try:
+                self.AT('$FRAMED')
+            except:
+                self.switching = False
+                raise
+
+    def exit_framed(self):
+        '''Switch the AT command interface back into text mode.'''
+        assert self.port is not None
+        with self.lock:
+            self.switching = True
+            self.seq = (self.seq + 1) & 0xff
+            self.port.write(encode_frame(FrameType.EXIT, self.seq))
+            self.flush()
+            self.read_inline_response()
+
     def write(self, cmd: bytes, flush=True):
         assert self.port is not None
 
@@ -607,13 +845,39 @@ class TypeABZ:
 
             print(f'< {msg.decode("ascii", errors="replace")}')
 
-        self.port.write(cmd + b'\r')
+        if self.framed:
+            self.seq = (self.seq + 1) & 0xff
+            self.port.write(encode_frame(FrameType.COMMAND, self.seq, (FrameTag.TEXT, cmd)))
+        else:
+            self.port.write(cmd + b'\r')
         if flush:
             self.flush()
 
+    def write_data(self, data: bytes, hex=False):
+        '''Write payload data following AT+UTX, AT+CTX, AT+PUTX, or AT+PCTX.'''
+        assert self.port is not None
+
+        if self.framed:
+            self.seq = (self.seq + 1) & 0xff
+            self.port.write(encode_frame(FrameType.DATA, self.seq, (FrameTag.DATA, data)))
+        else:
+            self.port.write(binascii.hexlify(data) if hex else data)
+
     def receive(self, data: bytes):
         assert self.port is not None
 
+        # Responses and events generated by tagged AT commands (see AT_tagged)
+        # start with the tag, e.g., #17+OK. Besides the regular event, each
+        # tagged event is also emitted as event "#<tag>" with the line as the
+        # argument.
+        tag = None
+        m = re.match(b'^#([0-9]+)', data)
+        if m is not None:
+            tag = int(m[1])
+            data = data[m.end():]
+            if not data.startswith(b'+OK') and not data.startswith(b'+ERR'):
+                self.emit(f'#{tag}', data)
+
         if data.startswith(b'+EVENT'):
             payload = data[7:]
             if len(payload) == 0:
@@ -644,24 +908,32 @@ class TypeABZ:
             data = self.port.read(size + 2)
             # The message is passed to the event callback as bytes
             self.emit('message', port, data[2:])
+        elif tag is not None:
+            # Drop late responses to tagged commands nobody waits for anymore
+            if tag in self.pending:
+                self.pending[tag].put_nowait(data)
         else:
             self.response.put_nowait(data)
 
+    def parse_inline_response(self, response: bytes):
+        if response.startswith(b'+ERR=') and len(response) > 6:
+            raise_for_error(int(response[5:]))
+        elif response == b'+OK':
+            return
+        elif response.startswith(b'+OK=') and len(response) > 4:
+            return response[4:]
+        elif response == b'+NAK':
+            raise Exception('Frame rejected by modem')
+        else:
+            raise Exception('Invalid response')
+
     def read_inline_response(self, timeout: Optional[float] = None):
         try:
             response = self.response.get(timeout=timeout)
         except Empty:
             raise TimeoutError('No response received')
         try:
-            if response.startswith(b'+ERR=') and len(response) > 6:
-                raise_for_error(int(response[5:]))
-            elif response == b'+OK':
-                return
-            elif response.startswith(b'+OK=') and len(response) > 4:
-                return response[4:]
-            else:
-                raise Exception('Invalid response')
-
+            return self.parse_inline_response(response)
         finally:
             self.response.task_done()
 
@@ -682,7 +954,7 @@ class TypeABZ:
                 finally:
                     self.response.task_done()
 
-    def AT(self, cmd: str = '', timeout: Optional[float] = 5, wait=True, inline=True, flush=True, encoding='ascii', prefix=b'AT'):
+    def wait_for_guard(self):
         # Implement rudimentary throttling of AT commands send to the device. It
         # appears the original modem firmware cannot properly interpret AT
         # commands that come quickly after a previous response. Thus, if the
@@ -694,6 +966,22 @@ class TypeABZ:
                 if now - self.prev_at < timedelta(seconds=self.guard):
                     sleep(self.guard)
 
+    def AT(self, cmd: str = '', timeout: Optional[float] = 5, wait=True, inline=True, flush=True, encoding='ascii', prefix=b'AT'):
+        # In recording mode (see ATCI.prefetch), report the command to the
+        # caller instead of sending it to the modem. Commands that return
+        # secrets are not batched so that their responses remain redacted in
+        # verbose mode.
+        if self.recording is not None:
+            raise RecordedCommand(cmd, wait and inline and prefix == b'AT' and not self.hide_value)
+
+        if wait and inline and cmd in self.cache:
+            cached = self.cache[cmd]
+            if isinstance(cached, Exception):
+                raise cached
+            return cached.decode(encoding, errors='replace') if cached is not None else None
+
+        self.wait_for_guard()
+
         rv = None
         with self.lock:
             # We intentionally do not add the errors keyword parameter to the
@@ -717,6 +1005,77 @@ class TypeABZ:
             self.prev_at = datetime.now()
             return rv
 
+    def AT_tagged(self, cmd: str, data: Optional[bytes] = None, hex=False, encoding='ascii') -> int:
+        '''Send a tagged AT command without waiting for its response.
+
+        The command is prefixed with a unique tag, e.g., AT#17+UTX 5, which the
+        modem echoes on the response and on all asynchronous events the command
+        produces, such as +ACK or +EVENT=1,1. The events are also emitted as
+        event "#<tag>". Payload data for commands such as +UTX can be passed in
+        the data parameter. The method returns the tag. Use wait_tagged to
+        obtain the response. Several tagged commands may be in flight at the
+        same time. Only supported by the open firmware.
+        '''
+        with self.lock:
+            tag = self.next_tag
+            self.next_tag = (self.next_tag + 1) % 65536
+            self.pending[tag] = Queue()
+
+            self.write(f'AT#{tag}'.encode('ascii') + cmd.encode(encoding), flush=data is None)
+            if data is not None:
+                self.write_data(data, hex)
+                self.flush()
+        return tag
+
+    def wait_tagged(self, tag: int, timeout: Optional[float] = 5, encoding='ascii'):
+        '''Wait for the response to a command sent with AT_tagged.'''
+        try:
+            response = self.pending[tag].get(timeout=timeout)
+        except Empty:
+            raise TimeoutError('No response received')
+        finally:
+            del self.pending[tag]
+
+        rv = self.parse_inline_response(response)
+        return rv.decode(encoding, errors='replace') if rv is not None else None
+
+    def AT_batch(self, cmds: List[str], timeout: Optional[float] = 5, encoding='ascii', max_length=200) -> List[Union[bytes, None, Exception]]:
+        '''Send several AT commands with inline responses on a single line.
+
+        The commands are joined with semicolons, e.g., AT+DEVEUI?;+APPEUI?, and
+        the modem executes them in order. Each command generates its own
+        response. The method returns a list with one item per command: the raw
+        response value (bytes or None), or the exception raised for an error
+        response. Lines longer than max_length characters are split into
+        several lines, since the modem's AT command buffer is limited. The
+        modem must be configured not to stop on the first error
+        (AT$STOPONERR=0), otherwise the method times out.
+        '''
+        lines: List[List[str]] = [[]]
+        length = 2
+        for cmd in cmds:
+            if len(lines[-1]) and length + len(cmd) + 1 > max_length:
+                lines.append([])
+                length = 2
+            lines[-1].append(cmd)
+            length += len(cmd) + 1
+
+        rv: List[Union[bytes, None, Exception]] = []
+        for line in lines:
+            if not len(line):
+                continue
+
+            self.wait_for_guard()
+            with self.lock:
+                self.write(b'AT' + ';'.join(line).encode(encoding))
+                for _ in line:
+                    try:
+                        rv.append(self.read_inline_response(timeout=timeout))
+                    except ModemError as error:
+                        rv.append(error)
+                self.prev_at = datetime.now()
+        return rv
+
 
 class TowerSDK(TypeABZ):
     prefix = b'$LORA: '
@@ -817,6 +1176,47 @@ class ATCI(ABC):
     def __dir__(self):
         return self.settings(case=True).keys()
 
+    def batch_supported(self) -> bool:
+        '''Return True if the modem accepts multiple commands on a single line.'''
+        return False
+
+    @contextmanager
+    def prefetch(self, names):
+        '''Read the values of the given settings in batches.
+
+        Within the context, the values of the given settings are served from
+        responses obtained with a few multi-command AT lines rather than one
+        AT command per setting. Each setting is first read in a recording mode
+        to find out which AT command the setting would send. Settings that
+        cannot be batched, e.g., those with multiline responses, are read
+        individually as usual. The prefetched values are discarded when the
+        context exits.
+        '''
+        if not self.batch_supported():
+            yield
+            return
+
+        cmds: List[str] = []
+        self.modem.recording = cmds
+        try:
+            for name in names:
+                try:
+                    getattr(self, name)
+                except RecordedCommand as rec:
+                    if rec.batchable and rec.cmd.endswith('?') and rec.cmd not in cmds:
+                        cmds.append(rec.cmd)
+                except Exception:
+                    pass
+        finally:
+            self.modem.recording = None
+
+        try:
+            for cmd, value in zip(cmds, self.modem.AT_batch(cmds)):
+                self.modem.cache[cmd] = value
+            yield
+        finally:
+            self.modem.cache.clear()
+
     def __getattr__(self, name):
         props = dir(self)
 
@@ -883,7 +1283,7 @@ class MurataModem(ATCI):
         reply = assert_response(self.modem.AT('+UART?')).split(',')
         if len(reply) != 5:
             raise Exception('Unexpected reply to AT+UART')
-        return UARTConfig(int(reply[0]), int(reply[1]), int(reply[2]), int(reply[3]), reply[4] == 1)
+        return UARTConfig(int(reply[0]), int(reply[1]), int(reply[2]), int(reply[3]), reply[4] == '1')
 
     @uart.setter
     def uart(self, value: UARTConfig | int):
@@ -892,9 +1292,17 @@ class MurataModem(ATCI):
         This property can only be used to configure the baud rate of the port.
         Other parameters such as data bits, parity, or stop bits cannot be
         configured. Only the following baud rate values are supported: 4800,
-        9600, 19200, 38400. The configured value is permanently stored in NVM
+        9600, 19200, 38400. The open firmware additionally supports 57600,
+        115200, and 230400. The configured value is permanently stored in NVM
         (EEPROM). The modem will switch to the newly configured baud rate after
-        reboot.
+        reboot. Until then, the open firmware keeps reporting the baud rate in
+        use. If the configured baud rate cannot be used, the open firmware falls
+        back to the default baud rate and reports that.
+
+        If an UARTConfig object is given, the open firmware also configures
+        RTS/CTS flow control from its flow_control attribute (only if the
+        firmware has been built with LPUART_FLOW_CONTROL=1). Open the serial
+        port with TypeABZ(..., rtscts=True) after the modem has rebooted.
 
         The default configuration of the UART port after factory reset is 19200
         8N1.
@@ -902,7 +1310,10 @@ class MurataModem(ATCI):
         if isinstance(value, tuple):
             value = UARTConfig(*value)
 
-        self.modem.AT(f'+UART={value.baudrate if isinstance(value, UARTConfig) else value}')
+        if isinstance(value, UARTConfig):
+            self.modem.AT(f'+UART={value.baudrate},{value.data_bits},{value.stop_bits},{value.parity},{int(value.flow_control)}')
+        else:
+            self.modem.AT(f'+UART={value}')
 
     @property
     def ver(self):
@@ -2155,7 +2566,7 @@ class MurataModem(ATCI):
         with self.modem.lock:
             with self.modem.events as events:
                 self.modem.AT(f'+{type}TX {len(data)}', wait=False, flush=False)
-                self.modem.port.write(binascii.hexlify(data) if hex else data)
+                self.modem.write_data(data, hex)
                 self.modem.flush()
                 self.modem.read_inline_response()
                 if confirmed:
@@ -2261,10 +2672,7 @@ class MurataModem(ATCI):
         with self.modem.lock:
             with self.modem.events as events:
                 self.modem.AT(f'+P{type}TX {port},{len(data)}', wait=False, flush=False)
-                if hex:
-                    self.modem.port.write(binascii.hexlify(data))
-                else:
-                    self.modem.port.write(data)
+                self.modem.write_data(data, hex)
                 self.modem.flush()
                 self.modem.read_inline_response()
                 if confirmed:
@@ -2648,6 +3056,18 @@ class MurataModem(ATCI):
 
 
 class OpenLoRaModem(MurataModem):
+    @lru_cache(maxsize=None)
+    def batch_supported(self) -> bool:
+        '''Return True if the firmware accepts multiple commands on a single line.
+
+        Multi-command lines are only used if the modem has been configured to
+        continue after an error (AT$STOPONERR=0), which is the default.
+        '''
+        try:
+            return self.modem.AT('$STOPONERR?') == '0'
+        except ModemError:
+            return False
+
     @property
     def version(self):
         '''Return extended firmware version information.
@@ -3068,6 +3488,40 @@ class OpenLoRaModem(MurataModem):
 
     log_level = loglevel
 
+    @property
+    def log_modules(self):
+        '''Return the log configuration of each firmware module.
+
+        This property returns a dictionary indexed by LogModule with a
+        LogModuleConfig object for each module. The level is the firmware's
+        log_level_t value (0 - dump, 5 - off). The burst and interval values
+        configure per-call-site rate limiting: each call site of the module
+        may log up to burst messages back to back and regains one message
+        every interval milliseconds. Burst 0 means unlimited.
+        '''
+        modules = assert_response(self.modem.AT('$LOGMOD?')).split(';')
+        rv = {}
+        for i, v in enumerate(modules):
+            try:
+                module: LogModule | int = LogModule(i)
+            except ValueError:
+                module = i
+            rv[module] = LogModuleConfig(*map(int, v.split(',')))
+        return rv
+
+    def configure_log_module(self, level: int, burst: int = 0, interval: int = 0, module: LogModule | int | None = None):
+        '''Set the log level and rate limit of a firmware module.
+
+        If module is None, all modules are configured. See log_modules for the
+        meaning of the parameters.
+        '''
+        if module is None:
+            self.modem.AT(f'$LOGLEVEL={level},{burst},{interval}')
+        else:
+            if isinstance(module, LogModule):
+                module = module.value
+            self.modem.AT(f'$LOGMOD={module},{level},{burst},{interval}')
+
     def halt(self):
         '''Halt the modem.
 
@@ -3563,6 +4017,88 @@ class OpenLoRaModem(MurataModem):
 
     mcu_id = mcuid
 
+    @property
+    def uart_stats(self):
+        '''Return statistics of the modem's UART port (AT command interface).
+
+        This property returns an UARTStats object with the number of bytes
+        received and transmitted, received bytes lost to RX buffer overruns,
+        line error events, the highest fill levels of the RX and TX buffers,
+        the time in milliseconds spent waiting for TX buffer space, the number
+        of wake-ups from Stop mode by the UART, the number of transmissions and
+        DMA transfers started, and the number of UART overrun errors.
+        '''
+        return UARTStats(*map(int, assert_response(self.modem.AT('$UARTSTATS?')).split(',')))
+
+    def reset_uart_stats(self):
+        '''Reset all UART statistics counters to zero.'''
+        self.modem.AT('$UARTSTATS=0')
+
+    @property
+    def nvm_stats(self):
+        '''Return statistics of writes into the modem's NVM (EEPROM).
+
+        This property returns an NVMStats object with the total number of bytes
+        programmed into the EEPROM, the number of bytes programmed between the
+        two most recent uplinks, and the highest such number seen so far. Only
+        bytes whose value actually changed are counted.
+        '''
+        return NVMStats(*map(int, assert_response(self.modem.AT('$NVMSTATS?')).split(',')))
+
+    def reset_nvm_stats(self):
+        '''Reset all NVM statistics counters to zero.'''
+        self.modem.AT('$NVMSTATS=0')
+
+    @property
+    def post_mortem_log(self):
+        '''Return the modem's post-mortem event log.
+
+        The modem keeps a small ring of recent events in RAM that survives
+        resets and halts (but not power loss). This property returns a
+        PostMortemLog object with the total number of events recorded, a list
+        of the most recent events (oldest first), and the message of the most
+        recent halt. Each PostMortemEntry carries the time of day of the modem's
+        RTC in seconds, the event type (PostMortemEvent), and two event-specific
+        integer values.
+        '''
+        count, data, *msg = assert_response(self.modem.AT('$LOGDUMP?')).split(',', 2)
+        data = bytes.fromhex(data)
+
+        entries = []
+        for time, event, arg, value in struct.iter_unpack('<IBBH', data):
+            try:
+                event = PostMortemEvent(event)
+            except ValueError:
+                pass
+            entries.append(PostMortemEntry(time / 1024, event, arg, value))
+
+        return PostMortemLog(int(count), entries, msg[0] if len(msg) else None)
+
+    def clear_post_mortem_log(self):
+        '''Remove all events from the modem's post-mortem event log.'''
+        self.modem.AT('$LOGDUMP=0')
+
+
+def pmlog_entry_to_str(e: PostMortemEntry):
+    if e.event == PostMortemEvent.BOOT:
+        return 'Reset flags: ' + (' '.join(n for i, n in enumerate(RESET_FLAGS) if e.arg & (1 << i)) or 'none')
+    elif e.event == PostMortemEvent.JOIN:
+        return f'DR{e.arg}, status {e.value}'
+    elif e.event == PostMortemEvent.MLME_CONFIRM:
+        return f'MlmeRequest {e.arg}, status {e.value}'
+    elif e.event == PostMortemEvent.MCPS_CONFIRM:
+        return f'McpsRequest {e.arg}, status {e.value & 0xff}, ack {e.value >> 8}'
+    elif e.event == PostMortemEvent.MCPS_INDICATION:
+        return f'port {e.arg}, status {e.value}'
+    elif e.event == PostMortemEvent.NVM_WRITE:
+        return f'partition {e.arg & 0x7f}, {e.value} B' + (', failed' if e.arg & 0x80 else '')
+    elif e.event == PostMortemEvent.UART_OVERRUN:
+        return f'{e.value} B lost'
+    elif e.event == PostMortemEvent.HALT:
+        return ''
+    else:
+        return f'{e.arg}, {e.value}'
+
 
 def uartconfig_to_str(uart):
     if uart.parity == 0:
@@ -3593,6 +4129,7 @@ def random_key():
 @click.option('--baudrate', '-b', type=int, default=None, help='Serial port baud rate [default: detect]')
 @click.option('--rts', '-R', type=bool, default=None, help='Configure the RTS serial port signal')
 @click.option('--dtr', '-D', type=bool, default=None, help='Configure the DTR serial port signal')
+@click.option('--rtscts', '-F', default=False, is_flag=True, help='Enable RTS/CTS hardware flow control')
 @click.option('--twr-sdk', '-t', 'twr', default=False, is_flag=True, help='Communicate with modem through twr-sdk.')
 @click.option('--reset', '-r', default=False, is_flag=True, help='Reset the modem before issuing any AT commands.')
 @click.option('--verbose', '-v', default=False, is_flag=True, help='Show all AT communication.')
@@ -3600,7 +4137,7 @@ def random_key():
 @click.option('--machine', '-m', default=False, is_flag=True, help='Produce machine-readable output.')
 @click.option('--show-keys', '-k', 'with_keys', default=False, is_flag=True, help='Show security keys.')
 @click.pass_context
-def cli(ctx, port, baudrate, twr, reset, verbose, guard, machine, with_keys, rts, dtr):
+def cli(ctx, port, baudrate, twr, reset, verbose, guard, machine, with_keys, rts, dtr, rtscts):
     '''Command line interface to the Murata TypeABZ LoRaWAN modem.
 
     This tool provides a number of commands for managing Murata TypeABZ
@@ -3646,7 +4183,7 @@ def cli(ctx, port, baudrate, twr, reset, verbose, guard, machine, with_keys, rts
         if twr_sdk:
             dev: TowerSDK | TypeABZ = TowerSDK(port, verbose=verbose, guard=guard, rts=rts, dtr=dtr)
         else:
-            dev = TypeABZ(port, verbose=verbose, guard=guard, rts=rts,  dtr=dtr)
+            dev = TypeABZ(port, verbose=verbose, guard=guard, rts=rts,  dtr=dtr, rtscts=rtscts)
 
         if baudrate is None:
             baudrate = dev.detect_baud_rate()
@@ -4209,6 +4746,36 @@ def reboot(get_modem: Callable[[], OpenLoRaModem], hard):
         click.echo(f"done")
 
 
+@cli.command()
+@click.option('--clear', '-c', default=False, is_flag=True, help='Clear the log after retrieving it.')
+@click.pass_obj
+def logdump(get_modem: Callable[[], OpenLoRaModem], clear):
+    '''Show the modem's post-mortem event log.
+
+    The modem records significant events such as boots, Join attempts, MAC
+    confirmations, NVM writes, UART overruns, and halts in a small ring buffer
+    in RAM. The buffer survives resets and halts as long as the modem remains
+    powered, and is available also in release builds without the debugging log.
+    Times are shown as the time of day of the modem's RTC, which restarts from
+    midnight on every boot.
+    '''
+    modem = get_modem()
+    log = modem.post_mortem_log
+    if clear:
+        modem.clear_post_mortem_log()
+
+    first = log.count - len(log.entries)
+    data = []
+    for i, e in enumerate(log.entries):
+        name = e.event.name if isinstance(e.event, PostMortemEvent) else e.event
+        time = f'{int(e.time // 3600):02d}:{int(e.time // 60 % 60):02d}:{e.time % 60:06.3f}'
+        data.append([first + i, time, name, pmlog_entry_to_str(e)])
+
+    render(data, ['#', 'Time', 'Event', 'Details'])
+    if log.halt_message and not machine_readable:
+        click.echo(f'Most recent halt: {log.halt_message}')
+
+
 @cli.command()
 @click.option('--region', '-r', type=str, default=None, help='Switch to the region (band) if necessary.')
 @click.option('--data-rate', '-R', type=str, default=None, help='Specify Join data rate (data rate 0 by default).')
@@ -4462,32 +5029,35 @@ def get(get_modem: Callable[[], OpenLoRaModem], names, all, long, names_only):
             click.echo("Please either provide a setting name or use --all", err=True)
             sys.exit(1)
 
-    for name in names:
-        orig_name = name
-        n = name.lower()
-        if n.startswith('at+') or n.startswith('at$'):
-            name = name[3:]
-        try:
-            value = getattr(modem, name)
-        except AttributeError as e:
-            click.echo(f'Error while getting "{orig_name}": {e}', err=True)
-            sys.exit(1)
-        except UnknownCommand:
-            if not all:
-                click.echo(f'Error: The modem does not implement "{orig_name}"', err=True)
+    # Read the settings with as few AT command lines as possible
+    prefetch = [name[3:] if name.lower()[:3] in ('at+', 'at$') else name for name in names]
+    with modem.prefetch(prefetch):
+        for name in names:
+            orig_name = name
+            n = name.lower()
+            if n.startswith('at+') or n.startswith('at$'):
+                name = name[3:]
+            try:
+                value = getattr(modem, name)
+            except AttributeError as e:
+                click.echo(f'Error while getting "{orig_name}": {e}', err=True)
                 sys.exit(1)
-        except ModemError as e:
-            # Ignore "not implemented in the current region" only if we are
-            # listing all commands.
-            if not all or e.errno != -17:
-                raise e
-        else:
-            if isinstance(value, tuple) or isinstance(value, list):
-                value = ','.join(map(str, value))
-            if long:
-                click.echo(f'{orig_name}={value}')
+            except UnknownCommand:
+                if not all:
+                    click.echo(f'Error: The modem does not implement "{orig_name}"', err=True)
+                    sys.exit(1)
+            except ModemError as e:
+                # Ignore "not implemented in the current region" only if we are
+                # listing all commands.
+                if not all or e.errno != -17:
+                    raise e
             else:
-                click.echo(f'{value}')
+                if isinstance(value, tuple) or isinstance(value, list):
+                    value = ','.join(map(str, value))
+                if long:
+                    click.echo(f'{orig_name}={value}')
+                else:
+                    click.echo(f'{value}')
 
 
 @cli.command('set')
@@ -1,3 +1,5 @@
+#define LOG_MODULE LOG_MODULE_ADC
+
 #include "adc.h"
 #include <stm/STM32L0xx_HAL_Driver/Inc/stm32l0xx_hal.h>
 #include "log.h"
@@ -1,3 +1,5 @@
+#define LOG_MODULE LOG_MODULE_ATCI
+
 #include "atci.h"
 #include <string.h>
 #include <stdarg.h>
@@ -8,6 +10,42 @@
 #include "halt.h"
 #include "system.h"
 #include "irq.h"
+#include "frame.h"
+
+
+// Upper bound on the number of entries in the command table passed to
+// atci_init. Indexes into the table are stored in a single byte.
+#define ATCI_MAX_COMMANDS 128
+
+// The size of the memory buffer used to queue output that does not fit into
+// the LPUART TX FIFO
+#ifndef ATCI_OUTPUT_QUEUE_SIZE
+#define ATCI_OUTPUT_QUEUE_SIZE 512
+#endif
+
+// The maximum number of queued output descriptors
+#define ATCI_OUTPUT_SLOTS 32
+
+// What to do when the output queue is full: 0 - wait until there is enough
+// space in the queue, 1 - drop the output
+#ifndef ATCI_OUTPUT_OVERFLOW
+#define ATCI_OUTPUT_OVERFLOW 0
+#endif
+
+
+struct output_slot
+{
+    const char *ptr;
+    size_t len;
+
+    // Set in descriptors that list the command table for AT+CLAC (1) or
+    // AT$HELP (2). Such a descriptor generates the listing one line part at a
+    // time while it is drained: ptr and len refer to the current part, item
+    // and part to its position in the listing.
+    uint8_t listing;
+    uint8_t item;
+    uint8_t part;
+};
 
 
 enum parser_state
@@ -22,40 +60,401 @@ static struct
 {
     const atci_command_t *commands;
     size_t commands_length;
+
+    // The command table sorted by name, built once in atci_init. The name
+    // lengths are cached so that process_command can look up a command with
+    // a binary search without calling strlen on the table entries.
+    struct
+    {
+        uint8_t command;
+        uint8_t length;
+    } index[ATCI_MAX_COMMANDS];
+
     char rx_buffer[256];
     size_t rx_length;
     bool rx_error;
     bool aborted;
+
+    // Set when the last executed command failed
+    bool error;
+    bool stop_on_error;
     enum parser_state parser_state;
 
+    // The tag of the command being executed (AT#<tag>...) or ATCI_NO_TAG, and
+    // its textual form prepended to each response line. Set when the last
+    // byte written was a newline, i.e., the next byte starts a new line.
+    int32_t tag;
+    char tag_text[8];
+    size_t tag_length;
+    bool bol;
+
     char tmp[256];
 
     struct
     {
         size_t length;
         atci_encoding_t encoding;
+        bool odd;
+        int32_t tag;
         void (*callback)(atci_data_status_t status, atci_param_t *param);
     } read_next_data;
 
+    // Output that could not be written into the LPUART TX FIFO right away.
+    // Each descriptor refers either to a static buffer owned by the caller
+    // (ptr != NULL), to the next len bytes copied into the data buffer
+    // (ptr == NULL), or to a command listing. The queue is drained from
+    // atci_process.
+    struct
+    {
+        struct output_slot slot[ATCI_OUTPUT_SLOTS];
+        size_t head;
+        size_t count;
+        cbuf_t data;
+        char buffer[ATCI_OUTPUT_QUEUE_SIZE];
+    } output;
+
+    // Binary framed mode entered with AT$FRAMED, see frame.h. While a frame
+    // from the host is being processed, all output is collected into
+    // response frames. Output generated at other times is sent in event
+    // frames.
+    struct
+    {
+        bool enabled;
+        bool request;
+        uint8_t seq;
+        uint8_t event_seq;
+        frame_decoder_t decoder;
+        uint8_t rx[FRAME_MAX_SIZE];
+        uint8_t tx[FRAME_MAX_SIZE];
+        size_t text_length;
+    } frame;
+
 } state;
 
 
-void atci_init(unsigned int baudrate, const atci_command_t *commands, int length)
+// Point a listing descriptor to the next part of its current line: "AT", the
+// command name, the hint with AT$HELP, and the line terminator. Return false
+// at the end of the listing.
+static bool next_listing_part(struct output_slot *slot)
+{
+    const atci_command_t *cmd;
+
+    if (slot->item >= state.commands_length) return false;
+    cmd = state.commands + slot->item;
+
+    switch (slot->part++) {
+        case 0: slot->ptr = "AT"; break;
+        case 1:
+            slot->ptr = cmd->command;
+            // AT+CLAC lists the names only
+            if (slot->listing == 1) slot->part = 4;
+            break;
+        case 2: slot->ptr = " "; break;
+        case 3: slot->ptr = cmd->hint; break;
+        default:
+            slot->ptr = "\r\n";
+            slot->part = 0;
+            slot->item++;
+            break;
+    }
+
+    slot->len = strlen(slot->ptr);
+    return true;
+}
+
+
+static void drain_output(void)
+{
+    size_t n;
+    cbuf_view_t v;
+
+    while (state.output.count) {
+        struct output_slot *slot = &state.output.slot[state.output.head];
+
+        if (slot->listing && slot->len == 0 && !next_listing_part(slot)) {
+            state.output.head = (state.output.head + 1) % ATCI_OUTPUT_SLOTS;
+            state.output.count--;
+            continue;
+        }
+
+        if (slot->ptr != NULL) {
+            n = lpuart_write(slot->ptr, slot->len);
+            slot->ptr += n;
+        } else {
+            cbuf_head(&state.output.data, &v);
+            n = lpuart_write(v.ptr[0], slot->len < v.len[0] ? slot->len : v.len[0]);
+            if (n == v.len[0] && n < slot->len)
+                n += lpuart_write(v.ptr[1], slot->len - n);
+            cbuf_consume(&state.output.data, n);
+        }
+        slot->len -= n;
+
+        if (slot->len != 0) break;
+        if (slot->listing) continue;
+        state.output.head = (state.output.head + 1) % ATCI_OUTPUT_SLOTS;
+        state.output.count--;
+    }
+}
+
+
+// Append up to length bytes from buffer to the output queue and return the
+// number of bytes appended. Static buffers are referenced rather than copied.
+static size_t enqueue_output(const char *buffer, size_t length, bool is_static)
+{
+    size_t last = (state.output.head + state.output.count + ATCI_OUTPUT_SLOTS - 1) % ATCI_OUTPUT_SLOTS;
+
+    if (!is_static) {
+        // Extend the last descriptor if it also refers to the data buffer
+        if (state.output.count == 0 || state.output.slot[last].ptr != NULL
+            || state.output.slot[last].listing) {
+            if (state.output.count == ATCI_OUTPUT_SLOTS) return 0;
+            last = (last + 1) % ATCI_OUTPUT_SLOTS;
+            state.output.slot[last].ptr = NULL;
+            state.output.slot[last].len = 0;
+            state.output.slot[last].listing = 0;
+            state.output.count++;
+        }
+        length = cbuf_put(&state.output.data, buffer, length);
+        state.output.slot[last].len += length;
+        return length;
+    }
+
+    if (state.output.count == ATCI_OUTPUT_SLOTS) return 0;
+    last = (last + 1) % ATCI_OUTPUT_SLOTS;
+    state.output.slot[last].ptr = buffer;
+    state.output.slot[last].len = length;
+    state.output.slot[last].listing = 0;
+    state.output.count++;
+    return length;
+}
+
+
+static size_t write_output(const char *buffer, size_t length, bool is_static)
+{
+    size_t n, rv = length;
+
+    drain_output();
+
+#if ATCI_OUTPUT_OVERFLOW == 1
+    // Drop the output altogether if it fits neither into the LPUART TX FIFO
+    // nor into the output queue
+    n = state.output.count ? 0 : spsc_space(&lpuart_tx_fifo);
+    if (state.output.count == ATCI_OUTPUT_SLOTS ||
+        (!is_static && length > n + state.output.data.max_length - state.output.data.length)) {
+        log_warning("ATCI: Output queue full, dropping %lu bytes", (unsigned long)length);
+        return 0;
+    }
+#endif
+
+    while (length) {
+        if (state.output.count == 0) {
+            n = lpuart_write(buffer, length);
+            buffer += n;
+            length -= n;
+            if (length == 0) break;
+        }
+
+        n = enqueue_output(buffer, length, is_static);
+        buffer += n;
+        length -= n;
+        if (length == 0) break;
+
+        // The queue is full. Wait for the LPUART to send some data and try
+        // again.
+        lpuart_wait_tx_space(1);
+        drain_output();
+    }
+    return rv;
+}
+
+
+// The offset of the text in a TEXT frame under construction and the maximum
+// length of the text
+#define FRAME_TEXT_OFFSET (FRAME_HEADER_SIZE + FRAME_TLV_HEADER_SIZE)
+#define FRAME_TEXT_MAX (FRAME_MAX_SIZE - FRAME_TEXT_OFFSET - FRAME_CRC_SIZE)
+
+
+static void write_frame_block(const char *buffer, size_t length)
+{
+    write_output(buffer, length, false);
+}
+
+
+static void send_text_frame(uint8_t type, uint8_t seq)
+{
+    if (state.frame.text_length == 0) return;
+
+    state.frame.tx[0] = type;
+    state.frame.tx[1] = seq;
+    state.frame.tx[2] = FRAME_TAG_TEXT;
+    state.frame.tx[3] = state.frame.text_length;
+    frame_encode(state.frame.tx, FRAME_TEXT_OFFSET + state.frame.text_length, write_frame_block);
+    state.frame.text_length = 0;
+}
+
+
+static void send_event_frame(void)
+{
+    if (state.frame.text_length != 0)
+        send_text_frame(FRAME_EVENT, state.frame.event_seq++);
+}
+
+
+static void append_frame_text(const char *buffer, size_t length)
+{
+    size_t n;
+
+    while (length) {
+        n = FRAME_TEXT_MAX - state.frame.text_length;
+        if (n > length) n = length;
+        memcpy(state.frame.tx + FRAME_TEXT_OFFSET + state.frame.text_length, buffer, n);
+        state.frame.text_length += n;
+        buffer += n;
+        length -= n;
+
+        if (state.frame.text_length == FRAME_TEXT_MAX) {
+            if (state.frame.request) send_text_frame(FRAME_PARTIAL, state.frame.seq);
+            else send_event_frame();
+        }
+    }
+
+    // Asynchronous output, e.g., +EVENT or +ACK, is terminated with an empty
+    // line. Send each such message in a separate event frame.
+    n = state.frame.text_length;
+    if (!state.frame.request && n >= sizeof(ATCI_EOL) - 1 &&
+        !memcmp(state.frame.tx + FRAME_TEXT_OFFSET + n - (sizeof(ATCI_EOL) - 1), ATCI_EOL, sizeof(ATCI_EOL) - 1))
+        send_event_frame();
+}
+
+
+static size_t route_output(const char *buffer, size_t length, bool is_static)
+{
+    if (state.frame.enabled) {
+        append_frame_text(buffer, length);
+        return length;
+    }
+    return write_output(buffer, length, is_static);
+}
+
+
+static size_t output(const char *buffer, size_t length, bool is_static)
+{
+    size_t start = 0;
+
+    if (length == 0) return 0;
+
+    // Prepend the tag of the current command to each line that starts with
+    // '+', i.e., to responses and events, but not to empty lines or to the
+    // lines of multi-line responses such as AT+CLAC.
+    if (state.tag != ATCI_NO_TAG) {
+        for (size_t i = 0; i < length; i++) {
+            if (state.bol && buffer[i] == '+') {
+                route_output(buffer + start, i - start, is_static);
+                route_output(state.tag_text, state.tag_length, false);
+                start = i;
+            }
+            state.bol = buffer[i] == '\n';
+        }
+    } else {
+        state.bol = buffer[length - 1] == '\n';
+    }
+
+    route_output(buffer + start, length - start, is_static);
+    return length;
+}
+
+
+int32_t atci_get_tag(void)
+{
+    return state.tag;
+}
+
+
+int32_t atci_set_tag(int32_t tag)
+{
+    int32_t prev = state.tag;
+    state.tag = tag;
+    if (tag != ATCI_NO_TAG)
+        state.tag_length = snprintf(state.tag_text, sizeof(state.tag_text), "#%ld", (long)tag);
+    return prev;
+}
+
+
+static int compare_name(const char *name, size_t name_len, size_t i)
+{
+    size_t cmd_len = state.index[i].length;
+    int rv = memcmp(name, state.commands[state.index[i].command].command,
+        name_len < cmd_len ? name_len : cmd_len);
+    if (rv != 0) return rv;
+    if (name_len == cmd_len) return 0;
+    return name_len < cmd_len ? -1 : 1;
+}
+
+
+static void build_index(void)
+{
+    const char *name;
+    size_t len, j;
+
+    if (state.commands_length > ATCI_MAX_COMMANDS)
+        halt("Too many AT commands");
+
+    // Insertion sort. The table is small and this only runs once at boot.
+    for (size_t i = 0; i < state.commands_length; i++) {
+        name = state.commands[i].command;
+        len = strlen(name);
+
+        for (j = i; j > 0 && compare_name(name, len, j - 1) < 0; j--)
+            state.index[j] = state.index[j - 1];
+
+        state.index[j].command = i;
+        state.index[j].length = len;
+    }
+}
+
+
+static const atci_command_t *find_command(const char *name, size_t name_len)
+{
+    size_t lo = 0, hi = state.commands_length, mid;
+    int rv;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        rv = compare_name(name, name_len, mid);
+        if (rv == 0) return state.commands + state.index[mid].command;
+        if (rv < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    return NULL;
+}
+
+
+void atci_init(unsigned int baudrate, bool flow_control, const atci_command_t *commands, int length)
 {
     memset(&state, 0, sizeof(state));
 
-    lpuart_init(baudrate);
+    lpuart_init(baudrate, flow_control);
+
+    cbuf_init(&state.output.data, state.output.buffer, sizeof(state.output.buffer));
+
+    state.tag = ATCI_NO_TAG;
+    state.bol = true;
 
     state.commands = commands;
     state.commands_length = length;
+    build_index();
 }
 
 
 size_t atci_print(const char *message)
 {
-    size_t len = strlen(message);
-    lpuart_write_blocking(message, len);
-    return len;
+    return output(message, strlen(message), false);
+}
+
+
+size_t atci_print_static(const char *message)
+{
+    return output(message, strlen(message), true);
 }
 
 
@@ -70,35 +469,130 @@ size_t atci_printf(const char *format, ...)
     if (length > sizeof(state.tmp))
         length = sizeof(state.tmp);
 
-    lpuart_write_blocking(state.tmp, length);
-    return length;
+    return output(state.tmp, length, false);
+}
+
+
+// The two hex characters for each byte value, used by the hex encoder below
+static const char hex_pair[512] =
+    "000102030405060708090A0B0C0D0E0F"
+    "101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F"
+    "303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F"
+    "505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F"
+    "707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F"
+    "909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAF"
+    "B0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECF"
+    "D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEF"
+    "F0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+
+static void encode_hex(char *dst, const uint8_t *src, size_t length)
+{
+    for (size_t i = 0; i < length; i++, dst += 2) {
+        dst[0] = hex_pair[src[i] * 2];
+        dst[1] = hex_pair[src[i] * 2 + 1];
+    }
 }
 
 
 size_t atci_print_buffer_as_hex(const void *buffer, size_t length)
 {
-    char byte;
-    size_t on_write = 0;
+    const uint8_t *src = buffer;
+    const char *pair;
+    size_t n, chunk, offset, on_write = 0;
+    cbuf_view_t v;
+
+    drain_output();
+
+    // Encode the buffer directly into the free space of the LPUART TX FIFO,
+    // one chunk per call to spsc_tail. A byte whose two hex characters do not
+    // fit into the first segment is split across the two segments.
+    while (length && state.output.count == 0 && !state.frame.enabled) {
+        spsc_tail(&lpuart_tx_fifo, &v);
+
+        n = v.len[0] / 2;
+        if (n > length) n = length;
+        encode_hex(v.ptr[0], src, n);
+        src += n;
+        length -= n;
+        chunk = n * 2;
+
+        offset = 0;
+        if (length && v.len[0] % 2 && v.len[1]) {
+            pair = hex_pair + *src++ * 2;
+            v.ptr[0][v.len[0] - 1] = pair[0];
+            v.ptr[1][0] = pair[1];
+            length--;
+            chunk += 2;
+            offset = 1;
+        }
 
-    for (size_t i = 0; i < length; i++) {
-        byte = ((char *)buffer)[i];
+        n = (v.len[1] - offset) / 2;
+        if (n > length) n = length;
+        encode_hex(v.ptr[1] + offset, src, n);
+        src += n;
+        length -= n;
+        chunk += n * 2;
 
-        char upper = (byte >> 4) & 0xf;
-        char lower = byte & 0x0f;
+        if (chunk == 0) break;
+        on_write += lpuart_produce(chunk);
+        state.bol = false;
+    }
 
-        state.tmp[on_write++] = upper < 10 ? upper + '0' : upper - 10 + 'A';
-        state.tmp[on_write++] = lower < 10 ? lower + '0' : lower - 10 + 'A';
+    // Whatever does not fit into the LPUART TX FIFO goes to the output queue
+    // (or into a frame in framed mode)
+    while (length) {
+        n = sizeof(state.tmp) / 2;
+        if (n > length) n = length;
+        encode_hex(state.tmp, src, n);
+        src += n;
+        length -= n;
+        on_write += output(state.tmp, n * 2, false);
     }
 
-    lpuart_write_blocking(state.tmp, on_write);
     return on_write;
 }
 
 
 size_t atci_write(const char *buffer, size_t length)
 {
-    lpuart_write_blocking(buffer, length);
-    return length;
+    return output(buffer, length, false);
+}
+
+
+void atci_error(int code)
+{
+    state.error = true;
+    atci_printf("+ERR=%d" ATCI_EOL, code);
+}
+
+
+void atci_set_stop_on_error(bool enabled)
+{
+    state.stop_on_error = enabled;
+}
+
+
+bool atci_get_stop_on_error(void)
+{
+    return state.stop_on_error;
+}
+
+
+void atci_flush(void)
+{
+    while (state.output.count) {
+        drain_output();
+        if (state.output.count) lpuart_wait_tx_space(1);
+    }
+    lpuart_flush();
 }
 
 
@@ -111,6 +605,22 @@ static int hex2bin(char c)
 }
 
 
+// Lookup table for the bulk hex payload decoder. Valid hex digits have the
+// HEX_VALID bit set and their value in the lower nibble.
+#define HEX_VALID 0x10
+
+static const uint8_t hex_value[256] = {
+    ['0'] = HEX_VALID | 0x0, ['1'] = HEX_VALID | 0x1, ['2'] = HEX_VALID | 0x2,
+    ['3'] = HEX_VALID | 0x3, ['4'] = HEX_VALID | 0x4, ['5'] = HEX_VALID | 0x5,
+    ['6'] = HEX_VALID | 0x6, ['7'] = HEX_VALID | 0x7, ['8'] = HEX_VALID | 0x8,
+    ['9'] = HEX_VALID | 0x9,
+    ['A'] = HEX_VALID | 0xa, ['B'] = HEX_VALID | 0xb, ['C'] = HEX_VALID | 0xc,
+    ['D'] = HEX_VALID | 0xd, ['E'] = HEX_VALID | 0xe, ['F'] = HEX_VALID | 0xf,
+    ['a'] = HEX_VALID | 0xa, ['b'] = HEX_VALID | 0xb, ['c'] = HEX_VALID | 0xc,
+    ['d'] = HEX_VALID | 0xd, ['e'] = HEX_VALID | 0xe, ['f'] = HEX_VALID | 0xf
+};
+
+
 size_t atci_param_get_buffer_from_hex(atci_param_t *param, void *buffer, size_t length, size_t param_length)
 {
     char c;
@@ -204,7 +714,9 @@ bool atci_set_read_next_data(size_t length, atci_encoding_t encoding, void (*cal
     }
 
     state.read_next_data.length = length;
-    state.read_next_data.encoding = encoding;
+    state.read_next_data.tag = state.tag;
+    // Frames are binary-transparent, payload data is never hex-encoded
+    state.read_next_data.encoding = state.frame.enabled ? ATCI_ENCODING_BIN : encoding;
     state.read_next_data.callback = callback;
 
     return true;
@@ -220,23 +732,55 @@ void atci_abort_read_next_data(void)
 }
 
 
+// List the command table, with hints if listing is 2. The listing takes a
+// single descriptor in the output queue, which generates the lines as the
+// LPUART makes room for them. Thus, the listing does not wait for the LPUART
+// however long the command table is.
+static void list_commands(uint8_t listing)
+{
+    struct output_slot slot = { .listing = listing };
+
+    if (state.frame.enabled) {
+        // Frames are built in memory, one frame at a time
+        while (next_listing_part(&slot))
+            output(slot.ptr, slot.len, true);
+    } else {
+        drain_output();
+
+        if (state.output.count == ATCI_OUTPUT_SLOTS) {
+#if ATCI_OUTPUT_OVERFLOW == 1
+            log_warning("ATCI: Output queue full, dropping command listing");
+            output(ATCI_OK, ATCI_OK_LEN, true);
+            return;
+#else
+            while (state.output.count == ATCI_OUTPUT_SLOTS) {
+                lpuart_wait_tx_space(1);
+                drain_output();
+            }
+#endif
+        }
+
+        state.output.slot[(state.output.head + state.output.count) % ATCI_OUTPUT_SLOTS] = slot;
+        state.output.count++;
+        if (state.commands_length) state.bol = true;
+        drain_output();
+    }
+
+    output(ATCI_OK, ATCI_OK_LEN, true);
+}
+
+
 void atci_clac_action(atci_param_t *param)
 {
     (void)param;
-    for (size_t i = 0; i < state.commands_length; i++)
-        atci_printf("AT%s\r\n", state.commands[i].command);
-
-    lpuart_write_blocking(ATCI_OK, ATCI_OK_LEN);
+    list_commands(1);
 }
 
 
 void atci_help_action(atci_param_t *param)
 {
     (void)param;
-    for (size_t i = 0; i < state.commands_length; i++)
-        atci_printf("AT%s %s\r\n", state.commands[i].command, state.commands[i].hint);
-
-    lpuart_write_blocking(ATCI_OK, ATCI_OK_LEN);
+    list_commands(2);
 }
 
 
@@ -244,6 +788,7 @@ static void finish_next_data(atci_data_status_t status)
 {
     state.read_next_data.length = 0;
     state.read_next_data.encoding = ATCI_ENCODING_BIN;
+    state.read_next_data.odd = false;
     state.rx_buffer[state.rx_length] = 0;
 
     if (state.read_next_data.callback != NULL) {
@@ -252,13 +797,19 @@ static void finish_next_data(atci_data_status_t status)
             .length = state.rx_length,
             .offset = 0
         };
+        // The response belongs to the command that requested the data
+        int32_t tag = atci_set_tag(state.read_next_data.tag);
         state.read_next_data.callback(status, &param);
+        atci_set_tag(tag);
     }
 
     state.rx_length = 0;
 }
 
 
+static void dispatch(char *name, size_t name_len);
+
+
 static void process_command(void)
 {
     log_debug("ATCI: %s", state.rx_buffer);
@@ -273,100 +824,166 @@ static void process_command(void)
             lpuart_resume_tx();
         }
 
-        lpuart_write_blocking(ATCI_OK, ATCI_OK_LEN);
+        output(ATCI_OK, ATCI_OK_LEN, true);
         return;
     }
 
     state.rx_buffer[state.rx_length] = 0;
 
     for(size_t i = 2; i < state.rx_length; i++)
-        switch(state.rx_buffer[i]) {
-            case '=':
-            case '?':
-            case ' ':
-                break;
-
-            default:
-                state.rx_buffer[i] = toupper(state.rx_buffer[i]);
-                break;
+        state.rx_buffer[i] = toupper(state.rx_buffer[i]);
+
+    // A line can carry several commands separated with semicolons, e.g.,
+    // AT+DEVEUI?;+APPEUI?. The commands are executed in order and each
+    // generates its own response.
+    char *name = state.rx_buffer + 2, *sep;
+    char *end = state.rx_buffer + state.rx_length;
+    bool empty = true;
+
+    // An optional decimal tag, e.g., AT#17+UTX 5, is echoed on all responses
+    // to the commands on the line and on the asynchronous events they produce
+    if (*name == '#') {
+        char *digit = ++name;
+        uint32_t tag = 0;
+
+        while (name < end && isdigit((unsigned char)*name) && name - digit < 5)
+            tag = tag * 10 + *name++ - '0';
+
+        if (name == digit || tag > ATCI_MAX_TAG || isdigit((unsigned char)*name)) {
+            output(ATCI_UNKNOWN_CMD, ATCI_UKNOWN_CMD_LEN, true);
+            return;
         }
+        atci_set_tag(tag);
+    }
 
-    char *name = state.rx_buffer + 2;
-    size_t name_len = state.rx_length - 2;
+    while (true) {
+        sep = memchr(name, ';', end - name);
+        if (sep != NULL) *sep = '\0';
+        else sep = end;
 
-    const atci_command_t *cmd;
-    size_t cmd_len;
-    for (size_t i = 0; i < state.commands_length; i++) {
-        cmd = state.commands + i;
-        cmd_len = strlen(cmd->command);
+        if (sep != name) {
+            empty = false;
+            state.error = false;
+            dispatch(name, sep - name);
 
-        if (name_len < cmd_len) continue;
-        if (strncmp(name, cmd->command, cmd_len) != 0) continue;
+            if (state.error && state.stop_on_error) break;
 
-        if (cmd_len == name_len) {
-            if (cmd->action != NULL) {
-                cmd->action(NULL);
-                return;
-            }
-        } else if (name[cmd_len] == '=') {
-            if (name[cmd_len + 1] == '?' && (cmd_len + 2 == name_len) && cmd->help) {
-                cmd->help();
-                return;
-            }
+            // A command that reads payload data from the ATCI, e.g., AT+UTX,
+            // must be the last command on the line. The remaining commands
+            // are ignored.
+            if (state.read_next_data.length != 0) break;
+        }
 
-            if (cmd->set != NULL) {
-                atci_param_t param = {
-                    .txt    = name + cmd_len + 1,
-                    .length = name_len - cmd_len - 1,
-                    .offset = 0
-                };
-                cmd->set(&param);
-                return;
-            }
-        } else if (name[cmd_len] == '?' && cmd_len + 1 == name_len) {
-            if (cmd->read != NULL) {
-                cmd->read();
-                return;
-            }
-        } else if (name[cmd_len] == ' ' && cmd_len + 1 < name_len) {
-            if (cmd->action != NULL) {
-                atci_param_t param = {
-                    .txt    = name + cmd_len + 1,
-                    .length = name_len - cmd_len - 1,
-                    .offset = 0
-                };
-                cmd->action(&param);
-                return;
-            }
+        if (sep == end) break;
+        name = sep + 1;
+    }
+
+    if (empty) output(ATCI_OK, ATCI_OK_LEN, true);
+    atci_set_tag(ATCI_NO_TAG);
+}
+
+
+static void dispatch(char *name, size_t name_len)
+{
+    // The command name extends up to the first '=', '?', or ' ' character
+    size_t cmd_len = strcspn(name, "=? ");
+
+    const atci_command_t *cmd = find_command(name, cmd_len);
+    if (cmd == NULL) goto unknown;
+
+    if (cmd_len == name_len) {
+        if (cmd->action != NULL) {
+            cmd->action(NULL);
+            return;
+        }
+    } else if (name[cmd_len] == '=') {
+        if (name[cmd_len + 1] == '?' && (cmd_len + 2 == name_len) && cmd->help) {
+            cmd->help();
+            return;
+        }
+
+        if (cmd->set != NULL) {
+            atci_param_t param = {
+                .txt    = name + cmd_len + 1,
+                .length = name_len - cmd_len - 1,
+                .offset = 0
+            };
+            cmd->set(&param);
+            return;
+        }
+    } else if (name[cmd_len] == '?' && cmd_len + 1 == name_len) {
+        if (cmd->read != NULL) {
+            cmd->read();
+            return;
+        }
+    } else if (name[cmd_len] == ' ' && cmd_len + 1 < name_len) {
+        if (cmd->action != NULL) {
+            atci_param_t param = {
+                .txt    = name + cmd_len + 1,
+                .length = name_len - cmd_len - 1,
+                .offset = 0
+            };
+            cmd->action(&param);
+            return;
         }
     }
 
-    lpuart_write_blocking(ATCI_UNKNOWN_CMD, ATCI_UKNOWN_CMD_LEN);
+unknown:
+    state.error = true;
+    output(ATCI_UNKNOWN_CMD, ATCI_UKNOWN_CMD_LEN, true);
 }
 
 
-static void process_data(char character)
+static size_t process_data(const char *data, size_t length)
 {
-    int c;
-    static bool even = true;
+    size_t i = 0, n;
+    uint8_t hi, lo;
 
     switch(state.read_next_data.encoding) {
         case ATCI_ENCODING_BIN:
-            state.rx_buffer[state.rx_length++] = character;
+            n = state.read_next_data.length - state.rx_length;
+            if (n > length) n = length;
+            memcpy(state.rx_buffer + state.rx_length, data, n);
+            state.rx_length += n;
+            i = n;
             break;
 
         case ATCI_ENCODING_HEX:
-            c = hex2bin(character);
-            if (c < 0) {
-                state.rx_error = true;
-                break;
+            // Complete the byte whose upper nibble arrived in the previous
+            // chunk
+            if (state.read_next_data.odd && i < length) {
+                lo = hex_value[(uint8_t)data[i++]];
+                if (!(lo & HEX_VALID)) {
+                    state.rx_error = true;
+                    break;
+                }
+                state.rx_buffer[state.rx_length++] |= lo & 0x0f;
+                state.read_next_data.odd = false;
             }
-            if (even) {
-                state.rx_buffer[state.rx_length] = c << 4;
-                even = false;
-            } else {
-                state.rx_buffer[state.rx_length++] |= c;
-                even = true;
+
+            while (state.rx_length < state.read_next_data.length && length - i >= 2) {
+                hi = hex_value[(uint8_t)data[i]];
+                lo = hex_value[(uint8_t)data[i + 1]];
+                if (!(hi & lo & HEX_VALID)) {
+                    // Consume the input up to and including the first
+                    // invalid character
+                    i += hi & HEX_VALID ? 2 : 1;
+                    state.rx_error = true;
+                    break;
+                }
+                state.rx_buffer[state.rx_length++] = (hi & 0x0f) << 4 | (lo & 0x0f);
+                i += 2;
+            }
+            if (state.rx_error) break;
+
+            if (state.rx_length < state.read_next_data.length && i < length) {
+                hi = hex_value[(uint8_t)data[i++]];
+                if (!(hi & HEX_VALID)) {
+                    state.rx_error = true;
+                    break;
+                }
+                state.rx_buffer[state.rx_length] = (hi & 0x0f) << 4;
+                state.read_next_data.odd = true;
             }
             break;
 
@@ -376,10 +993,11 @@ static void process_data(char character)
     }
 
     if (state.read_next_data.length == state.rx_length || state.rx_error) {
-        even = true;
         finish_next_data(state.rx_error ? ATCI_DATA_ENCODING_ERROR : ATCI_DATA_OK);
         state.rx_error = false;
     }
+
+    return i;
 }
 
 
@@ -400,11 +1018,6 @@ static int append_to_buffer(char c)
 
 static void process_character(char character)
 {
-    if (state.read_next_data.length != 0) {
-        process_data(character);
-        return;
-    }
-
     // Ignore LF characters, AT commands are terminated with CR
     if (character == '\n') return;
 
@@ -437,7 +1050,7 @@ static void process_character(char character)
                 process_command();
                 reset();
             } else if (append_to_buffer(character) < 0) {
-                lpuart_write_blocking(ATCI_UNKNOWN_CMD, sizeof(ATCI_UNKNOWN_CMD) - 1);
+                output(ATCI_UNKNOWN_CMD, ATCI_UKNOWN_CMD_LEN, true);
                 reset();
             }
             break;
@@ -449,6 +1062,175 @@ static void process_character(char character)
 }
 
 
+static const uint8_t *find_tlv(const uint8_t *frame, size_t length, uint8_t tag, size_t *tlv_length)
+{
+    size_t i = FRAME_HEADER_SIZE;
+
+    while (i + FRAME_TLV_HEADER_SIZE <= length) {
+        if (i + FRAME_TLV_HEADER_SIZE + frame[i + 1] > length) break;
+        if (frame[i] == tag) {
+            *tlv_length = frame[i + 1];
+            return frame + i + FRAME_TLV_HEADER_SIZE;
+        }
+        i += FRAME_TLV_HEADER_SIZE + frame[i + 1];
+    }
+    return NULL;
+}
+
+
+static void send_nak(uint8_t seq)
+{
+    send_event_frame();
+    state.frame.tx[0] = FRAME_NAK;
+    state.frame.tx[1] = seq;
+    frame_encode(state.frame.tx, FRAME_HEADER_SIZE, write_frame_block);
+}
+
+
+static void process_frame(int length)
+{
+    const uint8_t *value;
+    size_t value_length, n;
+    uint8_t *frame = state.frame.rx;
+
+    if (length < 0) {
+        log_debug("ATCI: Malformed frame");
+        send_nak(0);
+        return;
+    }
+
+    // Send any pending asynchronous output before the response
+    send_event_frame();
+
+    state.frame.request = true;
+    state.frame.seq = frame[1];
+
+    switch(frame[0]) {
+        case FRAME_COMMAND:
+            // The payload of a pending read, e.g., after AT+UTX, is collected
+            // in rx_buffer. It must arrive in DATA frames before the next
+            // command.
+            if (state.read_next_data.length != 0) goto nak;
+            value = find_tlv(frame, length, FRAME_TAG_TEXT, &value_length);
+            if (value == NULL || value_length >= sizeof(state.rx_buffer)) goto nak;
+            memcpy(state.rx_buffer, value, value_length);
+            state.rx_length = value_length;
+            state.rx_buffer[state.rx_length] = 0;
+            process_command();
+            state.rx_length = 0;
+            break;
+
+        case FRAME_DATA:
+            value = find_tlv(frame, length, FRAME_TAG_DATA, &value_length);
+            if (value == NULL || state.read_next_data.length == 0) goto nak;
+            while (value_length && state.read_next_data.length != 0) {
+                n = process_data((const char *)value, value_length);
+                value += n;
+                value_length -= n;
+            }
+            break;
+
+        case FRAME_EXIT:
+            output(ATCI_OK, ATCI_OK_LEN, true);
+            send_text_frame(FRAME_RESPONSE, state.frame.seq);
+            state.frame.request = false;
+            state.frame.enabled = false;
+            return;
+
+        default:
+            goto nak;
+    }
+
+    send_text_frame(FRAME_RESPONSE, state.frame.seq);
+    state.frame.request = false;
+    return;
+
+nak:
+    state.frame.request = false;
+    send_nak(frame[1]);
+}
+
+
+void atci_framed_action(atci_param_t *param)
+{
+    (void)param;
+    output(ATCI_OK, ATCI_OK_LEN, true);
+
+    frame_decoder_init(&state.frame.decoder, state.frame.rx, sizeof(state.frame.rx));
+    state.frame.text_length = 0;
+    state.frame.event_seq = 0;
+    state.frame.enabled = true;
+}
+
+
+bool atci_is_framed(void)
+{
+    return state.frame.enabled;
+}
+
+
+void atci_print_message(uint8_t port, const void *buffer, size_t length)
+{
+    uint8_t *f = state.frame.tx;
+
+    if (length > FRAME_MAX_SIZE - FRAME_HEADER_SIZE - 2 * FRAME_TLV_HEADER_SIZE - 1 - FRAME_CRC_SIZE)
+        halt("Bug: Message too long for a frame");
+
+    send_event_frame();
+
+    f[0] = FRAME_MESSAGE;
+    f[1] = state.frame.event_seq++;
+    f[2] = FRAME_TAG_PORT;
+    f[3] = 1;
+    f[4] = port;
+    f[5] = FRAME_TAG_DATA;
+    f[6] = length;
+    memcpy(f + 7, buffer, length);
+    frame_encode(f, 7 + length, write_frame_block);
+}
+
+
+static void process_segment(const char *data, size_t length)
+{
+    size_t i = 0;
+    int rc;
+
+    while (i < length) {
+        if (state.frame.enabled) {
+            rc = frame_decode(&state.frame.decoder, data[i++]);
+            if (rc != 0) process_frame(rc);
+            continue;
+        }
+
+        // Payload data announced with atci_set_read_next_data is copied or
+        // decoded in bulk, everything else goes through the AT parser
+        if (state.read_next_data.length != 0)
+            i += process_data(data + i, length - i);
+        else
+            process_character(data[i++]);
+    }
+}
+
+
+// Drop the content of the RX FIFO after an overrun. Some of it has been
+// overwritten by newer data. Fail the payload read or the command line that
+// the lost data belonged to rather than pass on corrupted input.
+static void discard_input(void)
+{
+    cbuf_view_t data;
+
+    spsc_head(&lpuart_rx_fifo, &data);
+    lpuart_consume(data.len[0] + data.len[1]);
+
+    if (state.read_next_data.length != 0) {
+        finish_next_data(ATCI_DATA_OVERRUN);
+    } else {
+        output(ATCI_UNKNOWN_CMD, ATCI_UKNOWN_CMD_LEN, true);
+        reset();
+    }
+}
+
+
 void atci_process(void)
 {
     uint32_t masked;
@@ -458,26 +1240,25 @@ void atci_process(void)
     system_sleep_lock &= ~SYSTEM_MODULE_ATCI;
     reenable_irq(masked);
 
+    drain_output();
+    if (state.frame.enabled) send_event_frame();
+
     while (true) {
         if (state.aborted) {
             finish_next_data(ATCI_DATA_ABORTED);
             state.aborted = false;
         }
 
-        masked = disable_irq();
-        cbuf_head(&lpuart_rx_fifo, &data);
-        reenable_irq(masked);
+        // Frames are protected with a CRC, a frame with lost data is NAKed
+        if (lpuart_rx_overrun() && !state.frame.enabled)
+            discard_input();
 
+        spsc_head(&lpuart_rx_fifo, &data);
         if ((data.len[0] + data.len[1]) == 0) break;
 
-        for (size_t i = 0; i < data.len[0]; i++)
-            process_character((char)data.ptr[0][i]);
-
-        for (size_t i = 0; i < data.len[1]; i++)
-            process_character((char)data.ptr[1][i]);
+        process_segment((const char *)data.ptr[0], data.len[0]);
+        process_segment((const char *)data.ptr[1], data.len[1]);
 
-        masked = disable_irq();
-        cbuf_consume(&lpuart_rx_fifo, data.len[0] + data.len[1]);
-        reenable_irq(masked);
+        lpuart_consume(data.len[0] + data.len[1]);
     }
 }
@@ -13,12 +13,15 @@
 #define ATCI_OK "+OK" ATCI_EOL
 #define ATCI_OK_LEN (sizeof(ATCI_OK) - 1)
 
+// The value returned by atci_get_tag outside of tagged commands
+#define ATCI_NO_TAG (-1)
+#define ATCI_MAX_TAG 65535
+
 #define ATCI_COMMANDS_LENGTH(COMMANDS) (sizeof(COMMANDS) / sizeof(COMMANDS[0]))
 
 #define ATCI_COMMAND_CLAC {"+CLAC", atci_clac_action, NULL, NULL, NULL, "List all supported AT commands"}
 #define ATCI_COMMAND_HELP {"$HELP", atci_help_action, NULL, NULL, NULL, "This help"}
-
-#define atci_flush lpuart_flush
+#define ATCI_COMMAND_FRAMED {"$FRAMED", atci_framed_action, NULL, NULL, NULL, "Switch to binary framed mode"}
 
 
 //! @brief AT param struct
@@ -35,7 +38,8 @@ typedef enum
 {
     ATCI_DATA_OK = 0,
     ATCI_DATA_ABORTED = -1,
-    ATCI_DATA_ENCODING_ERROR = -2
+    ATCI_DATA_ENCODING_ERROR = -2,
+    ATCI_DATA_OVERRUN = -3
 } atci_data_status_t;
 
 
@@ -61,10 +65,11 @@ typedef enum
 
 //! @brief Initialize
 //! @param[in] baudrate The baudrate to configure on the UART interface
+//! @param[in] flow_control Enable RTS/CTS flow control on the UART interface
 //! @param[in] commands
 //! @param[in] length Number of commands
 
-void atci_init(unsigned int baudrate, const atci_command_t *commands, int length);
+void atci_init(unsigned int baudrate, bool flow_control, const atci_command_t *commands, int length);
 
 
 //! @brief
@@ -76,6 +81,13 @@ void atci_process(void);
 size_t atci_print(const char *message);
 
 
+//! @brief Print message from a static buffer
+//! The message is not copied if it needs to be queued and thus must remain
+//! valid until it has been transmitted, e.g., a string literal.
+//! @param[in] message Message
+size_t atci_print_static(const char *message);
+
+
 //! @brief Print format message
 //! @param[in] format Format string (printf style)
 //! @param[in] ... Optional format arguments
@@ -97,6 +109,37 @@ size_t atci_print_buffer_as_hex(const void *buffer, size_t length);
 size_t atci_write(const char *buffer, size_t length);
 
 
+//! @brief Print error response and mark the current command as failed
+//! @param[in] code Error code
+void atci_error(int code);
+
+
+//! @brief Configure the processing of lines with multiple commands
+//! @param[in] enabled Skip the remaining commands on a line after an error
+void atci_set_stop_on_error(bool enabled);
+
+
+//! @brief Return true if the remaining commands on a line are skipped after an error
+bool atci_get_stop_on_error(void);
+
+
+//! @brief Return the tag of the command being executed
+//! Asynchronous operations started by the command should save the tag and
+//! restore it with atci_set_tag while reporting their completion.
+//! @return Tag (0 - ATCI_MAX_TAG) or ATCI_NO_TAG for untagged commands
+int32_t atci_get_tag(void);
+
+
+//! @brief Set the tag to prepend to subsequent responses and events
+//! @param[in] tag Tag or ATCI_NO_TAG
+//! @return The previous tag
+int32_t atci_set_tag(int32_t tag);
+
+
+//! @brief Wait until all queued output has been transmitted
+void atci_flush(void);
+
+
 //! @brief Parse buffer from HEX string
 //! @param[in] param Param instance
 //! @param[in] buffer Pointer to destination buffer
@@ -143,4 +186,18 @@ void atci_clac_action(atci_param_t *param);
 //! @brief Helper for help action
 void atci_help_action(atci_param_t *param);
 
+//! @brief Helper for framed action
+void atci_framed_action(atci_param_t *param);
+
+
+//! @brief Return true if the ATCI is in binary framed mode (AT$FRAMED)
+bool atci_is_framed(void);
+
+
+//! @brief Send a downlink message in a message frame (framed mode only)
+//! @param[in] port LoRaWAN port number
+//! @param[in] buffer Pointer to the payload
+//! @param[in] length Payload length in bytes
+void atci_print_message(uint8_t port, const void *buffer, size_t length);
+
 #endif //_ATCI_H
@@ -1,3 +1,5 @@
+#define LOG_MODULE LOG_MODULE_ATCI
+
 #include "cmd.h"
 #include <string.h>
 #include <loramac-node/src/radio/radio.h>
@@ -12,9 +14,12 @@
 #include "log.h"
 #include "rtc.h"
 #include "nvm.h"
+#include "part.h"
+#include "pmlog.h"
 #include "halt.h"
 #include "utils.h"
 #include "sx1276-board.h"
+#include "usart.h"
 
 // These are global variables exported by radio.c that store the RSSI and SNR of
 // the most recent received packet.
@@ -63,19 +68,19 @@ static Gpio_t attach_pin = {
 
 #endif
 
-#define abort(num) do {                     \
-    atci_printf("+ERR=%d" ATCI_EOL, (num)); \
-    return;                                 \
+#define abort(num) do { \
+    atci_error(num);    \
+    return;             \
 } while (0)
 
-#define EOL() atci_print(ATCI_EOL);
+#define EOL() atci_print_static(ATCI_EOL);
 
 #define OK(...) do {                 \
     atci_printf("+OK=" __VA_ARGS__); \
     EOL();                           \
 } while (0)
 
-#define OK_() atci_print(ATCI_OK)
+#define OK_() atci_print_static(ATCI_OK)
 
 
 static inline uint32_t ntohl(uint32_t v)
@@ -158,26 +163,58 @@ static uint8_t *find_key(KeyIdentifier_t id)
 }
 
 
+// Report the baud rate the port actually operates at. That is the default baud
+// rate if the configured baud rate could not be used, or the previous baud rate
+// if a new one has been configured but the modem has not been rebooted yet.
 static void get_uart(void)
 {
-    OK("%d,%d,%d,%d,%d", sysconf.uart_baudrate, 8, 1, 0, 0);
+    OK("%d,%d,%d,%d,%d", lpuart_get_baudrate(), 8, 1, 0, sysconf.uart_flow_control);
 }
 
 
+// AT+UART=<baudrate>[,<data bits>,<stop bits>,<parity>,<flow control>]. Only
+// the baud rate and flow control can be configured, the remaining parameters
+// must be set to 8, 1, 0.
 static void set_uart(atci_param_t *param)
 {
-    uint32_t v;
+    uint32_t v, data_bits, stop_bits, parity, flow_control = sysconf.uart_flow_control;
     if (!atci_param_get_uint(param, &v)) abort(ERR_PARAM);
 
+    if (param->offset != param->length) {
+        if (!atci_param_is_comma(param)) abort(ERR_PARAM);
+        if (!atci_param_get_uint(param, &data_bits)) abort(ERR_PARAM);
+        if (!atci_param_is_comma(param)) abort(ERR_PARAM);
+        if (!atci_param_get_uint(param, &stop_bits)) abort(ERR_PARAM);
+        if (!atci_param_is_comma(param)) abort(ERR_PARAM);
+        if (!atci_param_get_uint(param, &parity)) abort(ERR_PARAM);
+        if (!atci_param_is_comma(param)) abort(ERR_PARAM);
+        if (!atci_param_get_uint(param, &flow_control)) abort(ERR_PARAM);
+        if (param->offset != param->length) abort(ERR_PARAM_NO);
+
+        if (data_bits != 8 || stop_bits != 1 || parity != 0) abort(ERR_PARAM);
+#if LPUART_FLOW_CONTROL == 1
+        if (flow_control > 1) abort(ERR_PARAM);
+#else
+        if (flow_control != 0) abort(ERR_PARAM);
+#endif
+    }
+
     switch(v) {
-        case 4800:  break;
-        case 9600:  break;
-        case 19200: break;
-        case 38400: break;
+        case 4800:   break;
+        case 9600:   break;
+        case 19200:  break;
+        case 38400:  break;
+        case 57600:  break;
+        case 115200: break;
+        case 230400: break;
         default: abort(ERR_PARAM);
     }
 
+    // lpuart_init would fall back to the default rate after reboot
+    if (!lpuart_is_baudrate_supported(v)) abort(ERR_PARAM);
+
     sysconf.uart_baudrate = v;
+    sysconf.uart_flow_control = flow_control;
     sysconf_modified = true;
 
     OK_();
@@ -231,6 +268,8 @@ static void reboot(atci_param_t *param)
     }
 
     if (hard) {
+        // Do not lose NVM writes still queued by part_write_async
+        part_flush();
         NVIC_SystemReset();
     } else {
         OK_();
@@ -373,7 +412,7 @@ static void get_deveui(void)
 {
     MibRequestConfirm_t r = { .Type = MIB_DEV_EUI };
     abort_on_error(LoRaMacMibGetRequestConfirm(&r));
-    atci_print("+OK=");
+    atci_print_static("+OK=");
     atci_print_buffer_as_hex(r.Param.DevEui, SE_EUI_SIZE);
     EOL();
 }
@@ -399,7 +438,7 @@ static void get_joineui(void)
 {
     MibRequestConfirm_t r = { .Type = MIB_JOIN_EUI };
     abort_on_error(LoRaMacMibGetRequestConfirm(&r));
-    atci_print("+OK=");
+    atci_print_static("+OK=");
     atci_print_buffer_as_hex(r.Param.JoinEui, SE_EUI_SIZE);
     EOL();
 }
@@ -425,7 +464,7 @@ static void get_nwkskey(void)
 {
     if (sysconf.lock_keys) abort(ERR_ACCESS_DENIED);
 
-    atci_print("+OK=");
+    atci_print_static("+OK=");
 
     // We operate in a backwards-compatible 1.0 mode here and in that mode, the
     // various network session keys are the same and the canonical version is in
@@ -478,7 +517,7 @@ static void get_appskey(void)
 {
     if (sysconf.lock_keys) abort(ERR_ACCESS_DENIED);
 
-    atci_print("+OK=");
+    atci_print_static("+OK=");
     atci_print_buffer_as_hex(find_key(APP_S_KEY), SE_KEY_SIZE);
     EOL();
 }
@@ -505,7 +544,7 @@ static void get_appkey(void)
 {
     if (sysconf.lock_keys) abort(ERR_ACCESS_DENIED);
 
-    atci_print("+OK=");
+    atci_print_static("+OK=");
     atci_print_buffer_as_hex(find_key(APP_KEY), SE_KEY_SIZE);
     EOL();
 }
@@ -983,6 +1022,117 @@ static void set_sleep(atci_param_t *param)
 }
 
 
+static void get_stoponerr(void)
+{
+    OK("%d", atci_get_stop_on_error());
+}
+
+
+static void set_stoponerr(atci_param_t *param)
+{
+    uint32_t v;
+
+    if (!atci_param_get_uint(param, &v)) abort(ERR_PARAM);
+    if (v > 1) abort(ERR_PARAM);
+    if (param->offset != param->length) abort(ERR_PARAM_NO);
+
+    atci_set_stop_on_error(v);
+    OK_();
+}
+
+
+// AT$UARTSTATS? returns <rx bytes>,<tx bytes>,<rx lost>,<framing errors>,
+// <noise errors>,<parity errors>,<rx fifo high>,<tx fifo high>,<tx blocked ms>,
+// <wakeups>,<tx bursts>,<tx dma starts>,<overrun errors>. New fields are
+// appended at the end.
+static void get_uartstats(void)
+{
+    lpuart_stats_t s;
+    lpuart_get_stats(&s);
+
+    OK("%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu",
+        s.rx_bytes, s.tx_bytes, s.rx_lost,
+        s.framing_errors, s.noise_errors, s.parity_errors,
+        s.rx_fifo_high, s.tx_fifo_high, s.tx_blocked, s.wakeups,
+        s.tx_bursts, s.tx_dma_starts, s.overrun_errors);
+}
+
+
+// AT$UARTSTATS=0 resets all counters
+static void set_uartstats(atci_param_t *param)
+{
+    uint32_t v;
+
+    if (!atci_param_get_uint(param, &v)) abort(ERR_PARAM);
+    if (v != 0) abort(ERR_PARAM);
+    if (param->offset != param->length) abort(ERR_PARAM_NO);
+
+    lpuart_reset_stats();
+    OK_();
+}
+
+
+// AT$NVMSTATS? returns <bytes written>,<bytes written per uplink>,<max bytes
+// written per uplink>. The per-uplink values count the bytes programmed into
+// NVM between two consecutive uplinks, i.e., mostly the state saved by the MAC
+// after the earlier uplink.
+static void get_nvmstats(void)
+{
+    nvm_stats_t s;
+    nvm_get_stats(&s);
+    OK("%lu,%lu,%lu", s.written, s.uplink, s.uplink_max);
+}
+
+
+// AT$NVMSTATS=0 resets all counters
+static void set_nvmstats(atci_param_t *param)
+{
+    uint32_t v;
+
+    if (!atci_param_get_uint(param, &v)) abort(ERR_PARAM);
+    if (v != 0) abort(ERR_PARAM);
+    if (param->offset != param->length) abort(ERR_PARAM_NO);
+
+    nvm_reset_stats();
+    OK_();
+}
+
+
+// AT$LOGDUMP? returns <count>,<events>[,<halt message>] where count is the
+// total number of events recorded in the post-mortem log and events is the hex
+// encoding of the most recent pmlog_entry_t records (at most PMLOG_SIZE),
+// oldest first. See python/lora.py for a decoder.
+static void get_logdump(void)
+{
+    pmlog_entry_t e;
+    uint32_t count = pmlog_count();
+    const char *msg = pmlog_halt_message();
+
+    atci_printf("+OK=%lu,", count);
+    for (uint32_t i = count > PMLOG_SIZE ? count - PMLOG_SIZE : 0; i < count; i++) {
+        if (pmlog_get(&e, i))
+            atci_print_buffer_as_hex(&e, sizeof(e));
+    }
+    if (msg[0] != '\0')
+        atci_printf(",%s", msg);
+    EOL();
+}
+
+
+// AT$LOGDUMP=0 clears the post-mortem log
+static void set_logdump(atci_param_t *param)
+{
+    uint32_t v;
+
+    if (!atci_param_get_uint(param, &v)) abort(ERR_PARAM);
+    if (v != 0) abort(ERR_PARAM);
+    if (param->offset != param->length) abort(ERR_PARAM_NO);
+
+    pmlog_clear();
+    OK_();
+}
+
+
 static void get_port(void)
 {
     OK("%d", sysconf.default_port);
@@ -1074,7 +1224,7 @@ static void transmit(atci_data_status_t status, atci_param_t *param)
 {
     TimerStop(&payload_timer);
 
-    if (status == ATCI_DATA_ENCODING_ERROR)
+    if (status == ATCI_DATA_ENCODING_ERROR || status == ATCI_DATA_OVERRUN)
         abort(ERR_PARAM);
 
     // The original Type ABZ firmware returns an OK if payload submission times
@@ -1157,7 +1307,7 @@ static void get_mcast(void)
 
         atci_printf(";%d,%08lX,", c->GroupID, c->Address);
         atci_print_buffer_as_hex(find_key(keys[2 * i]), SE_KEY_SIZE);
-        atci_print(",");
+        atci_print_static(",");
         atci_print_buffer_as_hex(find_key(keys[2 * i + 1]), SE_KEY_SIZE);
     }
     EOL();
@@ -1577,7 +1727,7 @@ static void get_chmask_comp(void)
 {
     MibRequestConfirm_t r = { .Type = MIB_CHANNELS_MASK };
     abort_on_error(LoRaMacMibGetRequestConfirm(&r));
-    atci_print("+OK=");
+    atci_print_static("+OK=");
     atci_print_buffer_as_hex(r.Param.ChannelsMask, lrw_get_max_channels() / 8);
     EOL();
 }
@@ -1676,6 +1826,9 @@ static void dbg(atci_param_t *param)
     // RF_CAD,        //!< The radio is doing channel activity detection
     atci_printf("sleep_lock=%d stop_lock=%d radio_state=%d loramac_busy=%d\r\n",
         system_sleep_lock, system_stop_lock, Radio.GetStatus(), LoRaMacIsBusy());
+#if DEBUG_LOG != 3
+    atci_printf("usart_dropped=%lu\r\n", (unsigned long)usart_get_dropped());
+#endif
 
     OK_();
 }
@@ -1695,7 +1848,7 @@ static void get_nwkkey(void)
 {
     if (sysconf.lock_keys) abort(ERR_ACCESS_DENIED);
 
-    atci_print("+OK=");
+    atci_print_static("+OK=");
     atci_print_buffer_as_hex(find_key(NWK_KEY), SE_KEY_SIZE);
     EOL();
 }
@@ -1722,7 +1875,7 @@ static void get_fnwksintkey(void)
 {
     if (sysconf.lock_keys) abort(ERR_ACCESS_DENIED);
 
-    atci_print("+OK=");
+    atci_print_static("+OK=");
     atci_print_buffer_as_hex(find_key(F_NWK_S_INT_KEY), SE_KEY_SIZE);
     EOL();
 }
@@ -1749,7 +1902,7 @@ static void get_snwksintkey(void)
 {
     if (sysconf.lock_keys) abort(ERR_ACCESS_DENIED);
 
-    atci_print("+OK=");
+    atci_print_static("+OK=");
     atci_print_buffer_as_hex(find_key(S_NWK_S_INT_KEY), SE_KEY_SIZE);
     EOL();
 }
@@ -1776,7 +1929,7 @@ static void get_nwksenckey(void)
 {
     if (sysconf.lock_keys) abort(ERR_ACCESS_DENIED);
 
-    atci_print("+OK=");
+    atci_print_static("+OK=");
     atci_print_buffer_as_hex(find_key(NWK_S_ENC_KEY), SE_KEY_SIZE);
     EOL();
 }
@@ -1801,13 +1954,13 @@ static void set_nwksenckey(atci_param_t *param)
 
 static void get_chmask(void)
 {
-    atci_print("+OK=");
+    atci_print_static("+OK=");
 
     MibRequestConfirm_t r = { .Type = MIB_CHANNELS_MASK };
     LoRaMacMibGetRequestConfirm(&r);
     atci_print_buffer_as_hex(r.Param.ChannelsMask, lrw_get_max_channels() / 8);
 
-    atci_print(",");
+    atci_print_static(",");
 
     r.Type = MIB_CHANNELS_DEFAULT_MASK;
     LoRaMacMibGetRequestConfirm(&r);
@@ -2002,21 +2155,77 @@ static void get_loglevel(void)
 }
 
 
-static void set_loglevel(atci_param_t *param)
+// Parse <level>[,<burst>,<interval>] and configure the log level and
+// optionally also the rate limit of log modules first to last. With rate
+// limiting, each log call site of a module can emit up to <burst> messages
+// back to back and regains one message every <interval> milliseconds. Burst 0
+// disables rate limiting.
+static void configure_log(atci_param_t *param, int first, int last)
 {
-    (void)param;
-    uint32_t level;
+    uint32_t level, burst = 0, interval = 0;
+    bool rate = false;
 
     if (!atci_param_get_uint(param, &level))
         abort(ERR_PARAM);
 
     if (level > 5) abort(ERR_PARAM);
 
+    if (param->offset < param->length) {
+        if (!atci_param_is_comma(param)) abort(ERR_PARAM);
+        if (!atci_param_get_uint(param, &burst)) abort(ERR_PARAM);
+        if (burst > UINT8_MAX) abort(ERR_PARAM);
+
+        if (!atci_param_is_comma(param)) abort(ERR_PARAM);
+        if (!atci_param_get_uint(param, &interval)) abort(ERR_PARAM);
+        if (interval > UINT16_MAX) abort(ERR_PARAM);
+        if (burst != 0 && interval == 0) abort(ERR_PARAM);
+        rate = true;
+    }
+
     if (param->offset != param->length) abort(ERR_PARAM_NO);
 
-    log_set_level(level);
+    for (int i = first; i <= last; i++) {
+        log_set_module_level(i, level);
+        if (rate) log_set_rate_limit(i, burst, interval);
+    }
     OK_();
 }
+
+
+// AT$LOGLEVEL=<level>[,<burst>,<interval>] configures all log modules
+static void set_loglevel(atci_param_t *param)
+{
+    configure_log(param, 0, LOG_MODULE_MAX - 1);
+}
+
+
+// AT$LOGMOD? returns <level>,<burst>,<interval> for each log module
+// (log_module_t), separated with semicolons
+static void get_logmod(void)
+{
+    uint8_t burst;
+    uint16_t interval;
+
+    atci_print_static("+OK=");
+    for (int i = 0; i < LOG_MODULE_MAX; i++) {
+        log_get_rate_limit(i, &burst, &interval);
+        atci_printf("%s%d,%d,%d", i ? ";" : "", log_get_module_level(i), burst, interval);
+    }
+    EOL();
+}
+
+
+// AT$LOGMOD=<module>,<level>[,<burst>,<interval>] configures one log module
+static void set_logmod(atci_param_t *param)
+{
+    uint32_t module;
+
+    if (!atci_param_get_uint(param, &module)) abort(ERR_PARAM);
+    if (module >= LOG_MODULE_MAX) abort(ERR_PARAM);
+    if (!atci_param_is_comma(param)) abort(ERR_PARAM);
+
+    configure_log(param, module, module);
+}
 #endif
 
 #if CERTIFICATION_ATCI != 0
@@ -2049,24 +2258,24 @@ static void get_session(void)
 {
     MibRequestConfirm_t r;
 
-    atci_print("+OK=");
+    atci_print_static("+OK=");
 
     r.Type = MIB_PUBLIC_NETWORK;
     LoRaMacMibGetRequestConfirm(&r);
     if (r.Param.EnablePublicNetwork) {
-        atci_print("public");
+        atci_print_static("public");
     } else {
-        atci_print("private");
+        atci_print_static("private");
     }
 
     r.Type = MIB_NETWORK_ACTIVATION;
     LoRaMacMibGetRequestConfirm(&r);
-    atci_print(",");
+    atci_print_static(",");
     switch(r.Param.NetworkActivation) {
-        case ACTIVATION_TYPE_NONE: atci_print("None"); break;
-        case ACTIVATION_TYPE_ABP : atci_print("ABP");  break;
-        case ACTIVATION_TYPE_OTAA: atci_print("OTAA"); break;
-        default: atci_print("?"); break;
+        case ACTIVATION_TYPE_NONE: atci_print_static("None"); break;
+        case ACTIVATION_TYPE_ABP : atci_print_static("ABP");  break;
+        case ACTIVATION_TYPE_OTAA: atci_print_static("OTAA"); break;
+        default: atci_print_static("?"); break;
     }
 
     if (r.Param.NetworkActivation != ACTIVATION_TYPE_NONE) {
@@ -2237,7 +2446,7 @@ static void get_time(void)
     // a small number of bytes.
 
     bytes += uint2strlen(time.Seconds) + uint2strlen(time.SubSeconds);
-    SysTime_t delay = uart_tx_delay(sysconf.uart_baudrate, bytes);
+    SysTime_t delay = uart_tx_delay(lpuart_get_baudrate(), bytes);
     time = SysTimeAdd(time, delay);
 
     OK("%lu,%u", time.Seconds, time.SubSeconds);
@@ -2264,7 +2473,7 @@ static void set_time(atci_param_t *param)
     // application was sampled just before the application started transmitting
     // the AT command.
     unsigned int bytes = 8 /* AT$TIME= */ + strlen(param->txt) + 1 /* \r */;
-    SysTime_t delay = uart_tx_delay(sysconf.uart_baudrate, bytes);
+    SysTime_t delay = uart_tx_delay(lpuart_get_baudrate(), bytes);
     time = SysTimeAdd(time, delay);
 
     SysTimeSet(time);
@@ -2295,7 +2504,7 @@ static void get_mcuid(void)
 {
     uint8_t id[8];
     system_get_unique_id(id);
-    atci_print("+OK=");
+    atci_print_static("+OK=");
     atci_print_buffer_as_hex(id, sizeof(id));
     EOL();
 }
@@ -2367,6 +2576,7 @@ static const atci_command_t cmds[] = {
     {"$PAUSE",       pause_tx,        NULL,             NULL,             NULL, "Pause UART TX"},
 #if DEBUG_LOG != 0
     {"$LOGLEVEL",    NULL,            set_loglevel,     get_loglevel,     NULL, "Configure logging on USART port"},
+    {"$LOGMOD",      NULL,            set_logmod,       get_logmod,       NULL, "Configure logging per module"},
 #endif
     {"$SESSION",     NULL,            NULL,             get_session,      NULL, "Get network session information"},
 #if CERTIFICATION_ATCI != 0
@@ -2383,13 +2593,18 @@ static const atci_command_t cmds[] = {
     {"$DEVTIME",     get_device_time, NULL,             NULL,             NULL, "Get network time via DeviceTimeReq MAC command"},
     {"$DEVNONCE",    NULL,            set_devnonce,     get_devnonce,     NULL, "Get or set LoRaWAN 1.1 DevNonce"},
     {"$MCUID",       NULL,            NULL,             get_mcuid,        NULL, "Get the modem's unique MCU ID"},
+    {"$STOPONERR",   NULL,            set_stoponerr,    get_stoponerr,    NULL, "Skip remaining commands on a line after an error"},
+    {"$UARTSTATS",   NULL,            set_uartstats,    get_uartstats,    NULL, "Get or reset (=0) UART statistics"},
+    {"$LOGDUMP",     NULL,            set_logdump,      get_logdump,      NULL, "Get or clear (=0) the post-mortem event log"},
+    {"$NVMSTATS",    NULL,            set_nvmstats,     get_nvmstats,     NULL, "Get or reset (=0) NVM write statistics"},
     ATCI_COMMAND_CLAC,
-    ATCI_COMMAND_HELP};
+    ATCI_COMMAND_HELP,
+    ATCI_COMMAND_FRAMED};
 
 
-void cmd_init(unsigned int baudrate)
+void cmd_init(unsigned int baudrate, bool flow_control)
 {
-    atci_init(baudrate, cmds, ATCI_COMMANDS_LENGTH(cmds));
+    atci_init(baudrate, flow_control, cmds, ATCI_COMMANDS_LENGTH(cmds));
 }
 
 
@@ -41,7 +41,7 @@ enum cmd_event_cert {
 
 extern bool schedule_reset;
 
-void cmd_init(unsigned int baudrate);
+void cmd_init(unsigned int baudrate, bool flow_control);
 
 void cmd_event(unsigned int type, unsigned subtype);
 
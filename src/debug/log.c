@@ -1,11 +1,13 @@
 #include "log.h"
 
+#include <assert.h>
 #include <string.h>
 #include <stdio.h>
 #include <rtt/segger_rtt.h>
 #include "rtc.h"
 #include "system.h"
 #include "usart.h"
+#include "frame.h"
 
 enum log_state
 {
@@ -14,19 +16,68 @@ enum log_state
     LOG_STATE_HAVE_HEADER
 };
 
+typedef struct
+{
+    uint8_t burst;
+    uint16_t interval;
+} log_rate_t;
+
+#if LOG_RATE_SITES != 0
+
+static_assert((LOG_RATE_SITES & (LOG_RATE_SITES - 1)) == 0, "LOG_RATE_SITES must be a power of two");
+
+// Token bucket of a log call site. The buckets form a small hash table indexed
+// by the address of the call site's format string, so the RAM cost does not
+// grow with the number of call sites. Call sites that hash to the same slot
+// share a bucket.
+typedef struct
+{
+    uint32_t time;      // Time of the most recent refill [ms]
+    uint8_t used;       // Tokens taken from the bucket
+} log_bucket_t;
+
+#endif
+
 typedef struct
 {
     bool initialized;
-    log_level_t level;
     log_timestamp_t timestamp;
     uint32_t tick_last;
     enum log_state state;
+    log_rate_t rate[LOG_MODULE_MAX];
+#if LOG_RATE_SITES != 0
+    log_bucket_t bucket[LOG_RATE_SITES];
+#endif
     char buffer[LOG_BUFFER_SIZE];
+#if LOG_BINARY == 1
+    size_t length;
+#endif
 } log_t;
 
+#if LOG_BINARY == 1
+
+// Binary log record, COBS-encoded with CRC by frame_encode (see python/logdec.py):
+//
+//   id (1) | flags (1) | format (2) | [timestamp (4)] | arguments ...
+//
+// The format field is the offset of the format string in the .log_fmt
+// section. The timestamp (ms) is present if the flags have TS_ABS or TS_REL
+// set. Integers and pointers take four bytes, long longs and doubles eight, and
+// strings are sent NUL-terminated. A buffer logged with log_dump follows the
+// arguments as length (2) | data. All values are little-endian.
+#define LOG_BINARY_NO_HEADER 0x01
+#define LOG_BINARY_NO_EOL    0x02
+#define LOG_BINARY_TS_ABS    0x04
+#define LOG_BINARY_TS_REL    0x08
+#define LOG_BINARY_TRUNCATED 0x10
+
+#endif
+
 
 static log_t _log = { .initialized = false };
 
+log_level_t _log_levels[LOG_MODULE_MAX];
+
 
 void _log_init(log_level_t level, log_timestamp_t timestamp)
 {
@@ -34,7 +85,7 @@ void _log_init(log_level_t level, log_timestamp_t timestamp)
 
     memset(&_log, 0, sizeof(_log));
 
-    _log.level = level;
+    _log_set_level(level);
     _log.timestamp = timestamp;
     _log.initialized = true;
     _log.state = LOG_STATE_SIMPLE_MSG;
@@ -49,13 +100,79 @@ void _log_init(log_level_t level, log_timestamp_t timestamp)
 
 log_level_t _log_get_level(void)
 {
-    return _log.level;
+    return _log_levels[LOG_MODULE_DEFAULT];
 }
 
 
 void _log_set_level(log_level_t level)
 {
-    _log.level = level;
+    for (int i = 0; i < LOG_MODULE_MAX; i++)
+        _log_levels[i] = level;
+}
+
+
+log_level_t _log_get_module_level(log_module_t module)
+{
+    return _log_levels[module];
+}
+
+
+void _log_set_module_level(log_module_t module, log_level_t level)
+{
+    _log_levels[module] = level;
+}
+
+
+void _log_set_rate_limit(log_module_t module, uint8_t burst, uint16_t interval)
+{
+    _log.rate[module].burst = interval ? burst : 0;
+    _log.rate[module].interval = interval;
+#if LOG_RATE_SITES != 0
+    memset(_log.bucket, 0, sizeof(_log.bucket));
+#endif
+}
+
+
+void _log_get_rate_limit(log_module_t module, uint8_t *burst, uint16_t *interval)
+{
+    *burst = _log.rate[module].burst;
+    *interval = _log.rate[module].interval;
+}
+
+
+// Take a token from the bucket of the call site with the given format string.
+// Return false if the message must be dropped. Parts of a composite message
+// are never dropped, otherwise the line could be left incomplete.
+static bool _take_token(log_module_t module, const char *format)
+{
+#if LOG_RATE_SITES != 0
+    const log_rate_t *rate = &_log.rate[module];
+    log_bucket_t *bucket;
+    uint32_t now, n;
+
+    if (rate->burst == 0 || _log.state != LOG_STATE_SIMPLE_MSG) return true;
+
+    // Fibonacci hashing, the low bits of the address alone are poorly spread
+    n = (uint32_t)(uintptr_t)format * 2654435761u;
+    bucket = &_log.bucket[(n >> 16) & (LOG_RATE_SITES - 1)];
+
+    now = rtc_tick2ms(rtc_get_timer_value());
+    n = (now - bucket->time) / rate->interval;
+    if (n >= bucket->used) {
+        bucket->used = 0;
+        bucket->time = now;
+    } else {
+        bucket->used -= n;
+        bucket->time += n * rate->interval;
+    }
+
+    if (bucket->used >= rate->burst) return false;
+    bucket->used++;
+#else
+    (void)module;
+    (void)format;
+#endif
+    return true;
 }
 
 
@@ -69,16 +186,12 @@ static void _write(const char *buf, size_t len)
 }
 
 
-static void _write_message(log_level_t level, char id, const char *format, va_list ap)
+static void _write_message(char id, const char *format, va_list ap)
 {
 #if DEBUG_LOG == 0
     return;
 #endif
 
-    if (!_log.initialized) return;
-
-    if (_log.level > level) return;
-
     size_t offset = 0;
 
     if (_log.state == LOG_STATE_SIMPLE_MSG || _log.state == LOG_STATE_COMPOSITE_MSG) {
@@ -119,7 +232,7 @@ static void _write_message(log_level_t level, char id, const char *format, va_li
 }
 
 
-void _log_dump(const void *buffer, size_t length, const char *format, ...)
+void _log_dump(log_module_t module, const void *buffer, size_t length, const char *format, ...)
 {
     size_t position;
     size_t offset;
@@ -131,10 +244,10 @@ void _log_dump(const void *buffer, size_t length, const char *format, ...)
     return;
 #endif
 
-    if (_log.level > LOG_LEVEL_DUMP) return;
+    if (!_log.initialized || !_take_token(module, format)) return;
 
     va_start(ap, format);
-    _write_message(LOG_LEVEL_DUMP, 'X', format, ap);
+    _write_message('X', format, ap);
     va_end(ap);
 
     size_t offset_base = 0;
@@ -199,15 +312,123 @@ void _log_dump(const void *buffer, size_t length, const char *format, ...)
 }
 
 
-void _log_message(log_level_t level, char id, const char *format, ...)
+void _log_message(log_module_t module, char id, const char *format, ...)
 {
     va_list ap;
+
+    if (!_log.initialized || !_take_token(module, format)) return;
+
     va_start(ap, format);
-    _write_message(level, id, format, ap);
+    _write_message(id, format, ap);
     va_end(ap);
 }
 
 
+#if LOG_BINARY == 1
+
+static void _put(const void *data, size_t len)
+{
+    // Leave room for the CRC appended by frame_encode
+    if (_log.length + len > sizeof(_log.buffer) - FRAME_CRC_SIZE) {
+        _log.buffer[1] |= LOG_BINARY_TRUNCATED;
+        _log.length = sizeof(_log.buffer) - FRAME_CRC_SIZE;
+        return;
+    }
+    memcpy(&_log.buffer[_log.length], data, len);
+    _log.length += len;
+}
+
+
+static void _start(char id, uint8_t flags, uint16_t format)
+{
+    _log.buffer[0] = id;
+    _log.buffer[1] = flags;
+    _log.length = 2;
+    _put(&format, sizeof(format));
+}
+
+
+bool _log_binary_begin(log_module_t module, char id, const char *format)
+{
+    uint8_t flags = 0;
+    uint32_t now, timestamp;
+
+    if (!_log.initialized || !_take_token(module, format)) return false;
+
+    if (_log.state == LOG_STATE_COMPOSITE_MSG) {
+        _log.state = LOG_STATE_HAVE_HEADER;
+        flags |= LOG_BINARY_NO_EOL;
+    } else if (_log.state == LOG_STATE_HAVE_HEADER) {
+        flags |= LOG_BINARY_NO_HEADER | LOG_BINARY_NO_EOL;
+    }
+
+    if (!(flags & LOG_BINARY_NO_HEADER) && _log.timestamp != LOG_TIMESTAMP_OFF)
+        flags |= _log.timestamp == LOG_TIMESTAMP_ABS ? LOG_BINARY_TS_ABS : LOG_BINARY_TS_REL;
+
+    // The .log_fmt section is linked at address zero, so the address of the
+    // format string is also its offset in the section
+    _start(id, flags, (uintptr_t)format);
+
+    if (flags & (LOG_BINARY_TS_ABS | LOG_BINARY_TS_REL)) {
+        now = rtc_tick2ms(rtc_get_timer_value());
+        timestamp = now;
+        if (flags & LOG_BINARY_TS_REL) {
+            timestamp = now - _log.tick_last;
+            _log.tick_last = now;
+        }
+        _put(&timestamp, sizeof(timestamp));
+    }
+    return true;
+}
+
+
+void _log_put_u32(uint32_t value)
+{
+    _put(&value, sizeof(value));
+}
+
+
+void _log_put_u64(uint64_t value)
+{
+    _put(&value, sizeof(value));
+}
+
+
+void _log_put_f64(double value)
+{
+    _put(&value, sizeof(value));
+}
+
+
+void _log_put_str(const char *value)
+{
+    if (value == NULL) value = "(null)";
+    _put(value, strlen(value) + 1);
+}
+
+
+void _log_put_ptr(const volatile void *value)
+{
+    _log_put_u32((uintptr_t)value);
+}
+
+
+void _log_put_blob(const void *buffer, size_t length)
+{
+    uint16_t len = length;
+    _put(&len, sizeof(len));
+    _put(buffer, length);
+}
+
+
+void _log_binary_end(void)
+{
+    frame_encode((uint8_t *)_log.buffer, _log.length, _write);
+}
+
+#endif // LOG_BINARY
+
+
 void _log_finish(void)
 {
     switch(_log.state) {
@@ -218,7 +439,13 @@ void _log_finish(void)
             break;
 
         case LOG_STATE_HAVE_HEADER:
+#if LOG_BINARY == 1
+            // Format string zero is the empty string at the start of .log_fmt
+            _start('\0', LOG_BINARY_NO_HEADER, 0);
+            _log_binary_end();
+#else
             _write("\r\n", 2);
+#endif
             break;
 
         default:
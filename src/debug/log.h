@@ -2,11 +2,28 @@
 #define _LOG_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 #ifndef LOG_BUFFER_SIZE
 #define LOG_BUFFER_SIZE 256
 #endif
 
+// Binary (deferred) logging. Instead of formatting each message on the MCU,
+// the format string is stored in the non-loaded ELF section .log_fmt and only
+// its offset within the section, a timestamp, and raw argument values are sent.
+// The messages are reconstructed from the ELF file by python/logdec.py.
+#ifndef LOG_BINARY
+#define LOG_BINARY 0
+#endif
+
+// The number of token buckets for per-call-site rate limiting (a power of
+// two). Call sites are hashed into the buckets by the address of their format
+// string. Set to 0 to compile rate limiting out.
+#ifndef LOG_RATE_SITES
+#define LOG_RATE_SITES 16
+#endif
+
 #define LOG_DUMP_WIDTH 8
 
 //! @brief Log level
@@ -48,27 +65,81 @@ typedef enum
 
 } log_timestamp_t;
 
+//! @brief Log module (subsystem)
+//!
+//! Each module has its own log level and rate limit. A source file selects its
+//! module by defining LOG_MODULE before including any headers, e.g.:
+//!
+//!   #define LOG_MODULE LOG_MODULE_NVM
+//!
+//! Files that do not define LOG_MODULE log into LOG_MODULE_DEFAULT.
+
+typedef enum
+{
+    LOG_MODULE_DEFAULT = 0,  // Everything not listed below
+    LOG_MODULE_ATCI    = 1,  // AT command interface (atci.c, cmd.c)
+    LOG_MODULE_LPUART  = 2,  // LPUART1 driver
+    LOG_MODULE_NVM     = 3,  // Non-volatile memory (nvm.c)
+    LOG_MODULE_PART    = 4,  // EEPROM partitions
+    LOG_MODULE_RADIO   = 5,  // SX1276 radio
+    LOG_MODULE_LORAMAC = 6,  // LoRaMac glue (lrw.c)
+    LOG_MODULE_ADC     = 7,  // ADC (battery and temperature)
+    LOG_MODULE_MAX
+} log_module_t;
+
+#ifndef LOG_MODULE
+#define LOG_MODULE LOG_MODULE_DEFAULT
+#endif
+
 //! @brief Initialize logging facility
 //! @param[in] level Minimum required message level for propagation
 //! @param[in] timestamp Timestamp logging setting
 
 #if DEBUG_LOG != 0
 
+// Minimum required message level per module. Checked by the log_* macros so
+// that a filtered out message only costs a single comparison.
+extern log_level_t _log_levels[LOG_MODULE_MAX];
+
 void _log_init(log_level_t level, log_timestamp_t timestamp);
 
+//! @brief Return the log level of LOG_MODULE_DEFAULT
 log_level_t _log_get_level(void);
 
+//! @brief Set the log level of all modules
 void _log_set_level(log_level_t level);
 
+//! @brief Return the log level of the given module
+log_level_t _log_get_module_level(log_module_t module);
+
+//! @brief Set the log level of the given module
+void _log_set_module_level(log_module_t module, log_level_t level);
+
+//! @brief Configure rate limiting for the given module
+//!
+//! Each call site of the module has a token bucket holding up to @p burst
+//! tokens. A message takes one token and one token is returned to the bucket
+//! every @p interval milliseconds. Messages are dropped while the bucket is
+//! empty. See LOG_RATE_SITES.
+//!
+//! @param[in] module Log module
+//! @param[in] burst The number of messages a call site can log back to back (0 - unlimited)
+//! @param[in] interval The time to regain one message [ms], must be non-zero if @p burst is
+void _log_set_rate_limit(log_module_t module, uint8_t burst, uint16_t interval);
+
+//! @brief Return the rate limiting configuration of the given module
+void _log_get_rate_limit(log_module_t module, uint8_t *burst, uint16_t *interval);
+
 //! @brief Log DUMP message (annotated in log as <X>)
+//! @param[in] module Log module
 //! @param[in] buffer Pointer to source buffer
 //! @param[in] length Number of bytes to be printed
 //! @param[in] format Format string (printf style)
 //! @param[in] ... Optional format arguments
 
-void _log_dump(const void *buffer, size_t length, const char *format, ...) __attribute__ ((format (printf, 3, 4)));
+void _log_dump(log_module_t module, const void *buffer, size_t length, const char *format, ...) __attribute__ ((format (printf, 4, 5)));
 
-void _log_message(log_level_t level, char id, const char *format, ...) __attribute__ ((format (printf, 3, 4)));
+void _log_message(log_module_t module, char id, const char *format, ...) __attribute__ ((format (printf, 3, 4)));
 
 //! @brief Start a log line composed via repeated calls to log_*
 void _log_compose(void);
@@ -79,19 +150,131 @@ void _log_finish(void);
 #define log_init(...)      _log_init(__VA_ARGS__)
 #define log_get_level(...) _log_get_level(__VA_ARGS__)
 #define log_set_level(...) _log_set_level(__VA_ARGS__)
-#define log_dump(...)      _log_dump(__VA_ARGS__)
-#define log_debug(...)     _log_message(LOG_LEVEL_DEBUG, 'D', __VA_ARGS__)
-#define log_info(...)      _log_message(LOG_LEVEL_INFO, 'I', __VA_ARGS__)
-#define log_warning(...)   _log_message(LOG_LEVEL_WARNING, 'W', __VA_ARGS__)
-#define log_error(...)     _log_message(LOG_LEVEL_ERROR, 'E', __VA_ARGS__)
 #define log_compose(...)   _log_compose(__VA_ARGS__)
 #define log_finish(...)    _log_finish(__VA_ARGS__)
 
+#define log_get_module_level(...) _log_get_module_level(__VA_ARGS__)
+#define log_set_module_level(...) _log_set_module_level(__VA_ARGS__)
+#define log_get_rate_limit(...)   _log_get_rate_limit(__VA_ARGS__)
+#define log_set_rate_limit(...)   _log_set_rate_limit(__VA_ARGS__)
+
+#define _LOG_ENABLED(level) ((level) >= _log_levels[LOG_MODULE])
+
+#if LOG_BINARY == 1
+
+//! @brief Start a binary log record
+//! @param[in] module Log module
+//! @param[in] id Message level identifier (D, I, W, E, X)
+//! @param[in] format Format string placed in the .log_fmt section
+//! @return true if the message is to be logged, false if filtered out
+bool _log_binary_begin(log_module_t module, char id, const char *format);
+
+//! @brief Append an argument to the binary log record
+void _log_put_u32(uint32_t value);
+void _log_put_u64(uint64_t value);
+void _log_put_f64(double value);
+void _log_put_str(const char *value);
+void _log_put_ptr(const volatile void *value);
+
+//! @brief Append a memory buffer (log_dump) to the binary log record
+void _log_put_blob(const void *buffer, size_t length);
+
+//! @brief Finish the binary log record and send it
+void _log_binary_end(void);
+
+// Never called. Keeps the compiler's format string checks in binary mode.
+static inline void _log_check(const char *format, ...) __attribute__ ((format (printf, 1, 2)));
+static inline void _log_check(const char *format, ...) { (void)format; }
+
+#define _LOG_PUT(v) _Generic((v),           \
+    char *:             _log_put_str,       \
+    const char *:       _log_put_str,       \
+    float:              _log_put_f64,       \
+    double:             _log_put_f64,       \
+    long long:          _log_put_u64,       \
+    unsigned long long: _log_put_u64,       \
+    void *:             _log_put_ptr,       \
+    const void *:       _log_put_ptr,       \
+    default:            _log_put_u32)(v);
+
+#define _LOG_PUT_0(f)
+#define _LOG_PUT_1(f, a)                      _LOG_PUT(a)
+#define _LOG_PUT_2(f, a, b)                   _LOG_PUT(a) _LOG_PUT(b)
+#define _LOG_PUT_3(f, a, b, c)                _LOG_PUT(a) _LOG_PUT(b) _LOG_PUT(c)
+#define _LOG_PUT_4(f, a, b, c, d)             _LOG_PUT_2(f, a, b) _LOG_PUT_2(f, c, d)
+#define _LOG_PUT_5(f, a, b, c, d, e)          _LOG_PUT_2(f, a, b) _LOG_PUT_3(f, c, d, e)
+#define _LOG_PUT_6(f, a, b, c, d, e, g)       _LOG_PUT_3(f, a, b, c) _LOG_PUT_3(f, d, e, g)
+#define _LOG_PUT_7(f, a, b, c, d, e, g, h)    _LOG_PUT_3(f, a, b, c) _LOG_PUT_4(f, d, e, g, h)
+#define _LOG_PUT_8(f, a, b, c, d, e, g, h, i) _LOG_PUT_4(f, a, b, c, d) _LOG_PUT_4(f, e, g, h, i)
+
+// The number of arguments following the format string (up to 8)
+#define _LOG_NARGS(...) _LOG_NARGS_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0, _)
+#define _LOG_NARGS_(f, a, b, c, d, e, g, h, i, n, ...) n
+
+#define _LOG_CAT(a, b)  _LOG_CAT_(a, b)
+#define _LOG_CAT_(a, b) a ## b
+
+#define _LOG_FIRST(f, ...) f
+
+#define _LOG_FORMAT(...) \
+    static const char _log_fmt[] __attribute__ ((section(".log_fmt"), used)) = _LOG_FIRST(__VA_ARGS__, _)
+
+#define _log_binary(level, id, ...) do {                                \
+    _LOG_FORMAT(__VA_ARGS__);                                           \
+    if (0) _log_check(__VA_ARGS__);                                     \
+    if (_LOG_ENABLED(level) &&                                          \
+        _log_binary_begin(LOG_MODULE, id, _log_fmt)) {                  \
+        _LOG_CAT(_LOG_PUT_, _LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)       \
+        _log_binary_end();                                              \
+    }                                                                   \
+} while (0)
+
+#define _log_binary_dump(buffer, length, ...) do {                      \
+    _LOG_FORMAT(__VA_ARGS__);                                           \
+    if (0) _log_check(__VA_ARGS__);                                     \
+    if (_LOG_ENABLED(LOG_LEVEL_DUMP) &&                                 \
+        _log_binary_begin(LOG_MODULE, 'X', _log_fmt)) {                 \
+        _LOG_CAT(_LOG_PUT_, _LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)       \
+        _log_put_blob(buffer, length);                                  \
+        _log_binary_end();                                              \
+    }                                                                   \
+} while (0)
+
+#define log_dump(...)      _log_binary_dump(__VA_ARGS__)
+#define log_debug(...)     _log_binary(LOG_LEVEL_DEBUG, 'D', __VA_ARGS__)
+#define log_info(...)      _log_binary(LOG_LEVEL_INFO, 'I', __VA_ARGS__)
+#define log_warning(...)   _log_binary(LOG_LEVEL_WARNING, 'W', __VA_ARGS__)
+#define log_error(...)     _log_binary(LOG_LEVEL_ERROR, 'E', __VA_ARGS__)
+
+#else
+
+#define _log_text(level, id, ...) do {                                  \
+    if (_LOG_ENABLED(level))                                            \
+        _log_message(LOG_MODULE, id, __VA_ARGS__);                      \
+} while (0)
+
+#define _log_text_dump(...) do {                                        \
+    if (_LOG_ENABLED(LOG_LEVEL_DUMP))                                   \
+        _log_dump(LOG_MODULE, __VA_ARGS__);                             \
+} while (0)
+
+#define log_dump(...)      _log_text_dump(__VA_ARGS__)
+#define log_debug(...)     _log_text(LOG_LEVEL_DEBUG, 'D', __VA_ARGS__)
+#define log_info(...)      _log_text(LOG_LEVEL_INFO, 'I', __VA_ARGS__)
+#define log_warning(...)   _log_text(LOG_LEVEL_WARNING, 'W', __VA_ARGS__)
+#define log_error(...)     _log_text(LOG_LEVEL_ERROR, 'E', __VA_ARGS__)
+
+#endif // LOG_BINARY
+
 #else
 
 #define log_init(...)      {}
 #define log_get_level(...) {}
 #define log_set_level(...) {}
+#define log_get_module_level(...) {}
+#define log_set_module_level(...) {}
+#define log_get_rate_limit(...)   {}
+#define log_set_rate_limit(...)   {}
 #define log_dump(...)      {}
 #define log_debug(...)     {}
 #define log_info(...)      {}
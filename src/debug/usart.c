@@ -1,7 +1,10 @@
 #include "usart.h"
 #include <stm/STM32L0xx_HAL_Driver/Inc/stm32l0xx_ll_usart.h>
+#include <stm/STM32L0xx_HAL_Driver/Inc/stm32l0xx_ll_dma.h>
 #include <stm/STM32L0xx_HAL_Driver/Inc/stm32l0xx_hal.h>
-#include "cbuf.h"
+#include <assert.h>
+#include <stdbool.h>
+#include "spsc.h"
 #include "irq.h"
 #include "system.h"
 #include "halt.h"
@@ -14,12 +17,16 @@
 #  define CLK_ENABLE __USART1_CLK_ENABLE
 #  define PIN        GPIO_PIN_9
 #  define ALTERNATE  GPIO_AF4_USART1
+#  define DMA_CH     LL_DMA_CHANNEL_2
+#  define DMA_REQ    LL_DMA_REQUEST_3
 #elif DEBUG_LOG == 2
 #  define PORT       USART2
 #  define IRQn       USART2_IRQn
 #  define CLK_ENABLE __USART2_CLK_ENABLE
 #  define PIN        GPIO_PIN_2
 #  define ALTERNATE  GPIO_AF4_USART2
+#  define DMA_CH     LL_DMA_CHANNEL_4
+#  define DMA_REQ    LL_DMA_REQUEST_4
 #else
 #  error Unsupported DEBUG_LOG value
 #endif
@@ -29,14 +36,30 @@
 #define USART_TX_BUFFER_SIZE 1024
 #endif
 
+static_assert(SPSC_VALID_SIZE(USART_TX_BUFFER_SIZE), "USART_TX_BUFFER_SIZE must be a power of two");
+
+// Like LPUART1, the port transmits via DMA from a linear buffer into which data
+// is moved from the TX FIFO. The end of each transfer is detected with the
+// USART transmission complete (TC) interrupt and a zero remaining count in the
+// DMA channel, so the channel needs no interrupt of its own. There is one interrupt per transfer rather than one
+// per byte.
+#ifndef USART_TX_DMA_BUFFER_SIZE
+#define USART_TX_DMA_BUFFER_SIZE 128
+#endif
+
 
 static char tx_buffer[USART_TX_BUFFER_SIZE];
-static cbuf_t tx_fifo;
+static volatile spsc_t tx_fifo;
+static char tx_dma_buffer[USART_TX_DMA_BUFFER_SIZE];
+static volatile bool tx_busy;
+static volatile uint32_t dropped;
 
 
 void usart_init(void)
 {
-    cbuf_init(&tx_fifo, tx_buffer, sizeof(tx_buffer));
+    spsc_init(&tx_fifo, tx_buffer, sizeof(tx_buffer));
+    tx_busy = false;
+    dropped = 0;
     uint32_t masked = disable_irq();
 
     CLK_ENABLE();
@@ -53,9 +76,25 @@ void usart_init(void)
 
     if (LL_USART_Init(PORT, &params) != 0) goto error;
 
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    LL_DMA_SetPeriphRequest(DMA1, DMA_CH, DMA_REQ);
+    LL_DMA_ConfigTransfer(DMA1, DMA_CH,
+        LL_DMA_DIRECTION_MEMORY_TO_PERIPH |
+        LL_DMA_PRIORITY_LOW               |
+        LL_DMA_MODE_NORMAL                |
+        LL_DMA_PERIPH_NOINCREMENT         |
+        LL_DMA_MEMORY_INCREMENT           |
+        LL_DMA_PDATAALIGN_BYTE            |
+        LL_DMA_MDATAALIGN_BYTE);
+    LL_DMA_SetPeriphAddress(DMA1, DMA_CH, LL_USART_DMA_GetRegAddr(PORT, LL_USART_DMA_REG_DATA_TRANSMIT));
+    LL_DMA_SetMemoryAddress(DMA1, DMA_CH, (uint32_t)tx_dma_buffer);
+
+    LL_USART_EnableDMAReq_TX(PORT);
     LL_USART_Enable(PORT);
 
     LL_USART_DisableIT_TXE(PORT);
+    LL_USART_ClearFlag_TC(PORT);
     LL_USART_EnableIT_TC(PORT);
 
     // Configure interrupts
@@ -84,25 +123,44 @@ error:
 }
 
 
-size_t usart_write(const char *buffer, size_t length)
+// Move as much data from the TX FIFO into the DMA buffer as fits and start the
+// transfer. Must be invoked with the DMA channel idle, either from the IRQ
+// handler or with interrupts disabled.
+static void start_tx_dma(void)
 {
     cbuf_view_t v;
+    size_t len;
+
+    len = cbuf_copy_out(tx_dma_buffer, spsc_head(&tx_fifo, &v), sizeof(tx_dma_buffer));
+    spsc_consume(&tx_fifo, len);
+
+    LL_DMA_DisableChannel(DMA1, DMA_CH);
+    LL_DMA_SetDataLength(DMA1, DMA_CH, len);
+    LL_USART_ClearFlag_TC(PORT);
+    LL_DMA_EnableChannel(DMA1, DMA_CH);
+}
+
+
+size_t usart_write(const char *buffer, size_t length)
+{
+    // Log messages can originate in both the main loop and IRQ handlers, so
+    // the producers must be serialized. The consumer (the USART IRQ handler)
+    // never needs to disable interrupts.
     uint32_t masked = disable_irq();
-    cbuf_tail(&tx_fifo, &v);
+    size_t stored = spsc_put(&tx_fifo, buffer, length);
+    dropped += length - stored;
     reenable_irq(masked);
 
-    size_t stored = cbuf_copy_in(&v, buffer, length);
-
     system_wait_hsi();
 
     masked = disable_irq();
-    cbuf_produce(&tx_fifo, stored);
 
-    // Enable the transmission buffer empty interrupt which will pickup the data
-    // written to the FIFO by the above code and start transmitting it.
-    if (!LL_USART_IsEnabledIT_TXE(PORT)) {
+    // If the port is idle, start a DMA transfer. Otherwise, the data will be
+    // picked up by the IRQ handler once the current transfer completes.
+    if (!tx_busy && spsc_length(&tx_fifo) != 0) {
+        tx_busy = true;
         system_stop_lock |= SYSTEM_MODULE_USART;
-        LL_USART_EnableIT_TXE(PORT);
+        start_tx_dma();
     }
 
     reenable_irq(masked);
@@ -110,6 +168,12 @@ size_t usart_write(const char *buffer, size_t length)
 }
 
 
+uint32_t usart_get_dropped(void)
+{
+    return dropped;
+}
+
+
 #if DEBUG_LOG == 1
 void USART1_IRQHandler(void)
 #elif DEBUG_LOG == 2
@@ -118,20 +182,24 @@ void USART2_IRQHandler(void)
 #error Unsupport DEBUG_LOG
 #endif
 {
-    uint8_t c;
+    // TC is set whenever the shift register runs empty. That normally means
+    // that the DMA controller has written the last byte of the transfer, but
+    // it also happens in the middle of a transfer if the DMA controller falls
+    // behind, e.g., during bus contention. The channel must not be
+    // reprogrammed until it has transferred all bytes. A later TC marks the
+    // end of the transfer.
+    if (LL_USART_IsActiveFlag_TC(PORT)) {
+        LL_USART_ClearFlag_TC(PORT);
 
-    if (LL_USART_IsEnabledIT_TXE(PORT) && LL_USART_IsActiveFlag_TXE(PORT)) {
-        if (cbuf_get(&tx_fifo, &c, 1) != 0) {
-            LL_USART_TransmitData8(PORT, c);
+        if (LL_DMA_GetDataLength(DMA1, DMA_CH) != 0) return;
+
+        if (spsc_length(&tx_fifo) != 0) {
+            start_tx_dma();
         } else {
-            LL_USART_DisableIT_TXE(PORT);
+            tx_busy = false;
+            system_stop_lock &= ~SYSTEM_MODULE_USART;
         }
     }
-
-    if (LL_USART_IsActiveFlag_TC(PORT)) {
-        LL_USART_ClearFlag_TC(PORT);
-        system_stop_lock &= ~SYSTEM_MODULE_USART;
-    }
 }
 
 #endif
\ No newline at end of file
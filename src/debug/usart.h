@@ -3,6 +3,7 @@
 #if DEBUG_LOG != 3
 
 #include <stddef.h>
+#include <stdint.h>
 
 //! @brief  Init usart
 
@@ -15,5 +16,9 @@ void usart_init(void);
 
 size_t usart_write(const char *buffer, size_t length);
 
+//! @brief Return the number of bytes dropped by usart_write due to a full FIFO
+
+uint32_t usart_get_dropped(void);
+
 #endif
 #endif /* __USART_H__ */
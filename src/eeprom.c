@@ -7,12 +7,15 @@
 #define _EEPROM_BASE DATA_EEPROM_BASE
 #define _EEPROM_END  DATA_EEPROM_BANK2_END
 #define _EEPROM_IS_BUSY() ((FLASH->SR & FLASH_SR_BSY) != 0UL)
+#define _EEPROM_ERRORS (FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_SIZERR | FLASH_SR_NOTZEROERR)
 
 static bool _eeprom_is_busy(TimerTime_t timeout);
 static void _eeprom_unlock(void);
 static void _eeprom_lock(void);
 static bool _eeprom_write(uint32_t address, size_t *i, uint8_t *buffer, size_t length);
 
+static uint32_t _eeprom_programmed;
+
 bool eeprom_write(uint32_t address, const void *buffer, size_t length)
 {
     // Add EEPROM base offset to address
@@ -37,6 +40,11 @@ bool eeprom_write(uint32_t address, const void *buffer, size_t length)
     while (i < length)
     {
         _eeprom_write(address, &i, (uint8_t *) buffer, length);
+
+        while (_EEPROM_IS_BUSY())
+        {
+            continue;
+        }
     }
 
     _eeprom_lock();
@@ -52,6 +60,61 @@ bool eeprom_write(uint32_t address, const void *buffer, size_t length)
     return true;
 }
 
+size_t eeprom_program(uint32_t address, const void *buffer, size_t length)
+{
+    // Add EEPROM base offset to address
+    address += _EEPROM_BASE;
+
+    // If user attempts to write outside EEPROM area...
+    if ((address + length) > (_EEPROM_END + 1))
+    {
+        // Indicate failure
+        return 0;
+    }
+
+    if (_EEPROM_IS_BUSY())
+    {
+        return 0;
+    }
+
+    _eeprom_unlock();
+
+    size_t i = 0;
+
+    // Skip over words that do not need to be changed and stop after the first
+    // one that does. The memory interface remains unlocked until eeprom_poll
+    // finds that the write operation has finished.
+    while (i < length)
+    {
+        if (_eeprom_write(address, &i, (uint8_t *) buffer, length))
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+int eeprom_poll(void)
+{
+    if (_EEPROM_IS_BUSY())
+    {
+        return EEPROM_BUSY;
+    }
+
+    _eeprom_lock();
+
+    uint32_t errors = FLASH->SR & _EEPROM_ERRORS;
+    if (errors != 0UL)
+    {
+        // The error flags are cleared by writing one
+        FLASH->SR = errors;
+        return EEPROM_ERROR;
+    }
+
+    return EEPROM_READY;
+}
+
 const void *eeprom_mmap(uint32_t address, size_t length)
 {
     // Add EEPROM base offset to address
@@ -84,6 +147,11 @@ bool eeprom_read(uint32_t address, void *buffer, size_t length)
 }
 
 
+uint32_t eeprom_get_programmed(void)
+{
+    return _eeprom_programmed;
+}
+
 size_t eeprom_get_size(void)
 {
     // Return EEPROM memory size
@@ -160,6 +228,7 @@ static bool _eeprom_write(uint32_t address, size_t *i, uint8_t *buffer, size_t l
         if (*((uint32_t *) addr) != value)
         {
             *((uint32_t *) addr) = value;
+            _eeprom_programmed += 4;
 
             write = true;
         }
@@ -173,6 +242,7 @@ static bool _eeprom_write(uint32_t address, size_t *i, uint8_t *buffer, size_t l
         if (*((uint16_t *) addr) != value)
         {
             *((uint16_t *) addr) = value;
+            _eeprom_programmed += 2;
 
             write = true;
         }
@@ -186,6 +256,7 @@ static bool _eeprom_write(uint32_t address, size_t *i, uint8_t *buffer, size_t l
         if (*((uint8_t *) addr) != value)
         {
             *((uint8_t *) addr) = value;
+            _eeprom_programmed += 1;
 
             write = true;
         }
@@ -193,11 +264,6 @@ static bool _eeprom_write(uint32_t address, size_t *i, uint8_t *buffer, size_t l
         *i += 1;
     }
 
-    while (_EEPROM_IS_BUSY())
-    {
-        continue;
-    }
-
     return write;
 }
 
@@ -5,6 +5,10 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#define EEPROM_READY  0
+#define EEPROM_BUSY   1
+#define EEPROM_ERROR -1
+
 //! @brief Write buffer to EEPROM area and verify it
 //! @param[in] address EEPROM start address (starts at 0)
 //! @param[in] buffer Pointer to source buffer
@@ -14,6 +18,35 @@
 
 bool eeprom_write(uint32_t address, const void *buffer, size_t length);
 
+//! @brief Start programming the next word of buffer into EEPROM
+//!
+//! Non-blocking variant of eeprom_write used by the asynchronous writer in
+//! part.c. Words that already hold the desired value are skipped. At most one
+//! word is programmed; the function returns as soon as programming has started
+//! without waiting for it to finish. Must only be invoked after eeprom_poll
+//! returned EEPROM_READY.
+//! @param[in] address EEPROM start address (starts at 0)
+//! @param[in] buffer Pointer to source buffer
+//! @param[in] length Number of bytes remaining to be written
+//! @return The number of bytes from buffer consumed, 0 on failure
+
+size_t eeprom_program(uint32_t address, const void *buffer, size_t length);
+
+//! @brief Return the status of the most recent eeprom_program operation
+//!
+//! The EEPROM memory interface is locked again once the operation completes.
+//! @return EEPROM_BUSY while a word is being programmed
+//! @return EEPROM_ERROR if the operation failed (reported once)
+//! @return EEPROM_READY otherwise
+
+int eeprom_poll(void);
+
+//! @brief Return the number of bytes actually programmed since boot
+//!
+//! Bytes that already held the desired value are not counted.
+
+uint32_t eeprom_get_programmed(void);
+
 //! @brief Read buffer from EEPROM area
 //! @param[in] address EEPROM start address (starts at 0)
 //! @param[out] buffer Pointer to destination buffer
@@ -0,0 +1,129 @@
+#include "frame.h"
+
+
+uint16_t frame_crc16(const void *data, size_t length)
+{
+    const uint8_t *p = data;
+    uint16_t crc = 0xffff;
+
+    while (length--) {
+        crc ^= (uint16_t)*p++ << 8;
+        for (int i = 0; i < 8; i++)
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+
+void frame_decoder_init(frame_decoder_t *decoder, void *buffer, size_t size)
+{
+    decoder->buffer = buffer;
+    decoder->size = size;
+    decoder->length = 0;
+    decoder->code = 0;
+    decoder->left = 0;
+    decoder->error = false;
+}
+
+
+static void reset(frame_decoder_t *decoder)
+{
+    decoder->length = 0;
+    decoder->code = 0;
+    decoder->left = 0;
+    decoder->error = false;
+}
+
+
+static void append(frame_decoder_t *decoder, uint8_t byte)
+{
+    if (decoder->length >= decoder->size) {
+        decoder->error = true;
+        return;
+    }
+    decoder->buffer[decoder->length++] = byte;
+}
+
+
+int frame_decode(frame_decoder_t *decoder, uint8_t byte)
+{
+    size_t length;
+    uint16_t crc;
+
+    if (byte != 0) {
+        if (decoder->error) return 0;
+
+        if (decoder->left == 0) {
+            // The start of a new block. A block shorter than 254 bytes that is
+            // not the last block in the frame is followed by a zero byte.
+            if (decoder->code != 0 && decoder->code != 0xff)
+                append(decoder, 0);
+            decoder->code = byte;
+            decoder->left = byte - 1;
+        } else {
+            append(decoder, byte);
+            decoder->left--;
+        }
+        return 0;
+    }
+
+    // A zero byte terminates the frame. Ignore empty frames, e.g., multiple
+    // consecutive terminators.
+    if (decoder->code == 0) return 0;
+
+    length = decoder->length;
+    if (decoder->error || decoder->left != 0 || length < FRAME_HEADER_SIZE + FRAME_CRC_SIZE) {
+        reset(decoder);
+        return -1;
+    }
+    reset(decoder);
+
+    length -= FRAME_CRC_SIZE;
+    crc = decoder->buffer[length] | decoder->buffer[length + 1] << 8;
+    if (crc != frame_crc16(decoder->buffer, length)) return -1;
+    return length;
+}
+
+
+void frame_encode(uint8_t *frame, size_t length, void (*write)(const char *buffer, size_t length))
+{
+    uint16_t crc = frame_crc16(frame, length);
+    const uint8_t *start = frame, *end;
+    char code;
+
+    frame[length++] = crc & 0xff;
+    frame[length++] = crc >> 8;
+    end = frame + length;
+
+    // Each block consists of a code byte followed by up to 254 non-zero bytes.
+    // The code byte is the length of the block plus one. Blocks shorter than
+    // 254 bytes imply a zero byte after the block, except for the last block.
+    while (true) {
+        const uint8_t *p = start;
+        while (p < end && *p != 0 && p - start < 254) p++;
+
+        code = p - start + 1;
+        write(&code, 1);
+        write((const char *)start, p - start);
+
+        if (p == end) break;
+
+        // A full block implies no zero byte. A zero that follows it starts
+        // the next block and is consumed there.
+        if (p - start == 254) {
+            start = p;
+            continue;
+        }
+
+        start = p + 1;
+        if (start == end) {
+            // The frame ends with a zero byte, encode it as an empty block
+            code = 1;
+            write(&code, 1);
+            break;
+        }
+    }
+
+    code = 0;
+    write(&code, 1);
+}
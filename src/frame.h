@@ -0,0 +1,104 @@
+#ifndef _FRAME_H_
+#define _FRAME_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Binary framing used by the AT command interface in framed mode (AT$FRAMED).
+//
+// Each frame is COBS-encoded and terminated with a zero byte. The decoded
+// frame has the following layout (multi-byte values are little-endian):
+//
+//   type (1) | seq (1) | TLV ... | CRC16 (2)
+//
+// where each TLV is encoded as tag (1) | length (1) | value (length). The CRC
+// is CRC-16/CCITT-FALSE computed over type, seq, and all TLVs. Frames sent by
+// the host carry a sequence number that the modem copies into the response.
+// Frames generated asynchronously by the modem (events, downlinks) carry a
+// sequence number maintained by the modem.
+
+// The maximum size of a decoded frame including the CRC
+#define FRAME_MAX_SIZE 256
+
+// The number of bytes preceding the first TLV
+#define FRAME_HEADER_SIZE 2
+
+// The size of the CRC at the end of each frame
+#define FRAME_CRC_SIZE 2
+
+// The number of bytes preceding the value in a TLV
+#define FRAME_TLV_HEADER_SIZE 2
+
+
+typedef enum frame_type {
+    // Host to modem
+    FRAME_COMMAND  = 0x01,  // TEXT: AT command(s), e.g., AT+DEVEUI? (NAK while a payload is pending)
+    FRAME_DATA     = 0x02,  // DATA: payload for AT+UTX, AT+CTX, AT+PUTX, ... (NAK if none is pending)
+    FRAME_EXIT     = 0x03,  // Leave framed mode
+
+    // Modem to host
+    FRAME_RESPONSE = 0x81,  // TEXT: (the last part of) a response
+    FRAME_PARTIAL  = 0x82,  // TEXT: a part of a response, more will follow
+    FRAME_EVENT    = 0x83,  // TEXT: asynchronous event(s), e.g., +EVENT=1,1
+    FRAME_MESSAGE  = 0x84,  // PORT, DATA: a downlink message
+    FRAME_NAK      = 0x8f   // The frame could not be decoded or processed
+} frame_type_t;
+
+
+typedef enum frame_tag {
+    FRAME_TAG_TEXT = 0x01,
+    FRAME_TAG_DATA = 0x02,
+    FRAME_TAG_PORT = 0x03
+} frame_tag_t;
+
+
+//! @brief Incremental COBS frame decoder
+typedef struct frame_decoder {
+    uint8_t *buffer;
+    size_t size;
+    size_t length;
+    uint8_t code;
+    uint8_t left;
+    bool error;
+} frame_decoder_t;
+
+
+//! @brief Calculate CRC-16/CCITT-FALSE of the given buffer
+//! @param[in] data Pointer to data
+//! @param[in] length Number of bytes
+//! @return CRC value
+uint16_t frame_crc16(const void *data, size_t length);
+
+
+//! @brief Initialize the decoder with the given memory buffer
+//! @param[in] decoder Decoder instance
+//! @param[in] buffer Memory for the decoded frame
+//! @param[in] size The size of the buffer in bytes
+void frame_decoder_init(frame_decoder_t *decoder, void *buffer, size_t size);
+
+
+//! @brief Feed one byte received from the host to the decoder
+//!
+//! Once a complete frame has been received, the function verifies its CRC and
+//! returns the length of the frame sans the CRC. The frame can be found in the
+//! buffer passed to frame_decoder_init and remains valid until the next call.
+//!
+//! @param[in] decoder Decoder instance
+//! @param[in] byte The next byte from the host
+//! @return 0 Need more data
+//! @return >0 The length of the decoded frame
+//! @return -1 A malformed frame or a CRC error
+int frame_decode(frame_decoder_t *decoder, uint8_t byte);
+
+
+//! @brief Append CRC to a frame and write it COBS-encoded with a terminator
+//!
+//! The buffer must have room for FRAME_CRC_SIZE bytes following the frame.
+//!
+//! @param[in] frame Pointer to the frame, starting with the type field
+//! @param[in] length The length of the frame sans CRC
+//! @param[in] write Output function invoked for each encoded block
+void frame_encode(uint8_t *frame, size_t length, void (*write)(const char *buffer, size_t length));
+
+#endif // _FRAME_H_
@@ -1,10 +1,12 @@
 #include "halt.h"
 #include <stm/STM32L0xx_HAL_Driver/Inc/stm32l0xx_ll_exti.h>
-#include "lpuart.h"
+#include "atci.h"
 #include "log.h"
 #include "system.h"
 #include "cmd.h"
 #include "irq.h"
+#include "pmlog.h"
+#include "part.h"
 
 
 __attribute__((noreturn)) void halt(const char *msg)
@@ -12,15 +14,19 @@ __attribute__((noreturn)) void halt(const char *msg)
 #if DEBUG_LOG != 0
     const char prefix[] = "Halted";
 #endif
+    pmlog_halt(msg);
     cmd_event(CMD_EVENT_MODULE, CMD_MODULE_HALT);
 
     if (msg == NULL) {
-        log_error(prefix);
+        log_error("%s", prefix);
     } else {
         log_error("%s: %s\r\n", prefix, msg);
     }
 
-    lpuart_flush();
+    // Complete the NVM writes queued by part_write_async, e.g., the MAC state
+    // saved before the error, since only a reset can bring the modem back
+    part_flush();
+    atci_flush();
 
     disable_irq();
 
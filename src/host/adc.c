@@ -0,0 +1,51 @@
+#include "adc.h"
+
+// The host build reports a constant supply voltage and temperature
+
+#define HOST_VDD_MV       3000
+#define HOST_TEMPERATURE  25
+
+
+void adc_init(void)
+{
+}
+
+
+void adc_before_stop(void)
+{
+}
+
+
+void adc_after_stop(void)
+{
+}
+
+
+void adc_deinit(void)
+{
+}
+
+
+uint16_t adc_get_value(uint32_t channel)
+{
+    (void)channel;
+    return 0;
+}
+
+
+uint16_t adc_get_battery_level(void)
+{
+    return HOST_VDD_MV;
+}
+
+
+uint16_t adc_get_temperature_level(void)
+{
+    return HOST_TEMPERATURE << 8;
+}
+
+
+float adc_get_temperature_celsius(void)
+{
+    return HOST_TEMPERATURE;
+}
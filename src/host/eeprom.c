@@ -0,0 +1,154 @@
+#define _GNU_SOURCE
+#include "eeprom.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stm/include/stm32l072xx.h>
+#include "host.h"
+
+// The EEPROM is emulated with a file mapped into memory. The file has the same
+// size and layout as the data EEPROM of the STM32L072, so an image can be
+// copied between the host build and a device.
+#define EEPROM_FILE_DEFAULT "eeprom.bin"
+
+#define _EEPROM_SIZE (DATA_EEPROM_BANK2_END - DATA_EEPROM_BASE + 1)
+
+static uint8_t *_eeprom;
+static uint32_t _eeprom_programmed;
+
+static uint8_t *_eeprom_map(void);
+
+bool eeprom_write(uint32_t address, const void *buffer, size_t length)
+{
+    uint8_t *mem = _eeprom_map();
+
+    // If user attempts to write outside EEPROM area...
+    if ((address + length) > _EEPROM_SIZE)
+    {
+        // Indicate failure
+        return false;
+    }
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (mem[address + i] != ((const uint8_t *) buffer)[i]) _eeprom_programmed++;
+    }
+
+    memcpy(mem + address, buffer, length);
+
+    // Indicate success
+    return true;
+}
+
+size_t eeprom_program(uint32_t address, const void *buffer, size_t length)
+{
+    // Emulate word-by-word programming so that the asynchronous writer behaves
+    // the same as on the device, only without the delays
+    if (length > sizeof(uint32_t))
+        length = sizeof(uint32_t);
+
+    return eeprom_write(address, buffer, length) ? length : 0;
+}
+
+int eeprom_poll(void)
+{
+    return EEPROM_READY;
+}
+
+const void *eeprom_mmap(uint32_t address, size_t length)
+{
+    uint8_t *mem = _eeprom_map();
+
+    // If user attempts to read outside of EEPROM boundary...
+    if ((address + length) > _EEPROM_SIZE)
+    {
+        // Indicate failure
+        return NULL;
+    }
+
+    return mem + address;
+}
+
+bool eeprom_read(uint32_t address, void *buffer, size_t length)
+{
+    const void *mem = eeprom_mmap(address, length);
+    if (mem == NULL)
+    {
+        // Indicate failure
+        return false;
+    }
+
+    // Read from EEPROM memory to buffer
+    memcpy(buffer, mem, length);
+
+    // Indicate success
+    return true;
+}
+
+uint32_t eeprom_get_programmed(void)
+{
+    return _eeprom_programmed;
+}
+
+size_t eeprom_get_size(void)
+{
+    // Return EEPROM memory size
+    return _EEPROM_SIZE;
+}
+
+static uint8_t *_eeprom_map(void)
+{
+    const char *pathname;
+    struct stat st;
+    void *mem;
+    int fd;
+
+    if (_eeprom != NULL)
+    {
+        return _eeprom;
+    }
+
+    pathname = getenv(HOST_ENV_EEPROM);
+    if (pathname == NULL)
+    {
+        pathname = EEPROM_FILE_DEFAULT;
+    }
+
+    // The EEPROM is accessed before the AT command interface has been
+    // initialized, so we cannot use halt here to report errors.
+    fd = open(pathname, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        goto error;
+    }
+
+    if (fstat(fd, &st) < 0)
+    {
+        goto error;
+    }
+
+    // A newly created file reads as zeroes, which is also the content of
+    // erased EEPROM on the STM32L0
+    if (st.st_size != _EEPROM_SIZE && ftruncate(fd, _EEPROM_SIZE) < 0)
+    {
+        goto error;
+    }
+
+    mem = mmap(NULL, _EEPROM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED)
+    {
+        goto error;
+    }
+
+    close(fd);
+    _eeprom = mem;
+    return _eeprom;
+
+error:
+    perror(pathname);
+    exit(EXIT_FAILURE);
+}
@@ -0,0 +1,58 @@
+#include "gpio.h"
+#include <stddef.h>
+
+// GPIO ports of the host build. There are no pins to drive, the output and
+// input registers are only kept in memory.
+
+GPIO_TypeDef host_gpio[6];
+
+static gpio_irq_handler_t *_gpio_irq[16] = {NULL};
+
+
+static uint8_t get_bit_pos(uint16_t pin)
+{
+    uint8_t pos = 0;
+    while (pin >>= 1) pos++;
+    return pos;
+}
+
+
+void gpio_init(GPIO_TypeDef *port, uint16_t pin, GPIO_InitTypeDef *init_struct)
+{
+    (void)port;
+    init_struct->Pin = pin;
+}
+
+
+void gpio_set_irq(GPIO_TypeDef *port, uint16_t pin, uint32_t prio, gpio_irq_handler_t *irqHandler)
+{
+    (void)port;
+    (void)prio;
+    _gpio_irq[get_bit_pos(pin)] = irqHandler;
+}
+
+
+void gpio_hal_msp_irq_handler(uint16_t pin)
+{
+    gpio_irq_handler_t *handler = _gpio_irq[get_bit_pos(pin)];
+    if (handler != NULL) handler(NULL);
+}
+
+
+void gpio_write(GPIO_TypeDef *port, uint16_t pin, uint32_t value)
+{
+    if (value) port->ODR |= pin;
+    else port->ODR &= ~pin;
+}
+
+
+uint32_t gpio_read(GPIO_TypeDef *port, uint16_t pin)
+{
+    return (port->IDR & pin) != 0;
+}
+
+
+void GpioWrite(Gpio_t *obj, uint32_t value)
+{
+    gpio_write(obj->port, obj->pinIndex, value);
+}
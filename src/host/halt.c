@@ -0,0 +1,22 @@
+#include "halt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "atci.h"
+#include "log.h"
+#include "cmd.h"
+#include "pmlog.h"
+#include "part.h"
+
+
+// On the STM32, halt stops the MCU until it is reset via the external reset
+// pin. The host version emits the same event and terminates the process.
+__attribute__((noreturn)) void halt(const char *msg)
+{
+    pmlog_halt(msg);
+    cmd_event(CMD_EVENT_MODULE, CMD_MODULE_HALT);
+    part_flush();
+    atci_flush();
+
+    fprintf(stderr, "Halted%s%s\n", msg ? ": " : "", msg ? msg : "");
+    exit(EXIT_FAILURE);
+}
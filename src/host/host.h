@@ -0,0 +1,80 @@
+#ifndef __HOST_H__
+#define __HOST_H__
+
+// Glue between the emulated peripherals of the host build. On the STM32, the
+// peripherals signal events through interrupts which wake the MCU from
+// system_idle. In the host build, system_idle waits for the events instead and
+// invokes the corresponding handlers itself, still with "interrupts" disabled.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Environment variables used to configure the host build at runtime:
+//
+// LORA_MODEM_EEPROM   - pathname of the EEPROM image file (default: eeprom.bin)
+// LORA_MODEM_PTY      - pathname of a symbolic link to create to the LPUART1
+//                       pseudo-terminal, e.g., /tmp/lora
+// LORA_MODEM_ID       - MCU unique ID as a 64-bit hexadecimal number. Derived
+//                       from the EEPROM image pathname if unset, so that each
+//                       modem with its own EEPROM image gets a distinct DevEUI.
+// LORA_MODEM_CLOCK    - set to "virtual" to run the RTC in virtual time which
+//                       jumps to the next timer deadline whenever the firmware
+//                       is idle (default: wall-clock time)
+// LORA_MODEM_ETHER    - UDP multicast group and port shared by emulated radios,
+//                       e.g., 239.76.82.1:4321. The radio transmits into the
+//                       void and never receives anything if unset.
+// LORA_MODEM_ETHER_TX - destination address and port of transmitted datagrams
+//                       if different from LORA_MODEM_ETHER, e.g., a channel
+//                       model such as python/fleet.py
+//
+// LORA_MODEM_PTY_FD is set internally to hand the pseudo-terminal over to the
+// new process image across NVIC_SystemReset.
+
+#define HOST_ENV_EEPROM   "LORA_MODEM_EEPROM"
+#define HOST_ENV_PTY      "LORA_MODEM_PTY"
+#define HOST_ENV_ID       "LORA_MODEM_ID"
+#define HOST_ENV_CLOCK    "LORA_MODEM_CLOCK"
+#define HOST_ENV_ETHER    "LORA_MODEM_ETHER"
+#define HOST_ENV_ETHER_TX "LORA_MODEM_ETHER_TX"
+#define HOST_ENV_PTY_FD   "LORA_MODEM_PTY_FD"
+
+//! @brief Return the file descriptor of the LPUART1 pseudo-terminal master
+
+int lpuart_host_fd(void);
+
+//! @brief Return true if the LPUART1 TX FIFO has data waiting to be sent
+
+bool lpuart_host_tx_pending(void);
+
+//! @brief Transfer data between the pseudo-terminal and the LPUART1 FIFOs
+//! @param[in] readable The pseudo-terminal has data for the RX FIFO
+//! @param[in] writable The pseudo-terminal can accept data from the TX FIFO
+
+void lpuart_host_service(bool readable, bool writable);
+
+//! @brief Return the number of milliseconds until the RTC alarm fires
+//! @return -1 if no alarm is armed, 0 if the alarm is due
+
+int rtc_host_alarm_timeout(void);
+
+//! @brief Return the file descriptor of the radio ether socket or -1
+
+int radio_host_fd(void);
+
+//! @brief Deliver datagrams waiting on the radio ether socket to the radio
+
+void radio_host_service(void);
+
+//! @brief Return true if the RTC runs in virtual time
+
+bool rtc_host_virtual_time(void);
+
+//! @brief Advance virtual time to the RTC alarm, if one is armed
+
+void rtc_host_skip_to_alarm(void);
+
+//! @brief Fire the RTC alarm if it is due
+
+void rtc_host_service(void);
+
+#endif // __HOST_H__
@@ -0,0 +1,100 @@
+#ifndef __HOST_STM32L0XX_HAL_H__
+#define __HOST_STM32L0XX_HAL_H__
+
+// A minimal subset of the STM32L0 HAL used by the portable parts of the
+// firmware (src/gpio.h, src/spi.h, src/rtc.h, main.c, cmd.c). Only types and
+// constants referenced by those files are provided. The functions are
+// implemented by the modules in src/host.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stm/include/cmsis_compiler.h>
+
+typedef enum
+{
+    HAL_OK      = 0x00U,
+    HAL_ERROR   = 0x01U,
+    HAL_BUSY    = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+    RESET = 0,
+    SET = !RESET
+} FlagStatus, ITStatus;
+
+#define __IO volatile
+#define __weak __attribute__((weak))
+
+typedef struct
+{
+    __IO uint32_t IDR;
+    __IO uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef struct
+{
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+    uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+extern GPIO_TypeDef host_gpio[6];
+
+#define GPIOA (&host_gpio[0])
+#define GPIOB (&host_gpio[1])
+#define GPIOC (&host_gpio[2])
+#define GPIOD (&host_gpio[3])
+#define GPIOE (&host_gpio[4])
+#define GPIOH (&host_gpio[5])
+
+#define GPIO_PIN_0   ((uint16_t)0x0001U)
+#define GPIO_PIN_1   ((uint16_t)0x0002U)
+#define GPIO_PIN_2   ((uint16_t)0x0004U)
+#define GPIO_PIN_3   ((uint16_t)0x0008U)
+#define GPIO_PIN_4   ((uint16_t)0x0010U)
+#define GPIO_PIN_5   ((uint16_t)0x0020U)
+#define GPIO_PIN_6   ((uint16_t)0x0040U)
+#define GPIO_PIN_7   ((uint16_t)0x0080U)
+#define GPIO_PIN_8   ((uint16_t)0x0100U)
+#define GPIO_PIN_9   ((uint16_t)0x0200U)
+#define GPIO_PIN_10  ((uint16_t)0x0400U)
+#define GPIO_PIN_11  ((uint16_t)0x0800U)
+#define GPIO_PIN_12  ((uint16_t)0x1000U)
+#define GPIO_PIN_13  ((uint16_t)0x2000U)
+#define GPIO_PIN_14  ((uint16_t)0x4000U)
+#define GPIO_PIN_15  ((uint16_t)0x8000U)
+#define GPIO_PIN_All ((uint16_t)0xFFFFU)
+
+#define GPIO_MODE_INPUT              (0x00000000U)
+#define GPIO_MODE_OUTPUT_PP          (0x00000001U)
+#define GPIO_MODE_OUTPUT_OD          (0x00000011U)
+#define GPIO_MODE_AF_PP              (0x00000002U)
+#define GPIO_MODE_AF_OD              (0x00000012U)
+#define GPIO_MODE_ANALOG             (0x00000003U)
+#define GPIO_MODE_IT_RISING          (0x10110000U)
+#define GPIO_MODE_IT_FALLING         (0x10210000U)
+#define GPIO_MODE_IT_RISING_FALLING  (0x10310000U)
+
+#define GPIO_NOPULL   (0x00000000U)
+#define GPIO_PULLUP   (0x00000001U)
+#define GPIO_PULLDOWN (0x00000002U)
+
+#define GPIO_SPEED_LOW       (0x00000000U)
+#define GPIO_SPEED_MEDIUM    (0x00000001U)
+#define GPIO_SPEED_HIGH      (0x00000002U)
+#define GPIO_SPEED_VERY_HIGH (0x00000003U)
+
+typedef struct
+{
+    void *Instance;
+} SPI_HandleTypeDef;
+
+void HAL_Delay(uint32_t delay);
+
+__attribute__((noreturn)) void NVIC_SystemReset(void);
+
+#endif // __HOST_STM32L0XX_HAL_H__
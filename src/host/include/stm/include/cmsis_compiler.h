@@ -0,0 +1,49 @@
+#ifndef __HOST_CMSIS_COMPILER_H__
+#define __HOST_CMSIS_COMPILER_H__
+
+// A minimal replacement for the CMSIS compiler header used by the host build.
+// The host firmware runs in a single thread and emulated peripherals only
+// signal their "interrupts" from within system_idle. Thus, the PRIMASK
+// register can be emulated with a plain variable.
+
+#include <stdint.h>
+
+#ifndef __STATIC_INLINE
+#define __STATIC_INLINE static inline
+#endif
+
+#ifndef __STATIC_FORCEINLINE
+#define __STATIC_FORCEINLINE __attribute__((always_inline)) static inline
+#endif
+
+#ifndef __NOP
+#define __NOP() __asm volatile ("nop")
+#endif
+
+extern volatile uint32_t host_primask;
+
+
+__STATIC_FORCEINLINE uint32_t __get_PRIMASK(void)
+{
+    return host_primask;
+}
+
+
+__STATIC_FORCEINLINE void __set_PRIMASK(uint32_t mask)
+{
+    host_primask = mask;
+}
+
+
+__STATIC_FORCEINLINE void __disable_irq(void)
+{
+    host_primask = 1;
+}
+
+
+__STATIC_FORCEINLINE void __enable_irq(void)
+{
+    host_primask = 0;
+}
+
+#endif // __HOST_CMSIS_COMPILER_H__
@@ -0,0 +1,11 @@
+#ifndef __HOST_STM32L072XX_H__
+#define __HOST_STM32L072XX_H__
+
+// Memory layout constants of the STM32L072 that are used by portable code. The
+// host EEPROM emulation in src/host/eeprom.c provides the same 6 kB data
+// EEPROM, addressed relative to DATA_EEPROM_BASE.
+
+#define DATA_EEPROM_BASE      (0x08080000UL)
+#define DATA_EEPROM_BANK2_END (0x080817FFUL)
+
+#endif // __HOST_STM32L072XX_H__
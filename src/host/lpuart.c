@@ -0,0 +1,295 @@
+#define _GNU_SOURCE
+#include "lpuart.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include "host.h"
+#include "halt.h"
+#include "spsc.h"
+#include "irq.h"
+#include "system.h"
+#include "rtc.h"
+
+#ifndef LPUART_BUFFER_SIZE
+#define LPUART_BUFFER_SIZE 512
+#endif
+
+#ifndef LPUART_RX_BUFFER_SIZE
+#define LPUART_RX_BUFFER_SIZE 1024
+#endif
+
+static unsigned char tx_buffer[LPUART_BUFFER_SIZE];
+volatile spsc_t lpuart_tx_fifo;
+
+static unsigned char rx_buffer[LPUART_RX_BUFFER_SIZE];
+volatile spsc_t lpuart_rx_fifo;
+
+static int master = -1;
+static int slave = -1;
+static bool tx_paused;
+static unsigned int baudrate;
+static lpuart_stats_t stats;
+
+
+static void open_pty(void)
+{
+    struct termios tio;
+    const char *name, *link, *fd;
+
+    // If the firmware has been restarted with NVIC_SystemReset, reuse the
+    // pseudo-terminal of the previous process image.
+    fd = getenv(HOST_ENV_PTY_FD);
+    if (fd != NULL) {
+        master = atoi(fd);
+        unsetenv(HOST_ENV_PTY_FD);
+    } else {
+        master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0) goto error;
+        if (grantpt(master) < 0) goto error;
+        if (unlockpt(master) < 0) goto error;
+    }
+
+    if (fcntl(master, F_SETFL, O_NONBLOCK) < 0) goto error;
+
+    name = ptsname(master);
+    if (name == NULL) goto error;
+
+    // Keep the slave end open so that the master does not signal a hang-up
+    // while no host application is connected. The line discipline must be put
+    // into raw mode, otherwise it would echo and translate received data.
+    slave = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (slave < 0) goto error;
+
+    if (tcgetattr(slave, &tio) < 0) goto error;
+    cfmakeraw(&tio);
+    if (tcsetattr(slave, TCSANOW, &tio) < 0) goto error;
+
+    link = getenv(HOST_ENV_PTY);
+    if (link != NULL) {
+        unlink(link);
+        if (symlink(name, link) < 0) goto error;
+    }
+
+    fprintf(stderr, "lpuart: %s\n", name);
+    return;
+
+error:
+    perror("lpuart");
+    halt("Error while creating LPUART pseudo-terminal");
+}
+
+
+void lpuart_init(unsigned int rate, bool flow_control)
+{
+    // The pseudo-terminal transfers data at the speed of the host application,
+    // the baudrate is only kept for informational purposes. There is no flow
+    // control, the pseudo-terminal buffers data in the kernel.
+    baudrate = rate;
+    (void)flow_control;
+
+    spsc_init(&lpuart_tx_fifo, tx_buffer, sizeof(tx_buffer));
+    spsc_init(&lpuart_rx_fifo, rx_buffer, sizeof(rx_buffer));
+    tx_paused = false;
+
+    if (master < 0) open_pty();
+}
+
+
+// The counterpart of the TX DMA transfer on the STM32. Write as much data from
+// the TX FIFO into the pseudo-terminal as possible without blocking.
+static void flush_tx_fifo(void)
+{
+    cbuf_view_t v;
+    ssize_t n;
+    bool flushed = false;
+
+    while (!tx_paused && spsc_length(&lpuart_tx_fifo)) {
+        spsc_head(&lpuart_tx_fifo, &v);
+        if (v.len[0]) n = write(master, v.ptr[0], v.len[0]);
+        else n = write(master, v.ptr[1], v.len[1]);
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN || flushed) break;
+
+            // The pseudo-terminal's input queue is full, i.e., nobody has been
+            // reading from the slave end. A physical UART does not wait for the
+            // receiver either. Discard the unread data and try again.
+            tcflush(slave, TCIFLUSH);
+            flushed = true;
+            continue;
+        }
+        spsc_consume(&lpuart_tx_fifo, n);
+        stats.tx_dma_starts++;
+        stats.tx_bytes += n;
+    }
+}
+
+
+size_t lpuart_produce(size_t length)
+{
+    if (spsc_length(&lpuart_tx_fifo) == 0 && length) stats.tx_bursts++;
+    size_t written = spsc_produce(&lpuart_tx_fifo, length);
+    if (spsc_length(&lpuart_tx_fifo) > stats.tx_fifo_high)
+        stats.tx_fifo_high = spsc_length(&lpuart_tx_fifo);
+
+    uint32_t masked = disable_irq();
+    flush_tx_fifo();
+    reenable_irq(masked);
+    return written;
+}
+
+
+size_t lpuart_write(const char *buffer, size_t length)
+{
+    cbuf_view_t v;
+
+    spsc_tail(&lpuart_tx_fifo, &v);
+    size_t written = cbuf_copy_in(&v, buffer, length);
+    return lpuart_produce(written);
+}
+
+
+void lpuart_wait_tx_space(size_t length)
+{
+    uint32_t masked, start;
+
+    if (spsc_space(&lpuart_tx_fifo) >= length) return;
+
+    start = rtc_get_timer_value();
+    while (spsc_space(&lpuart_tx_fifo) < length) {
+        masked = disable_irq();
+        if (spsc_space(&lpuart_tx_fifo) < length)
+            system_idle();
+        reenable_irq(masked);
+    }
+    stats.tx_blocked += rtc_tick2ms(rtc_get_timer_value() - start);
+}
+
+
+size_t lpuart_read(char *buffer, size_t length)
+{
+    return spsc_get(&lpuart_rx_fifo, buffer, length);
+}
+
+
+bool lpuart_rx_overrun(void)
+{
+    // See lpuart_host_service, the RX FIFO never overruns on the host
+    return false;
+}
+
+
+void lpuart_consume(size_t length)
+{
+    spsc_consume(&lpuart_rx_fifo, length);
+}
+
+
+bool lpuart_is_baudrate_supported(unsigned int rate)
+{
+    // The pseudo-terminal has no clock to derive the baud rate from
+    return rate != 0;
+}
+
+
+unsigned int lpuart_get_baudrate(void)
+{
+    return baudrate;
+}
+
+
+void lpuart_get_stats(lpuart_stats_t *dst)
+{
+    *dst = stats;
+}
+
+
+void lpuart_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+
+void lpuart_flush(void)
+{
+    uint32_t masked;
+    while (spsc_length(&lpuart_tx_fifo) && !tx_paused) {
+        masked = disable_irq();
+        system_idle();
+        reenable_irq(masked);
+    }
+}
+
+
+void lpuart_before_stop(void)
+{
+}
+
+
+void lpuart_after_stop(void)
+{
+}
+
+
+void lpuart_pause_tx(void)
+{
+    tx_paused = true;
+}
+
+
+void lpuart_resume_tx(void)
+{
+    tx_paused = false;
+    flush_tx_fifo();
+}
+
+
+bool lpuart_is_tx_paused(void)
+{
+    return tx_paused;
+}
+
+
+int lpuart_host_fd(void)
+{
+    return master;
+}
+
+
+bool lpuart_host_tx_pending(void)
+{
+    return spsc_length(&lpuart_tx_fifo) != 0 && !tx_paused;
+}
+
+
+// Invoked from system_idle with interrupts disabled, i.e., in the same context
+// as the LPUART1 and DMA interrupt handlers on the STM32.
+void lpuart_host_service(bool readable, bool writable)
+{
+    cbuf_view_t v;
+    ssize_t n;
+
+    if (writable) flush_tx_fifo();
+
+    while (readable) {
+        // Unlike on the STM32, there is no read overrun here. If the RX FIFO
+        // is full, the data remains queued in the pseudo-terminal until the
+        // ATCI has made some room.
+        spsc_tail(&lpuart_rx_fifo, &v);
+        if (v.len[0] == 0) break;
+
+        n = read(master, v.ptr[0], v.len[0]);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        spsc_produce(&lpuart_rx_fifo, n);
+        stats.rx_bytes += n;
+        if (spsc_length(&lpuart_rx_fifo) > stats.rx_fifo_high)
+            stats.rx_fifo_high = spsc_length(&lpuart_rx_fifo);
+    }
+}
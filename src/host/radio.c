@@ -0,0 +1,732 @@
+#define _GNU_SOURCE
+#define LOG_MODULE LOG_MODULE_RADIO
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <loramac-node/src/radio/radio.h>
+#include <LoRaWAN/Utilities/timeServer.h>
+#include "host.h"
+#include "log.h"
+#include "halt.h"
+#include "system.h"
+
+// An emulated radio for the host build. The LoRaMac-node MAC talks to the
+// radio exclusively through the Radio driver structure, so the emulation is
+// implemented at that level rather than at the level of SX1276 registers.
+// Transmissions complete after their time on air and receive windows time out
+// after the configured number of symbols, just like they would with an SX1276.
+//
+// If LORA_MODEM_ETHER is set, the radio joins a UDP multicast group (the
+// "ether") shared by all emulated radios on the host. Each transmitted packet
+// is sent to the group as a single datagram when the transmission starts. A
+// radio that is receiving on the same channel with the same modulation
+// parameters detects the preamble immediately, i.e., its receive window no
+// longer times out, and delivers RxDone once the packet's time on air has
+// elapsed. Without LORA_MODEM_ETHER, nobody else is on the air.
+//
+// Datagram format (multi-byte fields are little-endian):
+//
+//   offset  size  field
+//        0     4  sender ID (random, used to drop our own datagrams)
+//        4     4  frequency [Hz]
+//        8     4  datarate (LoRa: spreading factor, FSK: bits per second)
+//       12     1  modem (0: FSK, 1: LoRa)
+//       13     1  LoRa bandwidth (0: 125 kHz, 1: 250 kHz, 2: 500 kHz)
+//       14     1  LoRa coding rate (1: 4/5, 2: 4/6, 3: 4/7, 4: 4/8)
+//       15     1  flags (see ETHER_FLAG_*)
+//       16     2  RSSI at the receiver [dBm]
+//       18     1  SNR at the receiver [dB]
+//       19     1  transmit power [dBm]
+//       20     2  preamble length [symbols]
+//       22     n  payload
+//
+// The transmitter fills in the RSSI and SNR of a perfect link. An external
+// channel model relaying the datagrams can rewrite both fields to inject
+// arbitrary link conditions. A channel model that relays a packet only once its
+// transmission has ended sets ETHER_FLAG_RELAYED. Such packets are too late for
+// any receiver and are meant for network server emulators only.
+
+#define RADIO_WAKEUP_TIME 1 // [ms]
+#define FSK_SYNC_WORD_LENGTH 3
+#define RSSI_NOISE_FLOOR (-120)
+
+#define ETHER_HEADER_LEN 22
+#define ETHER_DEFAULT_PORT 4321
+#define ETHER_DEFAULT_RSSI (-60)
+#define ETHER_DEFAULT_SNR 10
+
+#define ETHER_FLAG_IQ_INVERTED (1 << 0)
+#define ETHER_FLAG_CRC         (1 << 1)
+#define ETHER_FLAG_FIX_LEN     (1 << 2)
+#define ETHER_FLAG_PUBLIC      (1 << 3)
+#define ETHER_FLAG_RELAYED     (1 << 4)
+
+int16_t radio_rssi;
+int8_t radio_snr;
+
+static RadioEvents_t *events;
+
+// Below, we replace the RxDone callback given to us by LoRaMac-node with our
+// own version so that we can save the RSSI and SNR if each received packet.
+// The original callback (the one from LoRaMac-node) is kept here.
+static void (*OrigRxDone)(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr);
+
+static struct {
+    RadioState_t state;
+    RadioModems_t modem;
+    uint32_t freq;
+    bool public_network;
+    uint8_t max_payload[2];
+
+    struct {
+        int8_t power;
+        uint32_t bandwidth;
+        uint32_t datarate;
+        uint8_t coderate;
+        uint16_t preamble_len;
+        bool fix_len;
+        bool crc_on;
+        bool iq_inverted;
+        uint32_t timeout;
+    } tx;
+
+    struct {
+        uint32_t bandwidth;
+        uint32_t datarate;
+        uint8_t coderate;
+        uint16_t preamble_len;
+        uint16_t symb_timeout;
+        bool fix_len;
+        uint8_t payload_len;
+        bool crc_on;
+        bool iq_inverted;
+        bool continuous;
+    } rx;
+} radio;
+
+static TimerEvent_t tx_timer;
+static TimerEvent_t rx_timer;
+static TimerEvent_t rx_done_timer;
+
+static int ether = -1;
+static struct sockaddr_in ether_addr;
+static struct sockaddr_in ether_tx_addr;
+static uint32_t node_id;
+
+// The packet being received. It is delivered when rx_done_timer fires.
+static struct {
+    bool busy;
+    uint8_t size;
+    int16_t rssi;
+    int8_t snr;
+    uint8_t payload[255];
+} rx_packet;
+
+// The most recent packet heard on the ether by any receiver state, used for
+// channel activity detection and RSSI measurements
+static struct {
+    uint32_t freq;
+    TimerTime_t end;
+    int16_t rssi;
+} air;
+
+
+static uint32_t bandwidth2hz(uint32_t bandwidth)
+{
+    switch(bandwidth) {
+        case 0: return 125000;
+        case 1: return 250000;
+        case 2: return 500000;
+        default: return 125000;
+    }
+}
+
+
+// The same formula as in SX1276GetTimeOnAir, see the SX1276 datasheet,
+// section 4.1.1.7
+static uint32_t lora_time_on_air_numerator(uint32_t bandwidth, uint32_t datarate,
+    uint8_t coderate, uint16_t preambleLen, bool fixLen, uint8_t payloadLen,
+    bool crcOn)
+{
+    int32_t cr_denom = coderate + 4;
+    bool low_dr_optimize = false;
+    int32_t ceil_num, ceil_denom, intermediate;
+
+    if ((datarate == 5 || datarate == 6) && preambleLen < 12)
+        preambleLen = 12;
+
+    if ((bandwidth == 0 && (datarate == 11 || datarate == 12)) ||
+        (bandwidth == 1 && datarate == 12))
+        low_dr_optimize = true;
+
+    ceil_num = (payloadLen << 3) + (crcOn ? 16 : 0) - (4 * datarate);
+
+    if (datarate <= 6) {
+        ceil_denom = 4 * datarate;
+    } else {
+        ceil_num += 8;
+        ceil_denom = low_dr_optimize ? 4 * (datarate - 2) : 4 * datarate;
+    }
+
+    if (!fixLen) ceil_num += 20;
+    if (ceil_num < 0) ceil_num = 0;
+
+    intermediate = ((ceil_num + ceil_denom - 1) / ceil_denom) * cr_denom + preambleLen + 12;
+    if (datarate <= 6) intermediate += 2;
+
+    return (uint32_t)((4 * intermediate + 1) * (1 << (datarate - 2)));
+}
+
+
+static uint32_t TimeOnAir(RadioModems_t modem, uint32_t bandwidth,
+    uint32_t datarate, uint8_t coderate, uint16_t preambleLen, bool fixLen,
+    uint8_t payloadLen, bool crcOn)
+{
+    uint32_t num, denom;
+
+    switch(modem) {
+        case MODEM_FSK:
+            num = (preambleLen << 3) + (fixLen ? 0 : 8) + (FSK_SYNC_WORD_LENGTH << 3)
+                + ((payloadLen + (crcOn ? 2 : 0)) << 3);
+            denom = datarate;
+            break;
+
+        case MODEM_LORA:
+            num = lora_time_on_air_numerator(bandwidth, datarate, coderate,
+                preambleLen, fixLen, payloadLen, crcOn);
+            denom = bandwidth2hz(bandwidth);
+            break;
+
+        default:
+            return 0;
+    }
+
+    // Round up to the nearest millisecond
+    return (uint32_t)(((uint64_t)num * 1000 + denom - 1) / denom);
+}
+
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, v);
+    put_u16(p + 2, v >> 16);
+}
+
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+
+// Parse an IPv4 address with an optional port number, e.g., 239.76.82.1:4321
+static bool parse_addr(struct sockaddr_in *addr, const char *v)
+{
+    char ip[INET_ADDRSTRLEN];
+    const char *colon;
+    size_t len;
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(ETHER_DEFAULT_PORT);
+
+    colon = strchr(v, ':');
+    len = colon ? (size_t)(colon - v) : strlen(v);
+    if (len >= sizeof(ip)) return false;
+    memcpy(ip, v, len);
+    ip[len] = '\0';
+    if (colon) addr->sin_port = htons(atoi(colon + 1));
+    return inet_pton(AF_INET, ip, &addr->sin_addr) == 1;
+}
+
+
+static void ether_open(void)
+{
+    const char *v = getenv(HOST_ENV_ETHER);
+    struct ip_mreq mreq;
+    struct sockaddr_in local;
+    int one = 1;
+
+    if (v == NULL || ether >= 0) return;
+    if (!parse_addr(&ether_addr, v)) goto error;
+
+    // Transmitted datagrams go to the group, unless they are to be relayed by
+    // a channel model listening on another address
+    v = getenv(HOST_ENV_ETHER_TX);
+    if (v == NULL) {
+        ether_tx_addr = ether_addr;
+    } else {
+        if (!parse_addr(&ether_tx_addr, v)) goto error;
+    }
+
+    ether = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (ether < 0) goto error;
+
+    // Several emulated radios bind to the same port on the host
+    if (setsockopt(ether, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0) goto error;
+
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = ether_addr.sin_port;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(ether, (struct sockaddr *)&local, sizeof(local)) < 0) goto error;
+
+    // Keep the traffic on the loopback interface
+    mreq.imr_multiaddr = ether_addr.sin_addr;
+    mreq.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+    if (setsockopt(ether, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) goto error;
+    if (setsockopt(ether, IPPROTO_IP, IP_MULTICAST_IF, &mreq.imr_interface, sizeof(mreq.imr_interface)) < 0) goto error;
+    return;
+
+error:
+    halt("Could not join the radio ether");
+}
+
+
+int radio_host_fd(void)
+{
+    return ether;
+}
+
+
+static bool channel_active(uint32_t freq)
+{
+    return air.freq == freq && (int32_t)(air.end - TimerGetCurrentTime()) > 0;
+}
+
+
+static void ether_send(const uint8_t *payload, uint8_t size)
+{
+    uint8_t frame[ETHER_HEADER_LEN + 255];
+    uint8_t flags = 0;
+
+    if (ether < 0) return;
+
+    if (radio.tx.iq_inverted) flags |= ETHER_FLAG_IQ_INVERTED;
+    if (radio.tx.crc_on) flags |= ETHER_FLAG_CRC;
+    if (radio.tx.fix_len) flags |= ETHER_FLAG_FIX_LEN;
+    if (radio.public_network) flags |= ETHER_FLAG_PUBLIC;
+
+    put_u32(frame, node_id);
+    put_u32(frame + 4, radio.freq);
+    put_u32(frame + 8, radio.tx.datarate);
+    frame[12] = radio.modem;
+    frame[13] = radio.tx.bandwidth;
+    frame[14] = radio.tx.coderate;
+    frame[15] = flags;
+    put_u16(frame + 16, (uint16_t)ETHER_DEFAULT_RSSI);
+    frame[18] = (uint8_t)ETHER_DEFAULT_SNR;
+    frame[19] = (uint8_t)radio.tx.power;
+    put_u16(frame + 20, radio.tx.preamble_len);
+    memcpy(frame + ETHER_HEADER_LEN, payload, size);
+
+    if (sendto(ether, frame, ETHER_HEADER_LEN + size, 0,
+        (struct sockaddr *)&ether_tx_addr, sizeof(ether_tx_addr)) < 0)
+        log_warning("Radio: Error while sending to ether: %s", strerror(errno));
+}
+
+
+// Return true if a receiver configured with the current settings would pick
+// up the given datagram
+static bool rx_match(const uint8_t *frame)
+{
+    uint8_t flags = frame[15];
+
+    if (get_u32(frame + 4) != radio.freq) return false;
+    if (frame[12] != radio.modem) return false;
+    if (get_u32(frame + 8) != radio.rx.datarate) return false;
+    if (!(flags & ETHER_FLAG_IQ_INVERTED) != !radio.rx.iq_inverted) return false;
+
+    if (radio.modem == MODEM_LORA) {
+        if (frame[13] != radio.rx.bandwidth) return false;
+        if (!(flags & ETHER_FLAG_PUBLIC) != !radio.public_network) return false;
+    }
+    return true;
+}
+
+
+static void ether_receive(const uint8_t *frame, size_t len)
+{
+    uint8_t size, flags;
+    uint32_t toa;
+
+    if (len < ETHER_HEADER_LEN) return;
+    if (get_u32(frame) == node_id) return;
+
+    size = len - ETHER_HEADER_LEN;
+    flags = frame[15];
+    if (flags & ETHER_FLAG_RELAYED) return;
+
+    toa = TimeOnAir(frame[12], frame[13], get_u32(frame + 8), frame[14],
+        get_u16(frame + 20), flags & ETHER_FLAG_FIX_LEN, size,
+        flags & ETHER_FLAG_CRC);
+
+    air.freq = get_u32(frame + 4);
+    air.end = TimerGetCurrentTime() + toa;
+    air.rssi = (int16_t)get_u16(frame + 16);
+
+    if (radio.state != RF_RX_RUNNING || rx_packet.busy) return;
+    if (!rx_match(frame)) return;
+    if (size > radio.max_payload[radio.modem == MODEM_LORA]) return;
+
+    // Preamble detected, the receive window no longer times out
+    TimerStop(&rx_timer);
+
+    rx_packet.busy = true;
+    rx_packet.size = size;
+    rx_packet.rssi = air.rssi;
+    rx_packet.snr = (int8_t)frame[18];
+    memcpy(rx_packet.payload, frame + ETHER_HEADER_LEN, size);
+
+    TimerSetValue(&rx_done_timer, toa);
+    TimerStart(&rx_done_timer);
+}
+
+
+void radio_host_service(void)
+{
+    uint8_t frame[ETHER_HEADER_LEN + 255];
+    ssize_t rc;
+
+    if (ether < 0) return;
+
+    while ((rc = recv(ether, frame, sizeof(frame), 0)) >= 0)
+        ether_receive(frame, rc);
+
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        halt("Error while receiving from radio ether");
+}
+
+
+static void stop_rx(void)
+{
+    TimerStop(&rx_timer);
+    TimerStop(&rx_done_timer);
+    rx_packet.busy = false;
+}
+
+
+static void on_tx_timer(void *ctx)
+{
+    (void)ctx;
+    radio.state = RF_IDLE;
+    if (events != NULL && events->TxDone != NULL) events->TxDone();
+}
+
+
+static void on_rx_timer(void *ctx)
+{
+    (void)ctx;
+    if (!radio.rx.continuous) radio.state = RF_IDLE;
+    if (events != NULL && events->RxTimeout != NULL) events->RxTimeout();
+}
+
+
+static void on_rx_done_timer(void *ctx)
+{
+    (void)ctx;
+    rx_packet.busy = false;
+    if (!radio.rx.continuous) radio.state = RF_IDLE;
+    if (events != NULL && events->RxDone != NULL)
+        events->RxDone(rx_packet.payload, rx_packet.size, rx_packet.rssi, rx_packet.snr);
+}
+
+
+// This is our custom RxDone callback. We save the RSSI and SNR in global static
+// variables so that they could be accessed from the application and delegate to
+// the original callback.
+static void RxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr)
+{
+    radio_rssi = rssi;
+    radio_snr = snr;
+    if (OrigRxDone != NULL) OrigRxDone(payload, size, rssi, snr);
+}
+
+
+static void Init(RadioEvents_t *ev)
+{
+    // Save the original RxDone callback and replace it with our own version
+    OrigRxDone = ev->RxDone;
+    ev->RxDone = RxDone;
+    events = ev;
+
+    srandom(system_get_random_seed());
+    node_id = random();
+    TimerInit(&tx_timer, on_tx_timer);
+    TimerInit(&rx_timer, on_rx_timer);
+    TimerInit(&rx_done_timer, on_rx_done_timer);
+    radio.max_payload[0] = radio.max_payload[1] = 255;
+    radio.state = RF_IDLE;
+
+    ether_open();
+}
+
+
+static RadioState_t GetStatus(void)
+{
+    return radio.state;
+}
+
+
+static void SetModem(RadioModems_t modem)
+{
+    radio.modem = modem;
+}
+
+
+static void SetChannel(uint32_t freq)
+{
+    log_debug("Radio: SetChannel %.3f MHz", (float)freq / (float)1000000);
+    radio.freq = freq;
+}
+
+
+static bool IsChannelFree(uint32_t freq, uint32_t rxBandwidth, int16_t rssiThresh, uint32_t maxCarrierSenseTime)
+{
+    (void)rxBandwidth;
+    (void)maxCarrierSenseTime;
+    return !channel_active(freq) || air.rssi <= rssiThresh;
+}
+
+
+static uint32_t Random(void)
+{
+    return (uint32_t)random() ^ ((uint32_t)random() << 16);
+}
+
+
+static void SetRxConfig(RadioModems_t modem, uint32_t bandwidth, uint32_t datarate,
+    uint8_t coderate, uint32_t bandwidthAfc, uint16_t preambleLen,
+    uint16_t symbTimeout, bool fixLen, uint8_t payloadLen, bool crcOn,
+    bool freqHopOn, uint8_t hopPeriod, bool iqInverted, bool rxContinuous)
+{
+    (void)bandwidthAfc;
+    (void)freqHopOn;
+    (void)hopPeriod;
+
+    radio.modem = modem;
+    radio.rx.bandwidth = bandwidth;
+    radio.rx.datarate = datarate;
+    radio.rx.coderate = coderate;
+    radio.rx.preamble_len = preambleLen;
+    radio.rx.symb_timeout = symbTimeout;
+    radio.rx.fix_len = fixLen;
+    radio.rx.payload_len = payloadLen;
+    radio.rx.crc_on = crcOn;
+    radio.rx.iq_inverted = iqInverted;
+    radio.rx.continuous = rxContinuous;
+}
+
+
+static void SetTxConfig(RadioModems_t modem, int8_t power, uint32_t fdev,
+    uint32_t bandwidth, uint32_t datarate, uint8_t coderate,
+    uint16_t preambleLen, bool fixLen, bool crcOn, bool freqHopOn,
+    uint8_t hopPeriod, bool iqInverted, uint32_t timeout)
+{
+    (void)fdev;
+    (void)freqHopOn;
+    (void)hopPeriod;
+
+    radio.modem = modem;
+    radio.tx.power = power;
+    radio.tx.bandwidth = bandwidth;
+    radio.tx.datarate = datarate;
+    radio.tx.coderate = coderate;
+    radio.tx.preamble_len = preambleLen;
+    radio.tx.fix_len = fixLen;
+    radio.tx.crc_on = crcOn;
+    radio.tx.iq_inverted = iqInverted;
+    radio.tx.timeout = timeout;
+}
+
+
+static bool CheckRfFrequency(uint32_t frequency)
+{
+    (void)frequency;
+    return true;
+}
+
+
+static void Send(uint8_t *buffer, uint8_t size)
+{
+    uint32_t toa = TimeOnAir(radio.modem, radio.tx.bandwidth, radio.tx.datarate,
+        radio.tx.coderate, radio.tx.preamble_len, radio.tx.fix_len, size,
+        radio.tx.crc_on);
+
+    log_debug("Radio: Send %d bytes, %lu ms on air", size, (unsigned long)toa);
+
+    stop_rx();
+    radio.state = RF_TX_RUNNING;
+    ether_send(buffer, size);
+    TimerSetValue(&tx_timer, toa);
+    TimerStart(&tx_timer);
+}
+
+
+static void Sleep(void)
+{
+    TimerStop(&tx_timer);
+    stop_rx();
+    radio.state = RF_IDLE;
+}
+
+
+static void Standby(void)
+{
+    Sleep();
+}
+
+
+// Return the time it takes the receiver to give up when no preamble has been
+// detected. In single reception mode, the SX1276 uses the symbol timeout
+// configured with SetRxConfig in LoRa mode.
+static uint32_t rx_window(uint32_t timeout)
+{
+    uint32_t symbols;
+
+    if (radio.rx.continuous) return timeout;
+    if (radio.modem != MODEM_LORA) return timeout;
+
+    symbols = (uint32_t)((((uint64_t)radio.rx.symb_timeout << radio.rx.datarate) * 1000
+        + bandwidth2hz(radio.rx.bandwidth) - 1) / bandwidth2hz(radio.rx.bandwidth));
+
+    if (timeout == 0 || symbols < timeout) return symbols;
+    return timeout;
+}
+
+
+static void Rx(uint32_t timeout)
+{
+    TimerStop(&tx_timer);
+    stop_rx();
+    radio.state = RF_RX_RUNNING;
+
+    timeout = rx_window(timeout);
+    if (timeout != 0) {
+        TimerSetValue(&rx_timer, timeout);
+        TimerStart(&rx_timer);
+    }
+}
+
+
+static void StartCad(void)
+{
+    radio.state = RF_CAD;
+    if (events != NULL && events->CadDone != NULL)
+        events->CadDone(channel_active(radio.freq));
+    radio.state = RF_IDLE;
+}
+
+
+static void SetTxContinuousWave(uint32_t freq, int8_t power, uint16_t time)
+{
+    radio.freq = freq;
+    radio.tx.power = power;
+    radio.state = RF_TX_RUNNING;
+    TimerSetValue(&tx_timer, (uint32_t)time * 1000);
+    TimerStart(&tx_timer);
+}
+
+
+static int16_t Rssi(RadioModems_t modem)
+{
+    (void)modem;
+    return channel_active(radio.freq) ? air.rssi : RSSI_NOISE_FLOOR;
+}
+
+
+static void Write(uint32_t addr, uint8_t data)
+{
+    (void)addr;
+    (void)data;
+}
+
+
+static uint8_t Read(uint32_t addr)
+{
+    (void)addr;
+    return 0;
+}
+
+
+static void WriteBuffer(uint32_t addr, uint8_t *buffer, uint8_t size)
+{
+    (void)addr;
+    (void)buffer;
+    (void)size;
+}
+
+
+static void ReadBuffer(uint32_t addr, uint8_t *buffer, uint8_t size)
+{
+    (void)addr;
+    (void)buffer;
+    (void)size;
+}
+
+
+static void SetMaxPayloadLength(RadioModems_t modem, uint8_t max)
+{
+    radio.max_payload[modem == MODEM_LORA] = max;
+}
+
+
+static void SetPublicNetwork(bool enable)
+{
+    radio.public_network = enable;
+}
+
+
+static uint32_t GetWakeupTime(void)
+{
+    return RADIO_WAKEUP_TIME;
+}
+
+
+// Radio driver structure initialization
+const struct Radio_s Radio = {
+    .Init = Init,
+    .GetStatus = GetStatus,
+    .SetModem = SetModem,
+    .SetChannel = SetChannel,
+    .IsChannelFree = IsChannelFree,
+    .Random = Random,
+    .SetRxConfig = SetRxConfig,
+    .SetTxConfig = SetTxConfig,
+    .CheckRfFrequency = CheckRfFrequency,
+    .TimeOnAir = TimeOnAir,
+    .Send = Send,
+    .Sleep = Sleep,
+    .Standby = Standby,
+    .Rx = Rx,
+    .StartCad = StartCad,
+    .SetTxContinuousWave = SetTxContinuousWave,
+    .Rssi = Rssi,
+    .Write = Write,
+    .Read = Read,
+    .WriteBuffer = WriteBuffer,
+    .ReadBuffer = ReadBuffer,
+    .SetMaxPayloadLength = SetMaxPayloadLength,
+    .SetPublicNetwork = SetPublicNetwork,
+    .GetWakeupTime = GetWakeupTime,
+    .IrqProcess = NULL,
+    .RxBoosted = NULL,
+    .SetRxDutyCycle = NULL
+};
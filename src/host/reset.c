@@ -0,0 +1,27 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stm/STM32L0xx_HAL_Driver/Inc/stm32l0xx_hal.h>
+#include "host.h"
+
+// This module is kept separate from system.c because <unistd.h> declares a
+// sysconf function which clashes with the sysconf variable from nvm.h.
+
+
+// Restart the firmware by replacing the process image with a new copy of the
+// executable. The pseudo-terminal is handed over to the new image so that the
+// host application does not need to reconnect.
+void NVIC_SystemReset(void)
+{
+    char fd[16];
+    char *argv[] = { "lora-modem", NULL };
+
+    snprintf(fd, sizeof(fd), "%d", lpuart_host_fd());
+    setenv(HOST_ENV_PTY_FD, fd, 1);
+
+    fflush(NULL);
+    execv("/proc/self/exe", argv);
+    perror("execv");
+    exit(EXIT_FAILURE);
+}
@@ -0,0 +1,231 @@
+#define _GNU_SOURCE
+#include "rtc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include "host.h"
+#include "system.h"
+#include "irq.h"
+
+// The host RTC counts ticks of the system's monotonic clock since rtc_init.
+// The tick resolution (1/1024 s) and all conversions are the same as on the
+// STM32, where the RTC sub-second counter is clocked from LSE.
+//
+// With LORA_MODEM_CLOCK=virtual, the RTC counts virtual ticks instead. Virtual
+// time stands still while the firmware runs and jumps straight to the next
+// alarm (the deadline of the first timer in the timeServer list) once the
+// firmware has nothing else to do in system_idle. Scenarios that span days of
+// duty-cycle backoff thus complete in milliseconds and repeated runs with the
+// same input produce the same timeline.
+
+/* MCU Wake Up Time */
+#define MIN_ALARM_DELAY 3 /* in ticks */
+
+/* subsecond number of bits */
+#define N_PREDIV_S 10
+
+/* Synchonuous prediv  */
+#define PREDIV_S ((1 << N_PREDIV_S) - 1)
+
+/* RTC Time base in us */
+#define USEC_NUMBER 1000000
+#define MSEC_NUMBER (USEC_NUMBER / 1000)
+
+#define COMMON_FACTOR 3
+#define CONV_NUMER (MSEC_NUMBER >> COMMON_FACTOR)
+#define CONV_DENOM (1 << (N_PREDIV_S - COMMON_FACTOR))
+
+static struct timespec start;
+static bool virtual_time;
+static uint64_t virtual_ticks;
+static uint32_t context;
+static uint32_t backup[2];
+
+static bool alarm_armed;
+static uint32_t alarm;
+
+
+void rtc_init(void)
+{
+    const char *v = getenv(HOST_ENV_CLOCK);
+    virtual_time = v != NULL && !strcmp(v, "virtual");
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rtc_set_timer_context();
+}
+
+
+static uint64_t get_ticks(void)
+{
+    struct timespec now;
+    uint64_t ns;
+
+    if (virtual_time) return virtual_ticks;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ns = (uint64_t)(now.tv_sec - start.tv_sec) * 1000000000 + now.tv_nsec - start.tv_nsec;
+    return (ns << N_PREDIV_S) / 1000000000;
+}
+
+
+void rtc_set_mcu_wake_up_time(void)
+{
+}
+
+
+int16_t rtc_get_mcu_wake_up_time(void)
+{
+    return 0;
+}
+
+
+uint32_t rtc_get_min_timeout(void)
+{
+    return (MIN_ALARM_DELAY);
+}
+
+
+uint32_t rtc_ms2tick(TimerTime_t timeMilliSec)
+{
+    return (uint32_t)((((uint64_t)timeMilliSec) * CONV_DENOM) / CONV_NUMER);
+}
+
+
+TimerTime_t rtc_tick2ms(uint32_t tick)
+{
+    uint32_t seconds = tick >> N_PREDIV_S;
+    tick = tick & PREDIV_S;
+    return ((seconds * 1000) + ((tick * 1000) >> N_PREDIV_S));
+}
+
+
+// The alarm fires once the timer value reaches context + timeout. It is
+// delivered by system_idle which invokes rtc_host_service.
+void rtc_set_alarm(uint32_t timeout)
+{
+    uint32_t mask = disable_irq();
+    alarm = context + timeout;
+    alarm_armed = true;
+    reenable_irq(mask);
+}
+
+
+uint32_t rtc_get_timer_elapsed_time(void)
+{
+    return (uint32_t)get_ticks() - context;
+}
+
+
+uint32_t rtc_get_timer_value(void)
+{
+    return (uint32_t)get_ticks();
+}
+
+
+uint32_t rtc_get_time_of_day(void)
+{
+    return get_ticks() % ((uint64_t)86400 << N_PREDIV_S);
+}
+
+
+void rtc_stop_alarm(void)
+{
+    alarm_armed = false;
+}
+
+
+void rtc_delay_ms(uint32_t delay)
+{
+    if (virtual_time) {
+        virtual_ticks += rtc_ms2tick(delay);
+        return;
+    }
+
+    struct timespec ts = {
+        .tv_sec = delay / 1000,
+        .tv_nsec = (delay % 1000) * 1000000
+    };
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) continue;
+}
+
+
+uint32_t rtc_set_timer_context(void)
+{
+    context = (uint32_t)get_ticks();
+    return context;
+}
+
+
+uint32_t rtc_get_timer_context(void)
+{
+    return context;
+}
+
+
+uint32_t rtc_get_calendar_time(uint16_t *mSeconds)
+{
+    uint64_t ticks = get_ticks();
+    *mSeconds = rtc_tick2ms((uint32_t)ticks & PREDIV_S);
+    return (uint32_t)(ticks >> N_PREDIV_S);
+}
+
+
+void rtc_write_backup_registers(uint32_t Data0, uint32_t Data1)
+{
+    backup[0] = Data0;
+    backup[1] = Data1;
+}
+
+
+void rtc_read_backup_registers(uint32_t *Data0, uint32_t *Data1)
+{
+    *Data0 = backup[0];
+    *Data1 = backup[1];
+}
+
+
+TimerTime_t rtc_temperature_compensation(TimerTime_t period, float temperature)
+{
+    (void)temperature;
+    return period;
+}
+
+
+int rtc_host_alarm_timeout(void)
+{
+    int32_t delta;
+
+    if (!alarm_armed) return -1;
+
+    delta = (int32_t)(alarm - rtc_get_timer_value());
+    if (delta <= 0) return 0;
+
+    // Round up so that we never wake up before the alarm is due
+    return (int)(((uint64_t)delta * 1000 + PREDIV_S) >> N_PREDIV_S);
+}
+
+
+bool rtc_host_virtual_time(void)
+{
+    return virtual_time;
+}
+
+
+void rtc_host_skip_to_alarm(void)
+{
+    uint32_t mask = disable_irq();
+    int32_t delta = (int32_t)(alarm - rtc_get_timer_value());
+    if (virtual_time && alarm_armed && delta > 0) virtual_ticks += delta;
+    reenable_irq(mask);
+}
+
+
+void rtc_host_service(void)
+{
+    if (rtc_host_alarm_timeout() != 0) return;
+
+    alarm_armed = false;
+    system_stop_lock &= ~SYSTEM_MODULE_RTC;
+    TimerIrqHandler();
+}
@@ -0,0 +1,24 @@
+#include "sx1276-board.h"
+
+// The SX1276 driver from LoRaMac-node is not used in the host build. The
+// radio is emulated at the level of the Radio driver structure (see
+// src/host/radio.c). Only the board-level functions invoked from the
+// application remain here.
+
+SX1276_t SX1276;
+
+
+void SX1276IoInit(void)
+{
+}
+
+
+void SX1276IoDeInit(void)
+{
+}
+
+
+void SX1276IoIrqInit(DioIrqHandler **irq)
+{
+    (void)irq;
+}
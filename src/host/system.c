@@ -0,0 +1,143 @@
+#define _GNU_SOURCE
+#include "system.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <stm/STM32L0xx_HAL_Driver/Inc/stm32l0xx_hal.h>
+#include "host.h"
+#include "rtc.h"
+#include "irq.h"
+#include "halt.h"
+#include "nvm.h"
+#include "lpuart.h"
+
+
+volatile unsigned system_stop_lock;
+volatile unsigned system_sleep_lock;
+volatile uint32_t host_primask;
+
+
+static uint64_t get_unique_id(void)
+{
+    const char *v;
+    uint64_t id;
+
+    v = getenv(HOST_ENV_ID);
+    if (v != NULL) return strtoull(v, NULL, 16);
+
+    v = getenv(HOST_ENV_EEPROM);
+    if (v == NULL) v = "";
+
+    // 64-bit FNV-1a
+    id = 0xcbf29ce484222325ULL;
+    for (; *v; v++) {
+        id ^= (unsigned char)*v;
+        id *= 0x100000001b3ULL;
+    }
+    return id;
+}
+
+
+uint32_t system_get_random_seed(void)
+{
+    uint64_t id = get_unique_id();
+    return (uint32_t)(id >> 32) ^ (uint32_t)id;
+}
+
+
+void system_get_unique_id(uint8_t *id)
+{
+    uint64_t v = get_unique_id();
+    for (int i = 0; i < 8; i++) id[i] = v >> (i * 8);
+}
+
+
+// The host build has no reset flags. Report a software reset if the process
+// image was started by NVIC_SystemReset and a power-on reset otherwise. Must be
+// invoked before the LPUART emulation consumes the environment variable.
+uint8_t system_get_reset_flags(void)
+{
+    return getenv(HOST_ENV_PTY_FD) != NULL ? 0x10 : 0x08;
+}
+
+
+void system_wait_hsi(void)
+{
+}
+
+
+// Note: this function must be called with interrupts disabled
+//
+// On the host, this is where the emulated peripherals deliver their
+// interrupts. The function waits for data on the LPUART pseudo-terminal, for a
+// datagram on the radio ether, or for the RTC alarm, whichever comes first, and
+// invokes the handlers. If a
+// subsystem prevents sleep, the function only polls and returns immediately.
+//
+// In virtual time, the function never waits for the RTC alarm. If there is no
+// input on the pseudo-terminal, virtual time jumps to the alarm instead. The
+// sleep setting is ignored in that case, since virtual time would not advance
+// otherwise.
+void system_idle(void)
+{
+    struct pollfd fd[2] = {
+        { .fd = lpuart_host_fd(), .events = 0 },
+        { .fd = radio_host_fd(),  .events = POLLIN }
+    };
+    bool skip = rtc_host_virtual_time();
+    int timeout, rc;
+
+    if (system_sleep_lock || (!sysconf.sleep && !skip)) {
+        timeout = 0;
+    } else {
+        timeout = rtc_host_alarm_timeout();
+    }
+
+    // Don't wait for an alarm that is not due yet in virtual time, just check
+    // for pending input. Without an alarm, we block until there is input.
+    skip = skip && timeout > 0;
+
+    if (spsc_space(&lpuart_rx_fifo) != 0) fd[0].events |= POLLIN;
+    if (lpuart_host_tx_pending()) {
+        lpuart_host_service(false, true);
+        if (lpuart_host_tx_pending()) fd[0].events |= POLLOUT;
+    }
+
+    // Negative file descriptors, e.g., without a radio ether, are ignored
+    rc = poll(fd, 2, skip ? 0 : timeout);
+    if (rc < 0 && errno != EINTR) halt("Error in poll");
+
+    if (rc > 0) {
+        lpuart_host_service(fd[0].revents & POLLIN, fd[0].revents & POLLOUT);
+        if (fd[1].revents & POLLIN) radio_host_service();
+    }
+
+    if (rc == 0 && skip) rtc_host_skip_to_alarm();
+    rtc_host_service();
+}
+
+
+void system_init(void)
+{
+    rtc_init();
+}
+
+
+void HAL_Delay(uint32_t delay)
+{
+    rtc_delay_ms(delay);
+}
+
+
+__weak void system_before_stop(void)
+{
+}
+
+__weak void system_after_stop(void)
+{
+}
+
+__weak void system_after_wakeup(void)
+{
+}
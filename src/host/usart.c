@@ -0,0 +1,27 @@
+#include "usart.h"
+#include <stdio.h>
+#include <unistd.h>
+
+// The debugging logger writes to the standard error output in the host build
+
+void usart_init(void)
+{
+}
+
+
+static uint32_t dropped;
+
+
+size_t usart_write(const char *buffer, size_t length)
+{
+    ssize_t rv = write(STDERR_FILENO, buffer, length);
+    size_t written = rv < 0 ? 0 : (size_t)rv;
+    dropped += length - written;
+    return written;
+}
+
+
+uint32_t usart_get_dropped(void)
+{
+    return dropped;
+}
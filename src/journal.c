@@ -0,0 +1,164 @@
+#define LOG_MODULE LOG_MODULE_NVM
+
+#include "journal.h"
+#include <assert.h>
+#include <string.h>
+#include "log.h"
+
+static_assert(JOURNAL_RECORDS % 2 == 0, "JOURNAL_RECORDS must be even");
+static_assert(JOURNAL_MAX_IDS < JOURNAL_RECORDS / 2, "A snapshot of all counters must fit into half of the journal");
+
+#define HALF (JOURNAL_RECORDS / 2)
+
+// Sequence numbers wrap around. All valid records in the journal are at most
+// JOURNAL_RECORDS apart, so a signed difference orders them correctly.
+#define SEQ_AFTER(a, b) ((int16_t)((uint16_t)(a) - (uint16_t)(b)) > 0)
+
+
+static struct {
+    const part_t *part;
+
+    // A copy of the records in the part. Records are written asynchronously
+    // from here, so the memory must remain valid until the write completes.
+    journal_record_t records[JOURNAL_RECORDS];
+
+    unsigned int next;   // The slot for the next record
+    uint16_t seq;        // The sequence number for the next record
+    uint32_t present;    // Bitmap of counters with a value
+    uint32_t values[JOURNAL_MAX_IDS];
+} journal;
+
+
+// CRC-8 (polynomial 0x07) over all fields but the check byte. The initial
+// value 0xff makes sure that neither an all-zero nor an all-one (erased) record
+// yields a valid check byte.
+static uint8_t checksum(const journal_record_t *r)
+{
+    const uint8_t *p = (const uint8_t *)r;
+    uint8_t crc = 0xff;
+
+    for (size_t i = 0; i < offsetof(journal_record_t, check); i++) {
+        crc ^= p[i];
+        for (int j = 0; j < 8; j++)
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
+
+static void written(bool ok, void *arg)
+{
+    (void)arg;
+    if (!ok) log_error("Error while writing NVM journal record");
+}
+
+
+static void append(uint8_t id, uint32_t value)
+{
+    journal_record_t *r = &journal.records[journal.next];
+
+    r->value = value;
+    r->seq = journal.seq++;
+    r->id = id;
+    r->check = checksum(r);
+
+    part_write_async(journal.part, journal.next * sizeof(*r), r, sizeof(*r), written, NULL);
+    journal.next++;
+}
+
+
+void journal_init(const part_t *part)
+{
+    size_t size;
+    int last = -1;
+
+    memset(&journal, 0, sizeof(journal));
+
+    const journal_record_t *mem = part_mmap(&size, part);
+    if (mem == NULL || size < sizeof(journal.records)) {
+        log_warning("NVM journal not available");
+        return;
+    }
+    memcpy(journal.records, mem, sizeof(journal.records));
+
+    uint16_t seq[JOURNAL_MAX_IDS];
+    for (int i = 0; i < JOURNAL_RECORDS; i++) {
+        const journal_record_t *r = &journal.records[i];
+        if (r->id >= JOURNAL_MAX_IDS || r->check != checksum(r)) continue;
+
+        if (!(journal.present & (1 << r->id)) || SEQ_AFTER(r->seq, seq[r->id])) {
+            journal.present |= 1 << r->id;
+            journal.values[r->id] = r->value;
+            seq[r->id] = r->seq;
+        }
+
+        if (last < 0 || SEQ_AFTER(r->seq, journal.records[last].seq))
+            last = i;
+    }
+
+    if (last >= 0) {
+        journal.next = last + 1;
+        journal.seq = journal.records[last].seq + 1;
+    }
+
+    journal.part = part;
+    log_debug("NVM journal: Next record %d", journal.next);
+
+    // If the device was reset while the most recent value of every counter was
+    // being copied into the active half, finish the copy now. Otherwise, the
+    // next switch of halves would overwrite the only record of some counters.
+    if (last < 0 || journal.next % HALF == 0) return;
+
+    uint32_t copied = 0;
+    for (int i = last - last % HALF; i <= last; i++) {
+        const journal_record_t *r = &journal.records[i];
+        if (r->id < JOURNAL_MAX_IDS && r->check == checksum(r))
+            copied |= 1 << r->id;
+    }
+
+    for (uint8_t i = 0; i < JOURNAL_MAX_IDS; i++) {
+        if ((journal.present & ~copied) & (1 << i)) append(i, journal.values[i]);
+    }
+}
+
+
+bool journal_enabled(void)
+{
+    return journal.part != NULL;
+}
+
+
+bool journal_get(uint8_t id, uint32_t *value)
+{
+    if (journal.part == NULL || id >= JOURNAL_MAX_IDS) return false;
+    if (!(journal.present & (1 << id))) return false;
+
+    *value = journal.values[id];
+    return true;
+}
+
+
+bool journal_put(uint8_t id, uint32_t value)
+{
+    if (journal.part == NULL || id >= JOURNAL_MAX_IDS) return false;
+
+    if ((journal.present & (1 << id)) && journal.values[id] == value)
+        return true;
+
+    journal.present |= 1 << id;
+    journal.values[id] = value;
+
+    // If the active half is full, switch to the other half and start it with
+    // the most recent value of every counter, including the new one.
+    if (journal.next == HALF || journal.next == JOURNAL_RECORDS) {
+        journal.next %= JOURNAL_RECORDS;
+        log_debug("NVM journal: Compacting into records %d-%d", journal.next, journal.next + HALF - 1);
+
+        for (uint8_t i = 0; i < JOURNAL_MAX_IDS; i++)
+            if (journal.present & (1 << i)) append(i, journal.values[i]);
+        return true;
+    }
+
+    append(id, value);
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "part.h"
+
+// Append-only journal of frequently updated counters
+//
+// Values such as the LoRaWAN uplink frame counter change with every uplink.
+// Writing them into their data structure in place would wear out the same few
+// EEPROM words. Instead, each new value is appended as a small sequence-numbered
+// record to a dedicated partition, so the writes rotate over all of its words.
+//
+// The partition is split into two halves. Records are appended to the active
+// half. Once it is full, the most recent value of every counter is copied into
+// the other half, which then becomes active. The previous half is only
+// overwritten after that, so an interrupted write never loses a value. On
+// startup, journal_init scans all records and rebuilds the most recent value of
+// each counter.
+//
+// Each switch of halves writes one record per counter that has a value,
+// including the new value that triggered the switch. With k such counters, a
+// half of JOURNAL_RECORDS / 2 records thus takes JOURNAL_RECORDS / 2 - k + 1
+// new values and k - 1 records are copies. For the LoRaWAN counters kept by
+// lrw.c (k is at most 5), that is 4 copies in every 9 records in the worst
+// case, i.e., 1.5 record writes per new value. Uplink-only devices typically
+// journal only the DevNonce and FCntUp (k = 2), i.e., 1 copy in every 9
+// records. The overhead is lower with larger halves, but the journal must fit
+// into the EEPROM space left by the other parts (see the static_assert in
+// nvm.c), which allows 18 records.
+
+// The maximum number of records kept in the journal partition (must be even)
+#define JOURNAL_RECORDS 18
+
+// The maximum number of distinct counters (at most JOURNAL_RECORDS / 2 - 1)
+#define JOURNAL_MAX_IDS 8
+
+
+//! @brief A single journal record, 8 bytes
+//!
+//! The value comes first so that the header with the checksum is programmed
+//! last and an interrupted write leaves an invalid record behind.
+typedef struct journal_record {
+    uint32_t value;
+    uint16_t seq;    // Sequence number, compared with wraparound
+    uint8_t id;      // Counter identifier (less than JOURNAL_MAX_IDS)
+    uint8_t check;   // CRC-8 over all the other fields
+} journal_record_t;
+
+#define JOURNAL_PART_SIZE (JOURNAL_RECORDS * sizeof(journal_record_t))
+
+
+//! @brief Load the journal from the given part
+//!
+//! If the part is not available or has the wrong size, the journal is disabled
+//! and journal_get and journal_put return false.
+
+void journal_init(const part_t *part);
+
+//! @brief Return true if the journal has been successfully initialized
+
+bool journal_enabled(void);
+
+//! @brief Retrieve the most recent value of the counter @p id
+//! @return false if the journal holds no value for the counter
+
+bool journal_get(uint8_t id, uint32_t *value);
+
+//! @brief Append a new value of the counter @p id to the journal
+//!
+//! The record is written asynchronously with part_write_async. Nothing is
+//! written if the journal already holds the same value.
+//! @return false if the journal is disabled or @p id is out of range
+
+bool journal_put(uint8_t id, uint32_t value);
+
+#endif // _JOURNAL_H_
@@ -1,34 +1,114 @@
+#define LOG_MODULE LOG_MODULE_LPUART
+
 #include "lpuart.h"
+#include <assert.h>
+#include <string.h>
 #include <stm/STM32L0xx_HAL_Driver/Inc/stm32l0xx_ll_dma.h>
 #include <stm/STM32L0xx_HAL_Driver/Inc/stm32l0xx_ll_lpuart.h>
 #include <stm/STM32L0xx_HAL_Driver/Inc/stm32l0xx_hal.h>
 #include "halt.h"
 #include "utils.h"
-#include "cbuf.h"
+#include "spsc.h"
 #include "log.h"
 #include "irq.h"
 #include "system.h"
 #include "cmd.h"
+#include "rtc.h"
+#include "pmlog.h"
 
 #ifndef LPUART_BUFFER_SIZE
 #define LPUART_BUFFER_SIZE 512
 #endif
 
-#ifndef LPUART_DMA_BUFFER_SIZE
-#define LPUART_DMA_BUFFER_SIZE 64
+static_assert(SPSC_VALID_SIZE(LPUART_BUFFER_SIZE), "LPUART_BUFFER_SIZE must be a power of two");
+
+// The TX DMA transmits from a linear buffer into which data is moved from the
+// TX FIFO. Unlike transmitting from the FIFO's memory directly, this does not
+// split the output into two transfers whenever the FIFO wraps around.
+#ifndef LPUART_TX_DMA_BUFFER_SIZE
+#define LPUART_TX_DMA_BUFFER_SIZE 256
+#endif
+
+// The RX DMA transfers received data directly into the memory of lpuart_rx_fifo
+// in circular mode. The half-transfer and transfer-complete interrupts are only
+// needed to account for buffer wraps, so a larger buffer means fewer of them.
+#ifndef LPUART_RX_BUFFER_SIZE
+#define LPUART_RX_BUFFER_SIZE 1024
+#endif
+
+static_assert(SPSC_VALID_SIZE(LPUART_RX_BUFFER_SIZE), "LPUART_RX_BUFFER_SIZE must be a power of two");
+
+// The frequency of the LPUART1 kernel clock (HSI16, see HAL_UART_MspInit)
+#define LPUART_CLOCK 16000000
+
+// The highest baud rate at which the MCU can still wake up from Stop mode on an
+// incoming frame, resume the RX DMA, and receive the following frames without
+// loss. Above this rate, the Stop mode is disabled entirely.
+#ifndef LPUART_STOP_MAX_BAUDRATE
+#define LPUART_STOP_MAX_BAUDRATE 115200
+#endif
+
+// Hardware flow control support (LPUART_FLOW_CONTROL=1). CTS (input) is handled
+// by LPUART1 in hardware. RTS (output) is driven in software, based on the fill
+// level of the RX FIFO. That leaves room for the data still in the DMA buffer
+// and for the bytes the host sends before it notices RTS deasserted.
+#ifndef LPUART_FLOW_CONTROL
+#define LPUART_FLOW_CONTROL 0
+#endif
+
+#define LPUART_CTS_PORT GPIOB
+#define LPUART_CTS_PIN  GPIO_PIN_13
+#define LPUART_RTS_PORT GPIOB
+#define LPUART_RTS_PIN  GPIO_PIN_14
+
+// Deassert RTS once fewer than this many bytes are free in the RX FIFO. The
+// fill level is only known at DMA half-transfer, transfer-complete, and idle
+// line interrupts, i.e., up to half of the buffer can arrive between two checks.
+// The extra 128 bytes cover the data the host sends after RTS has been
+// deasserted, i.e., the content of the transmit FIFO of a typical host UART or
+// USB serial adapter (16 to 128 bytes).
+#ifndef LPUART_RTS_THRESHOLD
+#define LPUART_RTS_THRESHOLD (LPUART_RX_BUFFER_SIZE / 2 + 128)
+#endif
+
+// Assert RTS again once at most this many bytes are used in the RX FIFO. The
+// gap between the two levels keeps RTS from toggling with every chunk of input
+// the ATCI consumes. The FIFO must have at least LPUART_RTS_THRESHOLD bytes
+// free at this level, otherwise the next interrupt would deassert RTS again.
+#ifndef LPUART_RTS_RESUME_LEVEL
+#define LPUART_RTS_RESUME_LEVEL (LPUART_RX_BUFFER_SIZE / 4)
+#endif
+
+#if LPUART_FLOW_CONTROL == 1
+static_assert(LPUART_RX_BUFFER_SIZE - LPUART_RTS_RESUME_LEVEL >= LPUART_RTS_THRESHOLD,
+    "LPUART_RTS_RESUME_LEVEL would deassert RTS right away");
 #endif
 
+// Above this baud rate, the MCU is woken up on the start bit of the first frame
+// rather than once the frame has been received. That gives the MCU a full frame
+// time to resume the RX DMA before the second frame overwrites the first.
+#define LPUART_STARTBIT_WAKEUP_BAUDRATE 38400
+
 
 static UART_HandleTypeDef port;
+static unsigned int baudrate;
+
+#if LPUART_FLOW_CONTROL == 1
+static bool flow_control;
+static volatile bool rts_deasserted;
+#endif
 
 static unsigned char tx_buffer[LPUART_BUFFER_SIZE];
+static unsigned char tx_dma_buffer[LPUART_TX_DMA_BUFFER_SIZE];
 static __IO ITStatus tx_idle;
-static volatile size_t tx_len;
-volatile cbuf_t lpuart_tx_fifo;
+volatile spsc_t lpuart_tx_fifo;
 
-static unsigned char dma_buffer[LPUART_DMA_BUFFER_SIZE];
-static unsigned char rx_buffer[LPUART_BUFFER_SIZE];
-volatile cbuf_t lpuart_rx_fifo;
+static lpuart_stats_t stats;
+
+static unsigned char rx_buffer[LPUART_RX_BUFFER_SIZE];
+static size_t rx_pos, rx_pending;
+static volatile bool rx_overrun;
+volatile spsc_t lpuart_rx_fifo;
 
 
 #if DETACHABLE_LPUART == 1
@@ -38,38 +118,102 @@ static bool volatile attached;
 #endif // DETACHABLE_LPUART
 
 
-// This function is invoked from the IRQ handler context
-static void enqueue(unsigned char *data, size_t len)
+#if LPUART_FLOW_CONTROL == 1
+
+// RTS is active low. The host may send data while RTS is low.
+static void set_rts(bool deasserted)
 {
-    size_t stored = cbuf_put(&lpuart_rx_fifo, data, len);
-    if (stored != len)
-        log_warning("lpuart: Read overrun, %d bytes discarded", len - stored);
+    rts_deasserted = deasserted;
+    HAL_GPIO_WritePin(LPUART_RTS_PORT, LPUART_RTS_PIN, deasserted ? GPIO_PIN_SET : GPIO_PIN_RESET);
 }
 
+#endif // LPUART_FLOW_CONTROL
 
-// This function is invoked from the IRQ handler context
+
+// This function is invoked from the IRQ handler context. The DMA controller
+// writes received data directly into rx_buffer. Here, we only publish the data
+// to the consumer by advancing the write index of lpuart_rx_fifo towards the
+// current DMA position. The DMA interrupt handler and the LPUART interrupt
+// handler run at the same priority, so this function never preempts itself.
 static void rx_callback(void)
 {
-    static size_t old_pos;
-    size_t pos;
+    size_t pos, len, space, lost;
+
+    pos = (ARRAY_LEN(rx_buffer) - LL_DMA_GetDataLength(DMA1, LL_DMA_CHANNEL_6)) & (ARRAY_LEN(rx_buffer) - 1);
+    len = (pos - rx_pos) & (ARRAY_LEN(rx_buffer) - 1);
+    rx_pos = pos;
+
+    // The DMA controller does not stop when the FIFO is full, it overwrites
+    // the oldest unread data instead. Whatever does not fit is published later
+    // so that the write index stays aligned with the DMA position. The ATCI
+    // learns about the corrupted input from lpuart_rx_overrun.
+    space = spsc_space(&lpuart_rx_fifo);
+    if (rx_pending + len > space) {
+        lost = rx_pending + len - space;
+        if (lost > len) lost = len;
+        rx_overrun = true;
+        stats.rx_lost += lost;
+        log_warning("lpuart: Read overrun, %d bytes lost", lost);
+        pmlog_write(PMLOG_UART_OVERRUN, 0, lost > UINT16_MAX ? UINT16_MAX : lost);
+    }
+    stats.rx_bytes += len;
 
-    pos = ARRAY_LEN(dma_buffer) - LL_DMA_GetDataLength(DMA1, LL_DMA_CHANNEL_6);
-    if (pos == old_pos) return;
+    rx_pending += len;
+    rx_pending -= spsc_produce(&lpuart_rx_fifo, rx_pending);
+    if (rx_pending >= ARRAY_LEN(rx_buffer))
+        rx_pending &= ARRAY_LEN(rx_buffer) - 1;
 
-    if (pos > old_pos) {
-        enqueue(&dma_buffer[old_pos], pos - old_pos);
-    } else {
-        enqueue(&dma_buffer[old_pos], ARRAY_LEN(dma_buffer) - old_pos);
-        if (pos > 0) enqueue(&dma_buffer[0], pos);
-    }
-    old_pos = pos;
+    len = spsc_length(&lpuart_rx_fifo);
+    if (len > stats.rx_fifo_high) stats.rx_fifo_high = len;
+
+#if LPUART_FLOW_CONTROL == 1
+    if (flow_control && !rts_deasserted &&
+        spsc_space(&lpuart_rx_fifo) < LPUART_RTS_THRESHOLD)
+        set_rts(true);
+#endif
 }
 
 
-void lpuart_init(unsigned int baudrate)
+// Check that the baud rate can be generated from the LPUART1 kernel clock with
+// an error below 1%. The value of the baud rate register must be between 0x300
+// and 0xfffff and the kernel clock must be within 3 to 4096 times the baud rate
+// (RM0367).
+bool lpuart_is_baudrate_supported(unsigned int rate)
 {
-    cbuf_init(&lpuart_tx_fifo, tx_buffer, sizeof(tx_buffer));
-    cbuf_init(&lpuart_rx_fifo, rx_buffer, sizeof(rx_buffer));
+    uint32_t brr, actual;
+
+    if (rate == 0) return false;
+    if (LPUART_CLOCK < 3 * (uint64_t)rate || LPUART_CLOCK > 4096 * (uint64_t)rate)
+        return false;
+
+    brr = ((uint64_t)LPUART_CLOCK * 256 + rate / 2) / rate;
+    if (brr < 0x300 || brr > 0xfffff) return false;
+
+    actual = (uint64_t)LPUART_CLOCK * 256 / brr;
+    return (actual > rate ? actual - rate : rate - actual) * 100 < rate;
+}
+
+
+void lpuart_init(unsigned int rate, bool hw_flow_control)
+{
+    // Fall back to the default baud rate rather than leave the AT command
+    // interface inaccessible, e.g., if the rate stored in NVM is invalid
+    if (!lpuart_is_baudrate_supported(rate)) {
+        log_warning("lpuart: Unsupported baud rate %u, falling back to %u", rate, DEFAULT_UART_BAUDRATE);
+        rate = DEFAULT_UART_BAUDRATE;
+    }
+    baudrate = rate;
+
+#if LPUART_FLOW_CONTROL == 1
+    flow_control = hw_flow_control;
+#else
+    if (hw_flow_control)
+        log_warning("lpuart: Flow control not supported by this build");
+#endif
+
+    spsc_init(&lpuart_tx_fifo, tx_buffer, sizeof(tx_buffer));
+    spsc_init(&lpuart_rx_fifo, rx_buffer, sizeof(rx_buffer));
+    rx_pos = rx_pending = 0;
     tx_idle = 1;
 #if DETACHABLE_LPUART == 1
     attached = true;
@@ -84,6 +228,10 @@ void lpuart_init(unsigned int baudrate)
     port.Init.StopBits = UART_STOPBITS_1;
     port.Init.Parity = UART_PARITY_NONE;
     port.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+#if LPUART_FLOW_CONTROL == 1
+    // Only CTS is handled by the peripheral, see set_rts for RTS
+    if (flow_control) port.Init.HwFlowCtl = UART_HWCONTROL_CTS;
+#endif
 
     if (HAL_UART_Init(&port) != HAL_OK) goto error;
 
@@ -96,27 +244,33 @@ void lpuart_init(unsigned int baudrate)
     //
     LL_LPUART_DisableDMADeactOnRxErr(LPUART1);
 
-    // Disable overrun detection. If we are not fast enough at receiving data,
-    // let the new byte ovewrite the previous one without setting the overrun
-    // event. The application layer (ATCI) can deal with such errors.
-    LL_LPUART_DisableOverrunDetect(LPUART1);
+    // Keep overrun detection enabled. If the DMA controller is not fast
+    // enough at receiving data, e.g., during heavy memory bus activity, the
+    // new byte is dropped and ORE is set. The interrupt handler counts the
+    // event and tells the ATCI, which fails the affected line or payload.
+    LL_LPUART_EnableOverrunDetect(LPUART1);
 
     __HAL_UART_ENABLE(&port);
     uint32_t tickstart = HAL_GetTick();
     if (UART_WaitOnFlagUntilTimeout(&port, USART_ISR_REACK, RESET, tickstart, HAL_UART_TIMEOUT_VALUE) != HAL_OK)
         goto error;
 
-    // Wake the MCU up from Stop mode once a full frame has been received
-    UART_WakeUpTypeDef wake = { .WakeUpEvent = LL_LPUART_WAKEUP_ON_RXNE };
+    // Wake the MCU up from Stop mode once a full frame has been received, or
+    // on the start bit of the frame at high baud rates
+    UART_WakeUpTypeDef wake = {
+        .WakeUpEvent = baudrate > LPUART_STARTBIT_WAKEUP_BAUDRATE
+            ? LL_LPUART_WAKEUP_ON_STARTBIT
+            : LL_LPUART_WAKEUP_ON_RXNE
+    };
     HAL_UARTEx_StopModeWakeUpSourceConfig(&port, wake);
 
-    if (HAL_UART_Receive_DMA(&port, dma_buffer, ARRAY_LEN(dma_buffer)) != HAL_OK)
+    if (HAL_UART_Receive_DMA(&port, rx_buffer, ARRAY_LEN(rx_buffer)) != HAL_OK)
         goto error;
 
     HAL_UARTEx_EnableStopMode(&port);
 
-    // Enable the idle line detection interrupt. We use the event to transmit
-    // data from the DMA buffer to the input FIFO queue and to re-enable the
+    // Enable the idle line detection interrupt. We use the event to publish
+    // the data received by the DMA controller to the ATCI and to re-enable the
     // low-power Stop mode.
     LL_LPUART_EnableIT_IDLE(LPUART1);
 
@@ -125,10 +279,16 @@ void lpuart_init(unsigned int baudrate)
     // don't, e.g., during heavy memory bus activity (writes to EEPROM).
     LL_LPUART_DisableIT_RXNE(LPUART1);
 
-    // Disable framing, noise, and overrun interrupt generation. We don't want
-    // those errors to stop DMA transfers. We simply ignore such errors and let
-    // the ATCI recover at the application layer.
-    LL_LPUART_DisableIT_ERROR(LPUART1);
+    // Enable framing, noise, overrun, and parity error interrupts so that each
+    // event is counted. The interrupt handler clears the flags before the HAL
+    // sees them, so the errors do not stop DMA transfers.
+    LL_LPUART_EnableIT_ERROR(LPUART1);
+    LL_LPUART_EnableIT_PE(LPUART1);
+
+    // The MCU cannot wake up from Stop mode fast enough at this baud rate.
+    // Keep the stop lock to stay in the sleep mode instead.
+    if (baudrate > LPUART_STOP_MAX_BAUDRATE)
+        system_stop_lock |= SYSTEM_MODULE_LPUART_RX;
 
     reenable_irq(masked);
     return;
@@ -157,6 +317,24 @@ static void init_gpio(void)
     gpio.Pin = GPIO_PIN_3;
     gpio.Pull = GPIO_PULLUP;
     HAL_GPIO_Init(GPIOA, &gpio);
+
+#if LPUART_FLOW_CONTROL == 1
+    if (flow_control) {
+        __HAL_RCC_GPIOB_CLK_ENABLE();
+
+        // Treat a disconnected CTS line as clear to send
+        gpio.Pin = LPUART_CTS_PIN;
+        gpio.Pull = GPIO_PULLDOWN;
+        gpio.Alternate = GPIO_AF4_LPUART1;
+        HAL_GPIO_Init(LPUART_CTS_PORT, &gpio);
+
+        set_rts(rts_deasserted);
+        gpio.Pin = LPUART_RTS_PIN;
+        gpio.Mode = GPIO_MODE_OUTPUT_PP;
+        gpio.Pull = GPIO_NOPULL;
+        HAL_GPIO_Init(LPUART_RTS_PORT, &gpio);
+    }
+#endif
 }
 
 
@@ -175,6 +353,14 @@ static void deinit_gpio(void)
 
     gpio.Pin = GPIO_PIN_3;
     HAL_GPIO_Init(GPIOA, &gpio);
+
+#if LPUART_FLOW_CONTROL == 1
+    if (flow_control) {
+        __HAL_RCC_GPIOB_CLK_ENABLE();
+        gpio.Pin = LPUART_CTS_PIN | LPUART_RTS_PIN;
+        HAL_GPIO_Init(GPIOB, &gpio);
+    }
+#endif
 }
 
 
@@ -265,44 +451,49 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef *port)
 }
 
 
-static void flush_tx_fifo(void)
+// Move as much data from the TX FIFO into the DMA buffer as fits and start the
+// transfer. The data is consumed from the FIFO right away, making room for more
+// output while the transfer is in progress. Must be invoked with the TX DMA
+// idle, either from the IRQ handler or with interrupts disabled.
+static void start_tx_dma(void)
 {
     cbuf_view_t v;
+    size_t len;
+
+    len = cbuf_copy_out(tx_dma_buffer, spsc_head(&lpuart_tx_fifo, &v), sizeof(tx_dma_buffer));
+    spsc_consume(&lpuart_tx_fifo, len);
+
+    HAL_UART_Transmit_DMA(&port, tx_dma_buffer, len);
+    stats.tx_dma_starts++;
+    stats.tx_bytes += len;
+}
+
 
-    if (lpuart_tx_fifo.length > 0) {
+static void flush_tx_fifo(void)
+{
+    if (spsc_length(&lpuart_tx_fifo) > 0) {
         // We need to reacreate the sleep lock here even when tx_idle is false
         // in case this function is invoked after reattaching the port.
         system_stop_lock |= SYSTEM_MODULE_LPUART_TX;
 
         if (tx_idle) {
             tx_idle = 0;
-
-            cbuf_head(&lpuart_tx_fifo, &v);
-            if (v.len[0]) {
-                HAL_UART_Transmit_DMA(&port, (unsigned char *)v.ptr[0], v.len[0]);
-                tx_len = v.len[0];
-            } else {
-                HAL_UART_Transmit_DMA(&port, (unsigned char *)v.ptr[1], v.len[1]);
-                tx_len = v.len[1];
-            }
+            stats.tx_bursts++;
+            start_tx_dma();
         }
     }
 }
 
 
-size_t lpuart_write(const char *buffer, size_t length)
+size_t lpuart_produce(size_t length)
 {
-    uint32_t masked = disable_irq();
-    cbuf_view_t v;
-
-    cbuf_tail(&lpuart_tx_fifo, &v);
-    reenable_irq(masked);
-
-    size_t written = cbuf_copy_in(&v, buffer, length);
-
-    masked = disable_irq();
-    cbuf_produce(&lpuart_tx_fifo, written);
+    size_t written = spsc_produce(&lpuart_tx_fifo, length);
+    size_t used = spsc_length(&lpuart_tx_fifo);
+    if (used > stats.tx_fifo_high) stats.tx_fifo_high = used;
 
+    // The FIFO itself needs no critical section, but the check of tx_idle and
+    // the start of a DMA transfer in flush_tx_fifo do.
+    uint32_t masked = disable_irq();
 #if DETACHABLE_LPUART == 1
     if (attached)
 #endif
@@ -312,45 +503,45 @@ size_t lpuart_write(const char *buffer, size_t length)
 }
 
 
-void lpuart_write_blocking(const char *buffer, size_t length)
+size_t lpuart_write(const char *buffer, size_t length)
 {
-    uint32_t masked;
-    size_t written;
-    while (length) {
-        written = lpuart_write(buffer, length);
-        buffer += written;
-        length -= written;
-
-        if (written == 0) {
-            while (lpuart_tx_fifo.max_length == lpuart_tx_fifo.length) {
-                masked = disable_irq();
-                // If the TX FIFO is at full capacity, we invoke system_idle to
-                // put the MCU to sleep until there is some space in the output
-                // FIFO which will be signalled by the ISR when the DMA transfer
-                // finishes. Since the transmission happens via DMA, system_idle
-                // used below must not enter the Stop mode. That is, however,
-                // guaranteed, since the function luart_write above creates a
-                // stop mode wake lock which will still be in place when the
-                // process gets here.
-                if (lpuart_tx_fifo.max_length == lpuart_tx_fifo.length)
-                    system_idle();
-                reenable_irq(masked);
-            }
-        }
-    }
+    cbuf_view_t v;
+
+    spsc_tail(&lpuart_tx_fifo, &v);
+    size_t written = cbuf_copy_in(&v, buffer, length);
+    return lpuart_produce(written);
 }
 
 
-void HAL_UART_TxCpltCallback(UART_HandleTypeDef *port)
+void lpuart_wait_tx_space(size_t length)
 {
-    cbuf_view_t v;
+    uint32_t masked, start;
+
+    if (spsc_space(&lpuart_tx_fifo) >= length) return;
 
-    if (tx_len) {
-        cbuf_consume(&lpuart_tx_fifo, tx_len);
-        tx_len = 0;
+    start = rtc_get_timer_value();
+    while (spsc_space(&lpuart_tx_fifo) < length) {
+        masked = disable_irq();
+        // If there is not enough space in the TX FIFO, we invoke system_idle
+        // to put the MCU to sleep until some data has been transmitted, which
+        // will be signalled by the ISR when the DMA transfer finishes. Since
+        // the transmission happens via DMA, system_idle used below must not
+        // enter the Stop mode. That is, however, guaranteed, since the
+        // function lpuart_produce creates a stop mode wake lock which will
+        // still be in place while there is data in the TX FIFO.
+        if (spsc_space(&lpuart_tx_fifo) < length)
+            system_idle();
+        reenable_irq(masked);
     }
+    stats.tx_blocked += rtc_tick2ms(rtc_get_timer_value() - start);
+}
+
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *handle)
+{
+    (void)handle;
 
-    if (!lpuart_tx_fifo.length) {
+    if (!spsc_length(&lpuart_tx_fifo)) {
         system_stop_lock &= ~SYSTEM_MODULE_LPUART_TX;
         tx_idle = 1;
         return;
@@ -363,14 +554,7 @@ void HAL_UART_TxCpltCallback(UART_HandleTypeDef *port)
     }
 #endif
 
-    cbuf_head(&lpuart_tx_fifo, &v);
-    if (v.len[0]) {
-        HAL_UART_Transmit_DMA(port, (unsigned char *)v.ptr[0], v.len[0]);
-        tx_len = v.len[0];
-    } else {
-        HAL_UART_Transmit_DMA(port, (unsigned char *)v.ptr[1], v.len[1]);
-        tx_len = v.len[1];
-    }
+    start_tx_dma();
 }
 
 
@@ -383,6 +567,7 @@ void RNG_LPUART1_IRQHandler(void)
     // sleep mode between received bytes.
     if (LL_LPUART_IsActiveFlag_WKUP(port.Instance)) {
         LL_LPUART_ClearFlag_WKUP(port.Instance);
+        stats.wakeups++;
         system_stop_lock |= SYSTEM_MODULE_LPUART_RX;
     }
 
@@ -393,24 +578,34 @@ void RNG_LPUART1_IRQHandler(void)
     if (LL_LPUART_IsEnabledIT_IDLE(port.Instance) && LL_LPUART_IsActiveFlag_IDLE(port.Instance)) {
         LL_LPUART_ClearFlag_IDLE(port.Instance);
         rx_callback();
-        system_stop_lock &= ~SYSTEM_MODULE_LPUART_RX;
+        if (baudrate <= LPUART_STOP_MAX_BAUDRATE)
+            system_stop_lock &= ~SYSTEM_MODULE_LPUART_RX;
     }
 
     // Delegate to the HAL. But before we do that, check and clear the error
-    // flags, otherwise the HAL would abort the DMA transfer. These errors are
-    // actually disabled in the init function, but better be safe than sorry.
+    // flags, otherwise the HAL would abort the DMA transfer.
 
-    if (LL_LPUART_IsActiveFlag_PE(port.Instance))
+    if (LL_LPUART_IsActiveFlag_PE(port.Instance)) {
         LL_LPUART_ClearFlag_PE(port.Instance);
+        stats.parity_errors++;
+    }
 
-    if (LL_LPUART_IsActiveFlag_FE(port.Instance))
+    if (LL_LPUART_IsActiveFlag_FE(port.Instance)) {
         LL_LPUART_ClearFlag_FE(port.Instance);
+        stats.framing_errors++;
+    }
 
-    if (LL_LPUART_IsActiveFlag_ORE(port.Instance))
+    if (LL_LPUART_IsActiveFlag_ORE(port.Instance)) {
         LL_LPUART_ClearFlag_ORE(port.Instance);
+        stats.overrun_errors++;
+        // The byte is missing from the RX FIFO, see lpuart_rx_overrun
+        rx_overrun = true;
+    }
 
-    if (LL_LPUART_IsActiveFlag_NE(port.Instance))
+    if (LL_LPUART_IsActiveFlag_NE(port.Instance)) {
         LL_LPUART_ClearFlag_NE(port.Instance);
+        stats.noise_errors++;
+    }
 
     HAL_UART_IRQHandler(&port);
 }
@@ -510,20 +705,64 @@ void lpuart_after_stop(void)
 }
 
 
-size_t lpuart_read(char *buffer, size_t length)
+unsigned int lpuart_get_baudrate(void)
+{
+    return baudrate;
+}
+
+
+void lpuart_get_stats(lpuart_stats_t *dst)
 {
     uint32_t masked = disable_irq();
-    cbuf_view_t v;
+    *dst = stats;
+    reenable_irq(masked);
+}
 
-    cbuf_head(&lpuart_rx_fifo, &v);
+
+void lpuart_reset_stats(void)
+{
+    uint32_t masked = disable_irq();
+    memset(&stats, 0, sizeof(stats));
     reenable_irq(masked);
+}
 
-    size_t rv = cbuf_copy_out(buffer, &v, length);
 
-    masked = disable_irq();
-    cbuf_consume(&lpuart_rx_fifo, rv);
+bool lpuart_rx_overrun(void)
+{
+    bool rv;
+
+    if (!rx_overrun) return false;
+
+    uint32_t masked = disable_irq();
+    rv = rx_overrun;
+    rx_overrun = false;
     reenable_irq(masked);
+    return rv;
+}
 
+
+void lpuart_consume(size_t length)
+{
+    spsc_consume(&lpuart_rx_fifo, length);
+
+#if LPUART_FLOW_CONTROL == 1
+    // rx_callback may deassert RTS from the DMA or LPUART interrupt handler
+    // concurrently, check and reassert atomically
+    uint32_t masked = disable_irq();
+    if (rts_deasserted && spsc_length(&lpuart_rx_fifo) <= LPUART_RTS_RESUME_LEVEL)
+        set_rts(false);
+    reenable_irq(masked);
+#endif
+}
+
+
+size_t lpuart_read(char *buffer, size_t length)
+{
+    cbuf_view_t v;
+
+    spsc_head(&lpuart_rx_fifo, &v);
+    size_t rv = cbuf_copy_out(buffer, &v, length);
+    lpuart_consume(rv);
     return rv;
 }
 
@@ -2,13 +2,45 @@
 #define __LPUART_H__
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
-#include "cbuf.h"
+#include "spsc.h"
 #include "gpio.h"
 
 
-extern volatile cbuf_t lpuart_tx_fifo;
-extern volatile cbuf_t lpuart_rx_fifo;
+/*! @brief The LPUART FIFOs
+ *
+ * The main loop is the only producer of lpuart_tx_fifo and the only consumer of
+ * lpuart_rx_fifo. The LPUART and DMA interrupt handlers are on the other side.
+ * Neither FIFO requires disabling interrupts for access from the main loop.
+ */
+extern volatile spsc_t lpuart_tx_fifo;
+extern volatile spsc_t lpuart_rx_fifo;
+
+
+/*! @brief LPUART1 statistics
+ *
+ * The counters are always maintained, regardless of the logging configuration.
+ * Each line error and overrun raises the LPUART1 error interrupt and is
+ * counted there. Only errors in consecutive frames that occur before the
+ * interrupt handler has cleared the flag are counted as one.
+ */
+typedef struct lpuart_stats {
+    uint32_t rx_bytes;       //! The number of bytes received
+    uint32_t tx_bytes;       //! The number of bytes transmitted
+    uint32_t rx_lost;        //! The number of received bytes lost to RX FIFO overruns
+    uint32_t framing_errors; //! The number of framing error events
+    uint32_t noise_errors;   //! The number of noise error events
+    uint32_t parity_errors;  //! The number of parity error events
+    uint32_t overrun_errors; //! The number of bytes dropped by LPUART1 because the RX DMA fell behind
+    uint32_t rx_fifo_high;   //! The highest number of bytes seen in the RX FIFO
+    uint32_t tx_fifo_high;   //! The highest number of bytes seen in the TX FIFO
+    uint32_t tx_blocked;     //! Time spent waiting for TX FIFO space in lpuart_wait_tx_space [ms]
+    uint32_t wakeups;        //! The number of wake-ups from Stop mode by LPUART1
+    uint32_t tx_bursts;      //! The number of times transmission started with TX idle
+    uint32_t tx_dma_starts;  //! The number of TX DMA transfers started
+} lpuart_stats_t;
+
 
 #if DETACHABLE_LPUART == 1
 
@@ -45,9 +77,48 @@ void lpuart_attach(void);
  * reception will use DMA. Two fixed-size FIFOs backed by circular buffers are
  * used to enque outgoing and incoming data.
  *
+ * With @p flow_control set, the transmission is paused while the host keeps CTS
+ * (PB13) high and RTS (PB14) is set high while the input FIFO is nearly full.
+ * Flow control is only available in firmware built with LPUART_FLOW_CONTROL=1.
+ *
  * @param[in] baudrate The baudrate to be configured
+ * @param[in] flow_control Enable RTS/CTS hardware flow control
+ */
+void lpuart_init(unsigned int baudrate, bool flow_control);
+
+
+/*! @brief Return true if LPUART1 can operate at the given baud rate
+ *
+ * The baud rate must be derivable from the LPUART1 kernel clock with an error
+ * below 1%. Receiving at the rate in Stop mode is not a requirement: above
+ * LPUART_STOP_MAX_BAUDRATE, LPUART1 keeps the MCU out of Stop mode instead.
+ *
+ * @param[in] rate Baud rate
+ * @return true if the baud rate is supported
  */
-void lpuart_init(unsigned int baudrate);
+bool lpuart_is_baudrate_supported(unsigned int rate);
+
+/*! @brief Return the baud rate LPUART1 operates at
+ *
+ * The value differs from the baud rate passed to lpuart_init if the requested
+ * baud rate is not supported. LPUART1 falls back to DEFAULT_UART_BAUDRATE in
+ * that case.
+ *
+ * @return Baud rate
+ */
+unsigned int lpuart_get_baudrate(void);
+
+
+/*! @brief Return a snapshot of LPUART1 statistics
+ *
+ * @param[out] stats A pointer to the structure to be filled in
+ */
+void lpuart_get_stats(lpuart_stats_t *stats);
+
+
+/*! @brief Reset all LPUART1 statistics to zero
+ */
+void lpuart_reset_stats(void);
 
 
 /*! @brief Write up to @p bytes to LPUART1
@@ -66,19 +137,30 @@ void lpuart_init(unsigned int baudrate);
 size_t lpuart_write(const char *buffer, size_t length);
 
 
-/*! @brief Write @p bytes to LPUART1
+/*! @brief Enqueue data written directly into lpuart_tx_fifo for transmission
  *
- * Schedule @p length bytes of data from @p buffer for transmission over
- * LPUART1. This is a blocking version of lpuart_write. This function blocks
- * until all data have been written into the internal memory queue.
+ * This function can be used instead of lpuart_write by code that generates the
+ * output directly in the memory of the TX FIFO. The application obtains the
+ * free space with spsc_tail, fills in up to @p length bytes, and then invokes
+ * this function to append the bytes to the FIFO and start the transmission.
  *
- * Note: If you with to wait until all data have been transmitted over the port,
- * invoke lpuart_flush after this function.
+ * This is non-blocking function.
  *
- * @param[in] buffer A pointer to a memory buffer with data to be sent
- * @param[in] length The number of bytes from @p buffer to be sent
+ * @param[in] length The number of bytes written into the TX FIFO
+ * @return Number of bytes enqueued (less than or equal to @p length )
  */
-void lpuart_write_blocking(const char *buffer, size_t length);
+size_t lpuart_produce(size_t length);
+
+
+/*! @brief Wait until there is space for at least @p length bytes in the TX FIFO
+ *
+ * This function blocks until at least @p length bytes are free in the internal
+ * transmission queue. The value of @p length must not exceed the size of the
+ * queue.
+ *
+ * @param[in] length The number of free bytes to wait for
+ */
+void lpuart_wait_tx_space(size_t length);
 
 
 /*! @brief Read up to @p length bytes from LPUART1
@@ -97,6 +179,30 @@ void lpuart_write_blocking(const char *buffer, size_t length);
 size_t lpuart_read(char *buffer, size_t length);
 
 
+/*! @brief Return true if received data was lost since the last invocation
+ *
+ * When the RX FIFO overruns, the DMA controller keeps writing into its memory
+ * and overwrites unread data in place. The overrun is detected at the next DMA
+ * or idle line interrupt. Once this function returns true, the content of the
+ * RX FIFO cannot be trusted. The function clears the condition.
+ *
+ * @return true if the RX FIFO has overrun
+ */
+bool lpuart_rx_overrun(void);
+
+
+/*! @brief Remove @p length bytes from the beginning of the input FIFO
+ *
+ * This function can be used instead of lpuart_read by code that processes the
+ * received data in place, i.e., in the memory of lpuart_rx_fifo obtained with
+ * spsc_head. With flow control enabled, the function signals the host that it
+ * can resume the transmission once there is enough free space in the FIFO.
+ *
+ * @param[in] length The number of processed bytes
+ */
+void lpuart_consume(size_t length);
+
+
 /*! @brief Wait for all data from internal queue to be sent
  *
  * This function blocks until all data from the internal queue have been
@@ -125,4 +231,22 @@ void lpuart_before_stop(void);
  */
 void lpuart_after_stop(void);
 
+
+/*! @brief Pause the transmission of data from the output FIFO
+ *
+ * Data written with lpuart_write is still enqueued while the transmission is
+ * paused. The transmission continues once lpuart_resume_tx is invoked.
+ */
+void lpuart_pause_tx(void);
+
+
+/*! @brief Resume the transmission previously paused with lpuart_pause_tx
+ */
+void lpuart_resume_tx(void);
+
+
+/*! @brief Return true if the transmission has been paused
+ */
+bool lpuart_is_tx_paused(void);
+
 #endif /* __LPUART_H__ */
@@ -1,5 +1,8 @@
+#define LOG_MODULE LOG_MODULE_LORAMAC
+
 #include "lrw.h"
 #include <assert.h>
+#include <stddef.h>
 #include <string.h>
 #include <LoRaWAN/Utilities/timeServer.h>
 #include <LoRaWAN/Utilities/utilities.h>
@@ -21,6 +24,8 @@
 #include "irq.h"
 #include "nvm.h"
 #include "rtc.h"
+#include "pmlog.h"
+#include "journal.h"
 
 #define MAX_BAT 254
 
@@ -33,6 +38,23 @@ static uint8_t join_datarate;
 
 TimerTime_t lrw_dutycycle_deadline;
 
+// The tags of the AT commands that started the pending asynchronous
+// operations (see atci_get_tag). The events reporting the completion of an
+// operation carry the tag of the corresponding command.
+static struct {
+    int32_t uplink;
+    int32_t join;
+    int32_t link_check;
+    int32_t device_time;
+    int32_t cw;
+} tags = {
+    .uplink      = ATCI_NO_TAG,
+    .join        = ATCI_NO_TAG,
+    .link_check  = ATCI_NO_TAG,
+    .device_time = ATCI_NO_TAG,
+    .cw          = ATCI_NO_TAG
+};
+
 
 enum lora_event {
     NO_EVENT = 0,
@@ -104,6 +126,113 @@ static void process_notify(void)
 }
 
 
+// Frame counters and the DevNonce in the Crypto group change with every uplink,
+// downlink, or Join attempt. Their values are appended to the NVM journal and
+// the Crypto part is only rewritten when some other attribute changes. The
+// values from the journal take precedence over those stored in the part.
+#define CRYPTO_COUNTER(id, field) { id, offsetof(LoRaMacCryptoNvmData_t, field), \
+    sizeof(((LoRaMacCryptoNvmData_t *)0)->field) }
+
+enum journal_ids {
+    JOURNAL_DEV_NONCE = 0,
+    JOURNAL_FCNT_UP,
+    JOURNAL_NFCNT_DOWN,
+    JOURNAL_AFCNT_DOWN,
+    JOURNAL_FCNT_DOWN
+};
+
+static const struct {
+    uint8_t id;
+    uint8_t offset;
+    uint8_t size;
+} crypto_counters[] = {
+    CRYPTO_COUNTER(JOURNAL_DEV_NONCE,  DevNonce),
+    CRYPTO_COUNTER(JOURNAL_FCNT_UP,    FCntList.FCntUp),
+    CRYPTO_COUNTER(JOURNAL_NFCNT_DOWN, FCntList.NFCntDown),
+    CRYPTO_COUNTER(JOURNAL_AFCNT_DOWN, FCntList.AFCntDown),
+    CRYPTO_COUNTER(JOURNAL_FCNT_DOWN,  FCntList.FCntDown)
+};
+
+
+static uint32_t get_counter(const LoRaMacCryptoNvmData_t *c, unsigned int i)
+{
+    uint32_t v = 0;
+    memcpy(&v, (const uint8_t *)c + crypto_counters[i].offset, crypto_counters[i].size);
+    return v;
+}
+
+
+static void set_counter(LoRaMacCryptoNvmData_t *c, unsigned int i, uint32_t v)
+{
+    memcpy((uint8_t *)c + crypto_counters[i].offset, &v, crypto_counters[i].size);
+}
+
+
+// Append the counters from the Crypto group that have changed to the journal.
+// Returns true if the rest of the group matches the data in the Crypto part,
+// i.e., if the part does not need to be written.
+static bool journal_crypto_counters(const LoRaMacCryptoNvmData_t *c)
+{
+    size_t size;
+    uint32_t old;
+    LoRaMacCryptoNvmData_t tmp;
+
+    if (!journal_enabled()) return false;
+
+    const LoRaMacCryptoNvmData_t *p = part_mmap(&size, &nvm_parts.crypto);
+    if (p == NULL || size < sizeof(*p)) return false;
+
+    memcpy(&tmp, c, sizeof(tmp));
+    for (unsigned int i = 0; i < ARRAY_LEN(crypto_counters); i++) {
+        set_counter(&tmp, i, get_counter(p, i));
+
+        if (!journal_get(crypto_counters[i].id, &old))
+            old = get_counter(p, i);
+        if (old != get_counter(c, i))
+            journal_put(crypto_counters[i].id, get_counter(c, i));
+    }
+
+    return memcmp(&tmp, p, offsetof(LoRaMacCryptoNvmData_t, Crc32)) == 0;
+}
+
+
+// Apply the counter values from the journal to a Crypto group loaded from NVM
+static void restore_crypto_counters(LoRaMacCryptoNvmData_t *c)
+{
+    uint32_t v;
+
+    // An invalid group will be rejected by LoRaMac anyway
+    if (!check_block_crc(c, sizeof(*c))) return;
+
+    for (unsigned int i = 0; i < ARRAY_LEN(crypto_counters); i++) {
+        if (journal_get(crypto_counters[i].id, &v))
+            set_counter(c, i, v);
+    }
+    update_block_crc(c, sizeof(*c));
+}
+
+
+// Set while an asynchronous write of one of the LoRaMac state groups is in
+// progress. The groups are written directly from the MAC's memory, one at a
+// time.
+static bool saving_state;
+
+static void state_saved(bool ok, void *arg)
+{
+    if (!ok) log_error("Error while writing %s state to NVM", (const char *)arg);
+    saving_state = false;
+}
+
+
+static void save_part(const part_t *part, const void *data, size_t size, const char *name)
+{
+    if (part_write_async(part, 0, data, size, state_saved, (void *)name))
+        saving_state = true;
+    else
+        log_error("Error while writing %s state to NVM", name);
+}
+
+
 static void save_state(void)
 {
     uint32_t mask;
@@ -120,15 +249,20 @@ static void save_state(void)
     system_sleep_lock |= SYSTEM_MODULE_NVM;
     reenable_irq(mask);
 
+    if (saving_state) return;
     s = lrw_get_state();
 
     if (nvm_flags & LORAMAC_NVM_NOTIFY_FLAG_CRYPTO) {
         if (LoRaMacIsBusy()) return;
 
-        log_debug("Saving Crypto state to NVM");
-        if (!part_write(&nvm_parts.crypto, 0, &s->Crypto, sizeof(s->Crypto)))
-            log_error("Error while writing Crypto state to NVM");
         nvm_flags &= ~LORAMAC_NVM_NOTIFY_FLAG_CRYPTO;
+        if (journal_crypto_counters(&s->Crypto)) {
+            log_debug("Saved Crypto counters to NVM journal");
+            return;
+        }
+
+        log_debug("Saving Crypto state to NVM");
+        save_part(&nvm_parts.crypto, &s->Crypto, sizeof(s->Crypto), "Crypto");
         return;
     }
 
@@ -136,8 +270,7 @@ static void save_state(void)
         if (LoRaMacIsBusy()) return;
 
         log_debug("Saving MacGroup1 state to NVM");
-        if (!part_write(&nvm_parts.mac1, 0, &s->MacGroup1, sizeof(s->MacGroup1)))
-            log_error("Error while writing MacGroup1 state to NVM");
+        save_part(&nvm_parts.mac1, &s->MacGroup1, sizeof(s->MacGroup1), "MacGroup1");
         nvm_flags &= ~LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1;
         return;
     }
@@ -146,8 +279,7 @@ static void save_state(void)
         if (LoRaMacIsBusy()) return;
 
         log_debug("Saving MacGroup2 state to NVM");
-        if (!part_write(&nvm_parts.mac2, 0, &s->MacGroup2, sizeof(s->MacGroup2)))
-            log_error("Error while writing MacGroup2 state to NVM");
+        save_part(&nvm_parts.mac2, &s->MacGroup2, sizeof(s->MacGroup2), "MacGroup2");
         nvm_flags &= ~LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2;
         return;
     }
@@ -156,8 +288,7 @@ static void save_state(void)
         if (LoRaMacIsBusy()) return;
 
         log_debug("Saving SecureElement state to NVM");
-        if (!part_write(&nvm_parts.se, 0, &s->SecureElement, sizeof(s->SecureElement)))
-            log_error("Error while writing SecureElement state to NVM");
+        save_part(&nvm_parts.se, &s->SecureElement, sizeof(s->SecureElement), "SecureElement");
         nvm_flags &= ~LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT;
         return;
     }
@@ -166,8 +297,7 @@ static void save_state(void)
         if (LoRaMacIsBusy()) return;
 
         log_debug("Saving RegionGroup1 state to NVM");
-        if (!part_write(&nvm_parts.region1, 0, &s->RegionGroup1, sizeof(s->RegionGroup1)))
-            log_error("Error while writing RegionGroup1 state to NVM");
+        save_part(&nvm_parts.region1, &s->RegionGroup1, sizeof(s->RegionGroup1), "RegionGroup1");
         nvm_flags &= ~LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1;
         return;
     }
@@ -176,8 +306,7 @@ static void save_state(void)
         if (LoRaMacIsBusy()) return;
 
         log_debug("Saving RegionGroup2 state to NVM");
-        if (!part_write(&nvm_parts.region2, 0, &s->RegionGroup2, sizeof(s->RegionGroup2)))
-            log_error("Error while writing RegionGroup2 state to NVM");
+        save_part(&nvm_parts.region2, &s->RegionGroup2, sizeof(s->RegionGroup2), "RegionGroup2");
         nvm_flags &= ~LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2;
         return;
     }
@@ -186,8 +315,7 @@ static void save_state(void)
         if (LoRaMacIsBusy()) return;
 
         log_debug("Saving ClassB state to NVM");
-        if (!part_write(&nvm_parts.classb, 0, &s->ClassB, sizeof(s->ClassB)))
-            log_error("Error while writing ClassB state to NVM");
+        save_part(&nvm_parts.classb, &s->ClassB, sizeof(s->ClassB), "ClassB");
         nvm_flags &= ~LORAMAC_NVM_NOTIFY_FLAG_CLASS_B;
         return;
     }
@@ -203,7 +331,10 @@ static void restore_state(void)
     memset(&s, 0, sizeof(s));
 
     p = part_mmap(&size, &nvm_parts.crypto);
-    if (p && size >= sizeof(s.Crypto)) memcpy(&s.Crypto, p, sizeof(s.Crypto));
+    if (p && size >= sizeof(s.Crypto)) {
+        memcpy(&s.Crypto, p, sizeof(s.Crypto));
+        restore_crypto_counters(&s.Crypto);
+    }
 
     p = part_mmap(&size, &nvm_parts.mac1);
     if (p && size >= sizeof(s.MacGroup1)) memcpy(&s.MacGroup1, p, sizeof(s.MacGroup1));
@@ -309,16 +440,23 @@ static void state_changed(uint16_t flags)
 
 static void on_ack(bool ack_received)
 {
+    int32_t tag = atci_set_tag(tags.uplink);
     if (ack_received) {
         cmd_print("+ACK\r\n\r\n");
     } else {
         cmd_print("+NOACK\r\n\r\n");
     }
+    atci_set_tag(tag);
 }
 
 
 static void recv(uint8_t port, uint8_t *buffer, uint8_t length)
 {
+    if (atci_is_framed()) {
+        atci_print_message(port, buffer, length);
+        return;
+    }
+
     atci_printf("+RECV=%d,%d\r\n\r\n", port, length);
 
     if (sysconf.data_format) {
@@ -333,6 +471,7 @@ static void recv(uint8_t port, uint8_t *buffer, uint8_t length)
 static void mcps_confirm(McpsConfirm_t *param)
 {
     log_debug("mcps_confirm: McpsRequest: %d, Channel: %ld AckReceived: %d", param->McpsRequest, param->Channel, param->AckReceived);
+    pmlog_write(PMLOG_MCPS_CONFIRM, param->McpsRequest, param->Status | param->AckReceived << 8);
     tx_params = *param;
 
     if (param->McpsRequest == MCPS_CONFIRMED)
@@ -342,13 +481,16 @@ static void mcps_confirm(McpsConfirm_t *param)
 
 static void mcps_retransmit(void)
 {
+    int32_t tag = atci_set_tag(tags.uplink);
     cmd_event(CMD_EVENT_NETWORK, CMD_NET_RETRANSMISSION);
+    atci_set_tag(tag);
 }
 
 
 static void mcps_indication(McpsIndication_t *param)
 {
     log_debug("mcps_indication: status: %d rssi: %d", param->Status, param->Rssi);
+    pmlog_write(PMLOG_MCPS_INDICATION, param->Port, param->Status);
 
     if (param->Status != LORAMAC_EVENT_INFO_STATUS_OK) {
         return;
@@ -422,12 +564,14 @@ static void restore_chmask(void)
 
 static void linkcheck_callback(MlmeConfirm_t *param)
 {
+    int32_t tag = atci_set_tag(tags.link_check);
     if (param->Status == LORAMAC_EVENT_INFO_STATUS_OK) {
         cmd_event(CMD_EVENT_NETWORK, CMD_NET_ANSWER);
         atci_printf("+ANS=%d,%d,%d" ATCI_EOL, SRV_MAC_LINK_CHECK_ANS, param->DemodMargin, param->NbGateways);
     } else {
         cmd_event(CMD_EVENT_NETWORK, CMD_NET_NOANSWER);
     }
+    atci_set_tag(tag);
 }
 
 
@@ -450,7 +594,9 @@ static int send_join(void)
     MlmeReq_t mlme = { .Type = MLME_JOIN };
     mlme.Req.Join.NetworkActivation = ACTIVATION_TYPE_OTAA;
     mlme.Req.Join.Datarate = join_datarate;
-    return lrw_mlme_request(&mlme);
+    LoRaMacStatus_t rc = lrw_mlme_request(&mlme);
+    pmlog_write(PMLOG_JOIN, join_datarate, rc);
+    return rc;
 }
 
 
@@ -459,7 +605,9 @@ static void stop_join(unsigned int status)
     TimerStop(&join_retry_timer);
     joins_left = 0;
 
+    int32_t tag = atci_set_tag(tags.join);
     cmd_event(CMD_EVENT_JOIN, status);
+    atci_set_tag(tag);
 
     // During the Join operation, LoRaMac internally switches the device class
     // to class A. Thus, we need to restore the original class from
@@ -535,7 +683,9 @@ static void join_callback(MlmeConfirm_t *param)
 static void cert_callback(MlmeConfirm_t *param)
 {
     if (param->Status == LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT) {
+        int32_t tag = atci_set_tag(tags.cw);
         cmd_event(CMD_EVENT_CERT, lrw_event_subtype);
+        atci_set_tag(tag);
     }
 }
 
@@ -543,6 +693,7 @@ static void cert_callback(MlmeConfirm_t *param)
 static void device_time_callback(MlmeConfirm_t *param)
 {
     SysTime_t t;
+    int32_t tag = atci_set_tag(tags.device_time);
     if (param->Status == LORAMAC_EVENT_INFO_STATUS_OK) {
         cmd_event(CMD_EVENT_NETWORK, CMD_NET_ANSWER);
         atci_flush();
@@ -554,6 +705,10 @@ static void device_time_callback(MlmeConfirm_t *param)
             1 + /* , */                            \
             sizeof(ATCI_EOL) - 1;
 
+        // The tag prepended to the line, e.g., #17
+        if (tags.device_time != ATCI_NO_TAG)
+            bytes += 1 + uint2strlen(tags.device_time);
+
         // The LoRaMAC-node library internally updates its RTC clock upon
         // receiving DeviceTimeAns from the network server. When updating the
         // RTC clock, LoRaMac-node converts GPS time to UTC time, however, it
@@ -580,19 +735,21 @@ static void device_time_callback(MlmeConfirm_t *param)
         // transmitted message by a small number of bytes.
 
         bytes += uint2strlen(t.Seconds) + uint2strlen(t.SubSeconds);
-        SysTime_t delay = uart_tx_delay(sysconf.uart_baudrate, bytes);
+        SysTime_t delay = uart_tx_delay(lpuart_get_baudrate(), bytes);
         t = SysTimeAdd(t, delay);
 
         atci_printf("+ANS=%d,%lu,%u" ATCI_EOL, SRV_MAC_DEVICE_TIME_ANS, t.Seconds, t.SubSeconds);
     } else {
         cmd_event(CMD_EVENT_NETWORK, CMD_NET_NOANSWER);
     }
+    atci_set_tag(tag);
 }
 
 
 static void mlme_confirm(MlmeConfirm_t *param)
 {
     log_debug("mlme_confirm: MlmeRequest: %d Status: %d", param->MlmeRequest, param->Status);
+    pmlog_write(PMLOG_MLME_CONFIRM, param->MlmeRequest, param->Status);
     tx_params.Status = param->Status;
 
     switch(param->MlmeRequest) {
@@ -1007,7 +1164,10 @@ int lrw_join(uint8_t datarate, uint8_t tries)
         save_chmask();
 #endif
         LoRaMacStatus_t rc = send_join();
-        if (rc == LORAMAC_STATUS_OK) joins_left = tries;
+        if (rc == LORAMAC_STATUS_OK) {
+            joins_left = tries;
+            tags.join = atci_get_tag();
+        }
         return rc;
     }
 }
@@ -1267,6 +1427,17 @@ LoRaMacStatus_t lrw_mlme_request(MlmeReq_t* req)
 {
     LoRaMacStatus_t rc = LoRaMacMlmeRequest(req);
     update_duty_cycle_deadline(rc, req->ReqReturn.DutyCycleWaitTime);
+
+    // Join requests are handled in lrw_join, since Join retransmissions are
+    // not started by an AT command
+    if (rc == LORAMAC_STATUS_OK) {
+        switch(req->Type) {
+            case MLME_LINK_CHECK:  tags.link_check  = atci_get_tag(); break;
+            case MLME_DEVICE_TIME: tags.device_time = atci_get_tag(); break;
+            case MLME_TXCW:        tags.cw          = atci_get_tag(); break;
+            default: break;
+        }
+    }
     return rc;
 }
 
@@ -1286,6 +1457,10 @@ LoRaMacStatus_t lrw_mcps_request(McpsReq_t* req, int transmissions)
 
     rc = LoRaMacMcpsRequest(req);
     update_duty_cycle_deadline(rc, req->ReqReturn.DutyCycleWaitTime);
+    if (rc == LORAMAC_STATUS_OK) {
+        tags.uplink = atci_get_tag();
+        nvm_uplink();
+    }
     return rc;
 }
 
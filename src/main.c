@@ -16,6 +16,7 @@
 #include "eeprom.h"
 #include "halt.h"
 #include "nvm.h"
+#include "pmlog.h"
 #include "sx1276-board.h"
 
 
@@ -23,6 +24,7 @@ int main(void)
 {
     int busy;
     system_init();
+    pmlog_init();
 
 #ifdef DEBUG
     log_init(LOG_LEVEL_DUMP, LOG_TIMESTAMP_ABS);
@@ -32,7 +34,7 @@ int main(void)
     log_info("Open LoRaWAN modem %s [LoRaMac %s] built on %s", VERSION, LIB_VERSION, BUILD_DATE);
 
     nvm_init();
-    cmd_init(sysconf.uart_baudrate);
+    cmd_init(sysconf.uart_baudrate, sysconf.uart_flow_control);
 
     adc_init();
 
@@ -63,6 +65,7 @@ int main(void)
         cmd_process();
         lrw_process();
         sysconf_process();
+        part_process();
 
         disable_irq();
 
@@ -108,9 +111,14 @@ void system_before_stop(void)
 }
 
 
-void system_after_stop(void)
+void system_after_wakeup(void)
 {
     lpuart_after_stop();
+}
+
+
+void system_after_stop(void)
+{
     adc_after_stop();
     spi_io_init(&SX1276.Spi);
     SX1276IoInit();
@@ -1,3 +1,5 @@
+#define LOG_MODULE LOG_MODULE_NVM
+
 #include "nvm.h"
 #include <assert.h>
 #include <string.h>
@@ -11,8 +13,9 @@
 #include "halt.h"
 #include "part.h"
 #include "utils.h"
+#include "journal.h"
 
-#define NUMBER_OF_PARTS 9
+#define NUMBER_OF_PARTS 10
 
 
 /* The following partition sizes have been derived from the in-memory size of
@@ -57,7 +60,8 @@ static_assert(
     REGION1_PART_SIZE +
     REGION2_PART_SIZE +
     CLASSB_PART_SIZE  +
-    USER_NVM_PART_SIZE
+    USER_NVM_PART_SIZE +
+    JOURNAL_PART_SIZE
     <= (DATA_EEPROM_BANK2_END - DATA_EEPROM_BASE + 1 - PART_TABLE_SIZE(NUMBER_OF_PARTS)) / 2,
     "NVM data does not fit into a single EEPROM bank");
 
@@ -70,7 +74,9 @@ static_assert(
 static part_block_t nvm = {
     .size = DATA_EEPROM_BANK2_END - DATA_EEPROM_BASE + 1,
     .mmap = eeprom_mmap,
-    .write = eeprom_write
+    .write = eeprom_write,
+    .program = eeprom_program,
+    .poll = eeprom_poll
 };
 
 struct nvm_parts nvm_parts;
@@ -84,6 +90,7 @@ sysconf_t sysconf = {
     .data_format = 0,
     .sleep = 1,
     .lock_keys = 0,
+    .uart_flow_control = 0,
     .device_class = CLASS_A,
     .unconfirmed_retransmissions = 1,
     .confirmed_retransmissions = 8
@@ -92,6 +99,13 @@ sysconf_t sysconf = {
 bool sysconf_modified;
 uint16_t nvm_flags;
 
+static struct {
+    uint32_t base;        // eeprom_get_programmed at the last reset of the stats
+    uint32_t mark;        // eeprom_get_programmed at the last uplink
+    uint32_t uplink;
+    uint32_t uplink_max;
+} stats;
+
 
 /*
  * Initialize system configuration NVM (EEPROM) partition. If necessary, the
@@ -159,6 +173,16 @@ start:
         nvm_parts.user.dsc->size != USER_NVM_PART_SIZE)
         goto retry;
 
+    // The journal part was added in a later version. Its absence, e.g., in an
+    // EEPROM formatted by an older version with no room in the partition
+    // table, is not a reason to erase the NVM. LoRaMac counters are then saved
+    // in their data structures as before.
+    if ((part_find(&nvm_parts.journal, &nvm, "journal") &&
+        part_create(&nvm_parts.journal, &nvm, "journal", JOURNAL_PART_SIZE)) ||
+        nvm_parts.journal.dsc->size != JOURNAL_PART_SIZE)
+        memset(&nvm_parts.journal, 0, sizeof(nvm_parts.journal));
+    journal_init(&nvm_parts.journal);
+
     size_t size;
     const uint8_t *p = part_mmap(&size, &nvm_parts.sysconf);
     if (check_block_crc(p, sizeof(sysconf))) {
@@ -202,13 +226,22 @@ int nvm_erase(void)
 }
 
 
+static void saved(bool ok, void *arg)
+{
+    if (!ok) log_error("Error while writing %s to NVM", (const char *)arg);
+}
+
+
 void sysconf_process(void)
 {
     if (!sysconf_modified) return;
 
+    // The data structure is written asynchronously straight from memory. If it
+    // is modified again before the write completes, the write is restarted by
+    // part_process and the new checksum is written on the next invocation.
     if (update_block_crc(&sysconf, sizeof(sysconf))) {
         log_debug("Saving system configuration to NVM");
-        if (!part_write(&nvm_parts.sysconf, 0, &sysconf, sizeof(sysconf)))
+        if (!part_write_async(&nvm_parts.sysconf, 0, &sysconf, sizeof(sysconf), saved, "system configuration"))
             log_error("Error while writing system configuration to NVM");
     }
 
@@ -220,7 +253,32 @@ void nvm_update_user_data(void)
 {
     if (update_block_crc(&user_nvm, sizeof(user_nvm))) {
         log_debug("Saving user data to NVM");
-        if (!part_write(&nvm_parts.user, 0, &user_nvm, sizeof(user_nvm)))
+        if (!part_write_async(&nvm_parts.user, 0, &user_nvm, sizeof(user_nvm), saved, "user data"))
             log_error("Error while writing user data to NVM");
     }
 }
+
+
+void nvm_uplink(void)
+{
+    uint32_t now = eeprom_get_programmed();
+
+    stats.uplink = now - stats.mark;
+    if (stats.uplink > stats.uplink_max) stats.uplink_max = stats.uplink;
+    stats.mark = now;
+}
+
+
+void nvm_get_stats(nvm_stats_t *s)
+{
+    s->written = eeprom_get_programmed() - stats.base;
+    s->uplink = stats.uplink;
+    s->uplink_max = stats.uplink_max;
+}
+
+
+void nvm_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+    stats.base = stats.mark = eeprom_get_programmed();
+}
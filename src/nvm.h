@@ -12,7 +12,8 @@
 typedef struct sysconf
 {
     /* The baud rate to be used by the ATCI UART interface. The following values
-     * are supported: 1200, 2400, 4800, 9600, 19200, 38400.
+     * are supported: 4800, 9600, 19200, 38400, 57600, 115200, 230400. If the
+     * value cannot be configured, the interface uses DEFAULT_UART_BAUDRATE.
      */
     unsigned int uart_baudrate;
 
@@ -50,6 +51,11 @@ typedef struct sysconf
      */
     uint8_t lock_keys : 1;
 
+    /* Set to 1 to enable RTS/CTS hardware flow control on the ATCI UART
+     * interface. Only supported by firmware built with LPUART_FLOW_CONTROL=1.
+     */
+    uint8_t uart_flow_control : 1;
+
     /* The maximum number of retransmissions of unconfirmed uplink messages.
      * Receiving a downlink message from the network stops retransmissions.
      */
@@ -74,6 +80,7 @@ struct nvm_parts {
     part_t region2;
     part_t classb;
     part_t user;
+    part_t journal;
 };
 
 
@@ -87,6 +94,13 @@ typedef struct user_nvm_s {
 } user_nvm_t;
 
 
+typedef struct nvm_stats {
+    uint32_t written;     // Total number of bytes programmed into the NVM
+    uint32_t uplink;      // Bytes programmed between the last two uplinks
+    uint32_t uplink_max;  // The highest value of uplink seen so far
+} nvm_stats_t;
+
+
 extern struct nvm_parts nvm_parts;
 extern sysconf_t sysconf;
 extern bool sysconf_modified;
@@ -101,4 +115,12 @@ void sysconf_process(void);
 
 void nvm_update_user_data(void);
 
+//! @brief Close the per-uplink NVM write counter, invoke on each uplink
+
+void nvm_uplink(void);
+
+void nvm_get_stats(nvm_stats_t *stats);
+
+void nvm_reset_stats(void);
+
 #endif // _NVM_H_
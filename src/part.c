@@ -1,6 +1,11 @@
+#define LOG_MODULE LOG_MODULE_PART
+
 #include "part.h"
 #include <string.h>
 #include "log.h"
+#include "pmlog.h"
+#include "irq.h"
+#include "system.h"
 
 #define PART_BLOCK_SIGNATURE ((uint32_t)0x1ABE11ED)
 
@@ -10,6 +15,40 @@
 
 #define BLOCK_CLOSED(b) ((b) == NULL || (b)->table == NULL || (b)->parts == NULL)
 
+// How many times an asynchronous write is restarted because the data in memory
+// does not match the buffer upon completion before it is considered failed
+#define MAX_RESTARTS 3
+
+
+typedef struct part_job {
+    const part_t *part;
+    uint32_t address;
+    const uint8_t *buffer;
+    size_t length;
+    size_t done;
+    uint8_t restarts;
+    bool failed;
+    part_callback_t callback;
+    void *arg;
+} part_job_t;
+
+
+// Queued asynchronous writes. The queue is advanced by polling the EEPROM from
+// the main loop (part_process) rather than from the EEPROM end-of-operation
+// (EOP) interrupt. The main loop keeps running while the SYSTEM_MODULE_EEPROM
+// sleep lock is held, and polling keeps the host build, where EEPROM writes
+// complete immediately, identical.
+static struct {
+    part_job_t jobs[PART_QUEUE_SIZE];
+    unsigned int first;
+    unsigned int count;
+
+    // Set while part_process works on the job at the head of the queue. An
+    // error in the EEPROM driver may end in halt, which flushes the queue.
+    // The flush must not re-enter the partially processed job.
+    bool busy;
+} queue;
+
 
 int part_erase_block(part_block_t *block)
 {
@@ -17,6 +56,7 @@ int part_erase_block(part_block_t *block)
 
     if (block->size < FIXED_PART_TABLE_SIZE || block->write == NULL) return -2;
 
+    part_flush();
     log_debug("part: Erasing block %p (%d B)", (void *)block, block->size);
     uint32_t sig = EMPTY;
     block->write(block->start, &sig, sizeof(sig));
@@ -203,7 +243,11 @@ bool part_write(const part_t *part, uint32_t address, const void *buffer, size_t
     if (part == NULL || BLOCK_CLOSED(part->block)) return false;
 
     if (address + length > part->dsc->size) return false;
-    return part->block->write(part->dsc->start + address, buffer, length);
+    part_flush();
+    bool rv = part->block->write(part->dsc->start + address, buffer, length);
+
+    pmlog_write(PMLOG_NVM_WRITE, (part->dsc - part->block->parts) | (rv ? 0 : 0x80), length);
+    return rv;
 }
 
 
@@ -213,6 +257,7 @@ bool part_erase(const part_t *part)
     uint32_t v = EMPTY;
 
     if (part == NULL || BLOCK_CLOSED(part->block)) return false;
+    part_flush();
     log_debug("part: Erasing part %s", part->dsc->label);
 
     for (unsigned int i = 0; i < part->dsc->size; i += sizeof(v)) {
@@ -231,3 +276,131 @@ const void *part_mmap(size_t *size, const part_t *part)
     *size = part->dsc->size;
     return part->block->mmap(part->dsc->start, part->dsc->size);
 }
+
+
+bool part_write_async(const part_t *part, uint32_t address, const void *buffer,
+    size_t length, part_callback_t callback, void *arg)
+{
+    if (part == NULL || BLOCK_CLOSED(part->block)) return false;
+    if (part->block->program == NULL || part->block->poll == NULL) return false;
+
+    if (address + length > part->dsc->size) return false;
+
+    // Only queue the range of words that differ from the data already stored
+    // in the part. The memory-mapped part is the image last written, so no
+    // shadow copy needs to be kept in RAM. If nothing has changed, an empty job
+    // is queued so that the callback is still invoked from part_process.
+    const uint8_t *mem = part->block->mmap(part->dsc->start + address, length);
+    if (mem != NULL) {
+        const uint8_t *data = buffer;
+        size_t first = 0, end = length;
+
+        while (first < end && mem[first] == data[first]) first++;
+        while (end > first && mem[end - 1] == data[end - 1]) end--;
+
+        if (first < end) {
+            uint32_t start = part->dsc->start + address;
+            size_t skew = (start + first) % PART_ALIGNMENT;
+            first = first > skew ? first - skew : 0;
+            end += (PART_ALIGNMENT - (start + end) % PART_ALIGNMENT) % PART_ALIGNMENT;
+            if (end > length) end = length;
+        }
+
+        address += first;
+        buffer = data + first;
+        length = end - first;
+    }
+
+    if (queue.count >= PART_QUEUE_SIZE) {
+        log_warning("part: Write queue full, waiting");
+        while (queue.count >= PART_QUEUE_SIZE) part_process();
+    }
+
+    part_job_t *job = &queue.jobs[(queue.first + queue.count) % PART_QUEUE_SIZE];
+    job->part = part;
+    job->address = address;
+    job->buffer = buffer;
+    job->length = length;
+    job->done = 0;
+    job->restarts = 0;
+    job->failed = false;
+    job->callback = callback;
+    job->arg = arg;
+    queue.count++;
+
+    uint32_t mask = disable_irq();
+    system_sleep_lock |= SYSTEM_MODULE_EEPROM;
+    reenable_irq(mask);
+    return true;
+}
+
+
+void part_process(void)
+{
+    uint32_t mask;
+
+    if (queue.busy) return;
+    queue.busy = true;
+
+    while (queue.count) {
+        part_job_t *job = &queue.jobs[queue.first];
+        const part_block_t *block = job->part->block;
+
+        int rc = block->poll();
+        if (rc > 0) {
+            queue.busy = false;
+            return;
+        }
+        if (rc < 0) job->failed = true;
+
+        // A job is only finished once its last word has been programmed, so
+        // that errors reported by poll are attributed to the correct job.
+        if (!job->failed && job->done >= job->length) {
+            // If the caller modified the buffer while it was being written,
+            // start over. Only the words that differ will be programmed again.
+            const void *mem = block->mmap(job->part->dsc->start + job->address, job->length);
+            if (mem == NULL) {
+                job->failed = true;
+            } else if (memcmp(mem, job->buffer, job->length) != 0) {
+                if (job->restarts++ < MAX_RESTARTS) {
+                    job->done = 0;
+                    continue;
+                }
+                job->failed = true;
+            }
+        }
+
+        if (job->failed || job->done >= job->length) {
+            queue.first = (queue.first + 1) % PART_QUEUE_SIZE;
+            queue.count--;
+
+            pmlog_write(PMLOG_NVM_WRITE, (job->part->dsc - block->parts) | (job->failed ? 0x80 : 0), job->length);
+
+            // The job is off the queue. The callback may queue or write more
+            // data, which may in turn invoke part_process.
+            queue.busy = false;
+            if (job->callback) job->callback(!job->failed, job->arg);
+            queue.busy = true;
+            continue;
+        }
+
+        size_t n = block->program(job->part->dsc->start + job->address + job->done,
+            job->buffer + job->done, job->length - job->done);
+        if (n == 0) job->failed = true;
+        job->done += n;
+    }
+
+    queue.busy = false;
+    mask = disable_irq();
+    system_sleep_lock &= ~SYSTEM_MODULE_EEPROM;
+    reenable_irq(mask);
+}
+
+
+void part_flush(void)
+{
+    // Invoked from within part_process, e.g., by halt on an EEPROM error. The
+    // job at the head of the queue cannot be completed, leave the queue as is.
+    if (queue.busy) return;
+    while (queue.count) part_process();
+}
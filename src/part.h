@@ -42,9 +42,27 @@ typedef struct part_block {
     const part_dsc_t *parts;    // A mmaped pointer to the partition array
     bool (*write)(uint32_t address, const void *buffer, size_t length);
     const void *(*mmap)(uint32_t address, size_t length);
+
+    // Optional non-blocking interface used by part_write_async. The function
+    // program starts writing the beginning of the buffer and returns the number
+    // of bytes consumed (0 on error). The function poll returns 0 when the
+    // memory is idle, a positive value while an operation is in progress, and a
+    // negative value if the most recent operation failed.
+    size_t (*program)(uint32_t address, const void *buffer, size_t length);
+    int (*poll)(void);
 } part_block_t;
 
 
+//! @brief Invoked when a write submitted with part_write_async has completed
+//! @param[in] ok true if all data has been written successfully
+//! @param[in] arg The argument given to part_write_async
+
+typedef void (*part_callback_t)(bool ok, void *arg);
+
+// The maximum number of pending asynchronous writes
+#define PART_QUEUE_SIZE 8
+
+
 int part_erase_block(part_block_t *block);
 int part_format_block(part_block_t *block, unsigned int max_parts);
 int part_open_block(part_block_t *block);
@@ -54,6 +72,34 @@ int part_find(part_t *part, const part_block_t *block, const char *label);
 int part_create(part_t *part, const part_block_t *block, const char *label, size_t size);
 
 bool part_write(const part_t *part, uint32_t address, const void *buffer, size_t length);
+
+//! @brief Write data into a part without blocking the caller
+//!
+//! The write is queued and carried out incrementally from part_process, a few
+//! words at a time. The memory pointed to by @p buffer is not copied and must
+//! remain valid until @p callback has been invoked. If the data in @p buffer
+//! changes before that, the part may receive a mix of old and new data, so the
+//! caller should write the buffer again. Pending writes are completed, in the
+//! order in which they were submitted, before any synchronous operation on a
+//! part. If the queue is full, the function waits for the oldest write.
+//! @param[in] callback Function to invoke upon completion (may be NULL)
+//! @param[in] arg Argument passed to @p callback
+//! @return false if the write could not be queued, @p callback is not invoked
+
+bool part_write_async(const part_t *part, uint32_t address, const void *buffer,
+    size_t length, part_callback_t callback, void *arg);
+
+//! @brief Make progress on pending asynchronous writes, invoke from the main loop
+//!
+//! Holds the sleep lock SYSTEM_MODULE_EEPROM while writes are pending.
+
+void part_process(void);
+
+//! @brief Complete all pending asynchronous writes, blocking the caller
+//!
+//! Does nothing if invoked from within part_process, e.g., by halt.
+
+void part_flush(void);
 const void *part_mmap(size_t *size, const part_t *part);
 bool part_erase(const part_t *part);
 
@@ -0,0 +1,92 @@
+#include "pmlog.h"
+#include <assert.h>
+#include <string.h>
+#include "rtc.h"
+#include "irq.h"
+#include "system.h"
+
+static_assert((PMLOG_SIZE & (PMLOG_SIZE - 1)) == 0, "PMLOG_SIZE must be a power of two");
+
+// The magic value also depends on the size of the log so that a firmware
+// update which changes the layout does not interpret a stale ring.
+#define PMLOG_MAGIC (0x504d4c47UL ^ sizeof(pmlog_t))
+
+
+typedef struct pmlog {
+    uint32_t magic;
+    uint32_t count;
+    char halt_msg[PMLOG_HALT_MSG_SIZE];
+    pmlog_entry_t entries[PMLOG_SIZE];
+} pmlog_t;
+
+
+// The startup code only initializes .data and .bss, so the contents of this
+// variable survives a reset as long as the MCU remains powered.
+static __attribute__((section(".noinit"))) pmlog_t pmlog;
+
+
+void pmlog_init(void)
+{
+    if (pmlog.magic != PMLOG_MAGIC)
+        pmlog_clear();
+
+    pmlog.halt_msg[PMLOG_HALT_MSG_SIZE - 1] = '\0';
+    pmlog_write(PMLOG_BOOT, system_get_reset_flags(), 0);
+}
+
+
+void pmlog_write(pmlog_event_t event, uint8_t arg, uint16_t value)
+{
+    uint32_t time = rtc_get_time_of_day();
+
+    uint32_t mask = disable_irq();
+    pmlog_entry_t *e = &pmlog.entries[pmlog.count++ & (PMLOG_SIZE - 1)];
+    e->time = time;
+    e->event = event;
+    e->arg = arg;
+    e->value = value;
+    reenable_irq(mask);
+}
+
+
+void pmlog_halt(const char *msg)
+{
+    if (msg == NULL) msg = "";
+    strncpy(pmlog.halt_msg, msg, PMLOG_HALT_MSG_SIZE - 1);
+    pmlog_write(PMLOG_HALT, 0, 0);
+}
+
+
+uint32_t pmlog_count(void)
+{
+    return pmlog.count;
+}
+
+
+bool pmlog_get(pmlog_entry_t *entry, uint32_t index)
+{
+    bool rv = false;
+
+    uint32_t mask = disable_irq();
+    if (index < pmlog.count && pmlog.count - index <= PMLOG_SIZE) {
+        *entry = pmlog.entries[index & (PMLOG_SIZE - 1)];
+        rv = true;
+    }
+    reenable_irq(mask);
+    return rv;
+}
+
+
+const char *pmlog_halt_message(void)
+{
+    return pmlog.halt_msg;
+}
+
+
+void pmlog_clear(void)
+{
+    uint32_t mask = disable_irq();
+    memset(&pmlog, 0, sizeof(pmlog));
+    pmlog.magic = PMLOG_MAGIC;
+    reenable_irq(mask);
+}
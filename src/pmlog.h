@@ -0,0 +1,81 @@
+#ifndef _PMLOG_H_
+#define _PMLOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Post-mortem event log
+//
+// A small ring of binary event records kept in RAM that is not initialized by
+// the startup code (the .noinit section). The ring survives NVIC_SystemReset,
+// halt, watchdog resets, and resets via the reset pin, but not a loss of power.
+// Unlike the debugging log, the ring is always enabled, also in release builds.
+// Recording an event costs a few dozen CPU cycles and may be done from
+// interrupt handlers. The ring can be retrieved with AT$LOGDUMP and decoded
+// with python/lora.py.
+
+// The number of events kept in the ring (must be a power of two)
+#define PMLOG_SIZE 64
+
+// The maximum length of the message passed to halt that is kept in the log
+#define PMLOG_HALT_MSG_SIZE 32
+
+
+typedef enum pmlog_event {
+    PMLOG_BOOT            = 1,  // arg: reset flags (system_get_reset_flags)
+    PMLOG_JOIN            = 2,  // arg: data rate, value: LoRaMacStatus_t of the request
+    PMLOG_MLME_CONFIRM    = 3,  // arg: MlmeRequest, value: Status
+    PMLOG_MCPS_CONFIRM    = 4,  // arg: McpsRequest, value: Status | AckReceived << 8
+    PMLOG_MCPS_INDICATION = 5,  // arg: Port, value: Status
+    PMLOG_NVM_WRITE       = 6,  // arg: partition index | 0x80 on error, value: length
+    PMLOG_UART_OVERRUN    = 7,  // value: number of received bytes lost
+    PMLOG_HALT            = 8   // see pmlog_halt_message
+} pmlog_event_t;
+
+
+//! @brief A single event record, 8 bytes
+typedef struct pmlog_entry {
+    uint32_t time;    // RTC time of day in ticks (see rtc_get_time_of_day)
+    uint8_t event;    // pmlog_event_t
+    uint8_t arg;      // Event-specific argument
+    uint16_t value;   // Event-specific value
+} pmlog_entry_t;
+
+
+//! @brief Initialize the log and record a PMLOG_BOOT event
+//!
+//! The contents of the ring is kept if it passes a sanity check, i.e., if the
+//! MCU has been reset without losing power. Must be invoked early in main.
+
+void pmlog_init(void);
+
+//! @brief Append an event to the ring, overwriting the oldest event if full
+
+void pmlog_write(pmlog_event_t event, uint8_t arg, uint16_t value);
+
+//! @brief Record a PMLOG_HALT event and keep a copy of @p msg
+//! @param[in] msg The message passed to halt (may be NULL)
+
+void pmlog_halt(const char *msg);
+
+//! @brief Return the total number of events recorded since the ring was cleared
+//!
+//! The events with indexes from max(0, count - PMLOG_SIZE) to count - 1 are
+//! available via pmlog_get.
+
+uint32_t pmlog_count(void);
+
+//! @brief Copy the event with the given index into @p entry
+//! @return false if the event is no longer (or not yet) in the ring
+
+bool pmlog_get(pmlog_entry_t *entry, uint32_t index);
+
+//! @brief Return the message from the most recent halt, or an empty string
+
+const char *pmlog_halt_message(void);
+
+//! @brief Remove all events and the halt message from the ring
+
+void pmlog_clear(void);
+
+#endif // _PMLOG_H_
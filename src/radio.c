@@ -1,3 +1,5 @@
+#define LOG_MODULE LOG_MODULE_RADIO
+
 #include <loramac-node/src/radio/sx1276/sx1276.h>
 #include "log.h"
 
@@ -213,6 +213,24 @@ uint32_t rtc_get_timer_value(void)
     return (CalendarValue);
 }
 
+uint32_t rtc_get_time_of_day(void)
+{
+    uint32_t ssr, tr, h, m, s;
+
+    // The calendar registers are read directly (shadow registers bypassed), so
+    // make sure the seconds did not roll over between the two reads
+    do {
+        ssr = RTC->SSR;
+        tr = RTC->TR;
+    } while (ssr != RTC->SSR);
+
+    h = ((tr & RTC_TR_HT) >> RTC_TR_HT_Pos) * 10 + ((tr & RTC_TR_HU) >> RTC_TR_HU_Pos);
+    m = ((tr & RTC_TR_MNT) >> RTC_TR_MNT_Pos) * 10 + ((tr & RTC_TR_MNU) >> RTC_TR_MNU_Pos);
+    s = ((tr & RTC_TR_ST) >> RTC_TR_ST_Pos) * 10 + ((tr & RTC_TR_SU) >> RTC_TR_SU_Pos);
+
+    return (((h * MINUTES_IN_1HOUR + m) * SECONDS_IN_1MINUTE + s) << N_PREDIV_S) + (PREDIV_S - ssr);
+}
+
 void rtc_stop_alarm(void)
 {
     /* Disable the Alarm A interrupt */
@@ -49,6 +49,13 @@ uint32_t rtc_get_timer_elapsed_time(void);
 
 uint32_t rtc_get_timer_value(void);
 
+//! @brief Get the time of day of the RTC calendar in ticks
+//! @note Reads the calendar registers directly and is much cheaper than
+//! rtc_get_timer_value, but ignores the date and wraps around every 24 hours
+//! @retval Ticks since midnight of the RTC calendar
+
+uint32_t rtc_get_time_of_day(void);
+
 //! @brief Set the RTC timer Reference
 //! @retval  Timer Reference Value in  Ticks
 
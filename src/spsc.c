@@ -0,0 +1,88 @@
+#include "spsc.h"
+#include <stdatomic.h>
+
+
+static inline size_t min(size_t a, size_t b)
+{
+    return a < b ? a : b;
+}
+
+
+void spsc_init(volatile spsc_t *s, void *buffer, size_t size)
+{
+    s->buffer = buffer;
+    s->mask = size - 1;
+    s->read = 0;
+    s->write = 0;
+}
+
+
+cbuf_view_t *spsc_tail(const volatile spsc_t *s, cbuf_view_t *v)
+{
+    // Read each volatile field only once
+    char *buffer = s->buffer;
+    size_t size = s->mask + 1, write = s->write;
+    size_t w = write & (size - 1);
+    size_t l = size - (write - s->read);
+
+    v->ptr[0] = buffer + w;
+    v->len[0] = min(size - w, l);
+    v->ptr[1] = buffer;
+    v->len[1] = l - v->len[0];
+    return v;
+}
+
+
+size_t spsc_produce(volatile spsc_t *s, size_t len)
+{
+    size_t write = s->write;
+    len = min(len, s->mask + 1 - (write - s->read));
+
+    // Make sure the data is in memory before the consumer can see the index
+    atomic_signal_fence(memory_order_release);
+    s->write = write + len;
+    return len;
+}
+
+
+size_t spsc_put(volatile spsc_t *s, const void *data, size_t len)
+{
+    cbuf_view_t t;
+    return spsc_produce(s, cbuf_copy_in(spsc_tail(s, &t), data, len));
+}
+
+
+cbuf_view_t *spsc_head(const volatile spsc_t *s, cbuf_view_t *v)
+{
+    char *buffer = s->buffer;
+    size_t size = s->mask + 1, read = s->read;
+    size_t r = read & (size - 1);
+    size_t l = s->write - read;
+
+    // Do not read the data before the index that published it
+    atomic_signal_fence(memory_order_acquire);
+    v->ptr[0] = buffer + r;
+    v->len[0] = min(size - r, l);
+    v->ptr[1] = buffer;
+    v->len[1] = l - v->len[0];
+    return v;
+}
+
+
+size_t spsc_consume(volatile spsc_t *s, size_t len)
+{
+    size_t read = s->read;
+    len = min(len, s->write - read);
+
+    // Finish reading the data before the producer can reuse the space
+    atomic_signal_fence(memory_order_release);
+    s->read = read + len;
+    return len;
+}
+
+
+size_t spsc_get(volatile spsc_t *s, void *buffer, size_t max_len)
+{
+    cbuf_view_t h;
+    return spsc_consume(s, cbuf_copy_out(buffer, spsc_head(s, &h), max_len));
+}
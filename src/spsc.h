@@ -0,0 +1,149 @@
+#ifndef __SPSC_H__
+#define __SPSC_H__
+
+#include <stddef.h>
+#include "cbuf.h"
+
+
+/*! @brief True if @p size is a valid memory buffer size (a power of two)
+ *
+ * A constant expression usable in static_assert for statically allocated
+ * buffers.
+ */
+#define SPSC_VALID_SIZE(size) ((size) != 0 && ((size) & ((size) - 1)) == 0)
+
+
+/*! @brief A single-producer single-consumer (SPSC) ring buffer
+ *
+ * A lock-free variant of cbuf_t intended for FIFOs shared between an interrupt
+ * handler and the main loop. The producer only ever modifies @p write and the
+ * consumer only ever modifies @p read. Both indices run freely and are mapped
+ * into the memory buffer with a mask, so the size of the buffer must be a power
+ * of two. There is no shared length field; the number of bytes stored is the
+ * difference between the two indices.
+ *
+ * As long as there is at most one producer and at most one consumer, neither
+ * side needs to disable interrupts to access the buffer. The views returned by
+ * spsc_tail and spsc_head remain valid until the same side calls spsc_produce
+ * or spsc_consume, respectively; the other side can only grow them.
+ */
+typedef struct spsc {
+    char *buffer;
+    size_t mask;   //! The size of the memory buffer minus one
+    size_t read;   //! Free-running index of the first byte (consumer only)
+    size_t write;  //! Free-running index of the first empty byte (producer only)
+} spsc_t;
+
+
+/*! @brief Initialize @p spsc with the memory given in @p buffer
+ *
+ * @param[in] spsc A pointer to the ring buffer to be initialized
+ * @param[in] buffer A pointer to the memory buffer to back the ring buffer
+ * @param[in] size The size of the memory buffer in bytes (a power of two)
+ */
+void spsc_init(volatile spsc_t *spsc, void *buffer, size_t size);
+
+
+/*! @brief Return the number of bytes stored in @p spsc
+ *
+ * Safe to call from either side. The other side may change the value at any
+ * time, but only in the direction that is safe for the caller: the data can
+ * only grow for the consumer and the free space can only grow for the producer.
+ */
+static inline size_t spsc_length(const volatile spsc_t *spsc)
+{
+    return spsc->write - spsc->read;
+}
+
+
+/*! @brief Return the number of bytes that can be appended to @p spsc
+ */
+static inline size_t spsc_space(const volatile spsc_t *spsc)
+{
+    return spsc->mask + 1 - (spsc->write - spsc->read);
+}
+
+
+/*! @brief Return a view representing free space at the end of @p spsc
+ *
+ * Producer side. The view can be filled with cbuf_copy_in.
+ *
+ * Running time: constant
+ *
+ * @param[in] spsc A pointer to the ring buffer
+ * @param[in] tail A pointer to a view variable to be filled
+ * @return The pointer passed to the function via @p tail
+ */
+cbuf_view_t *spsc_tail(const volatile spsc_t *spsc, cbuf_view_t *tail);
+
+
+/*! @brief Publish up to @p len bytes written into the view from spsc_tail
+ *
+ * Producer side. Returns the number of bytes by which the data in @p spsc was
+ * extended.
+ *
+ * Running time: constant
+ *
+ * @param[in] spsc A pointer to the ring buffer
+ * @param[in] len The desired number of bytes to extend the data with
+ * @return The number of bytes with which the data was extended
+ */
+size_t spsc_produce(volatile spsc_t *spsc, size_t len);
+
+
+/*! @brief Put up to @p len bytes of @p data into @p spsc
+ *
+ * Producer side. Equivalent to spsc_tail, cbuf_copy_in, and spsc_produce.
+ *
+ * Running time: linear with @p len
+ *
+ * @param[in] spsc A pointer to the ring buffer
+ * @param[in] data A pointer to the source memory buffer
+ * @param[in] len The number of bytes from @p data to be appended
+ * @return The number of bytes appended (less than or equal to @p len )
+ */
+size_t spsc_put(volatile spsc_t *spsc, const void *data, size_t len);
+
+
+/*! @brief Return a view to the data stored in @p spsc
+ *
+ * Consumer side. The data can be copied out with cbuf_copy_out or processed in
+ * place.
+ *
+ * Running time: constant
+ *
+ * @param[in] spsc A pointer to the ring buffer
+ * @param[out] head A pointer to the view data structure to be initialized
+ * @return The pointer from @p head .
+ */
+cbuf_view_t *spsc_head(const volatile spsc_t *spsc, cbuf_view_t *head);
+
+
+/*! @brief Release up to @p len bytes from the beginning of @p spsc
+ *
+ * Consumer side. Returns the number of bytes actually consumed.
+ *
+ * Running time: constant
+ *
+ * @param[in] spsc A pointer to the ring buffer
+ * @param[in] len The desired number of bytes to consume
+ * @return The number of bytes consumed
+ */
+size_t spsc_consume(volatile spsc_t *spsc, size_t len);
+
+
+/*! @brief Get up to @p max_len bytes into @p buffer from @p spsc
+ *
+ * Consumer side. Equivalent to spsc_head, cbuf_copy_out, and spsc_consume.
+ *
+ * Running time: linear with @p max_len
+ *
+ * @param[in] spsc A pointer to the ring buffer
+ * @param[in] buffer A pointer to the destination memory buffer
+ * @param[in] max_len The maximum number of bytes to be copied into @p buffer
+ * @return The number of bytes copied (less than or equal to @p max_len )
+ */
+size_t spsc_get(volatile spsc_t *spsc, void *buffer, size_t max_len);
+
+
+#endif /* __SPSC_H__ */
@@ -77,6 +77,10 @@ void system_idle(void)
         // oscillator here.
         while (__HAL_RCC_GET_FLAG(RCC_FLAG_HSIRDY) == RESET) continue;
 
+        // Restarting the PLL takes a while. Let latency-sensitive peripherals
+        // resume operation first.
+        system_after_wakeup();
+
         __HAL_RCC_PLL_ENABLE();
         while (__HAL_RCC_GET_FLAG(RCC_FLAG_PLLRDY) == RESET) continue;
 
@@ -322,6 +326,14 @@ static void init_clock(void)
 }
 
 
+uint8_t system_get_reset_flags(void)
+{
+    uint8_t flags = RCC->CSR >> RCC_CSR_FWRSTF_Pos;
+    RCC->CSR |= RCC_CSR_RMVF;
+    return flags;
+}
+
+
 void system_init(void)
 {
     HAL_Init();
@@ -359,3 +371,7 @@ __weak void system_before_stop(void)
 __weak void system_after_stop(void)
 {
 }
+
+__weak void system_after_wakeup(void)
+{
+}
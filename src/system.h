@@ -19,6 +19,11 @@ uint32_t system_get_random_seed(void);
 
 void system_get_unique_id(uint8_t *id);
 
+//! @brief Return the reset flags from RCC_CSR and clear them
+//! @return Bits 24-31 of RCC_CSR (FWRSTF ... LPWRRSTF) shifted to bits 0-7
+
+uint8_t system_get_reset_flags(void);
+
 //! @brief Aait on HSI
 
 void system_wait_hsi(void);
@@ -33,7 +38,8 @@ typedef enum
     SYSTEM_MODULE_RADIO     = (1 << 4),
     SYSTEM_MODULE_ATCI      = (1 << 5),
     SYSTEM_MODULE_NVM       = (1 << 6),
-    SYSTEM_MODULE_LORA      = (1 << 7)
+    SYSTEM_MODULE_LORA      = (1 << 7),
+    SYSTEM_MODULE_EEPROM    = (1 << 8)
 } system_module_t;
 
 
@@ -50,4 +56,9 @@ void system_before_stop(void);
 
 void system_after_stop(void);
 
+//! @brief This function call on wake up from stop mode while the MCU still
+//! runs from HSI16, before the PLL has been restarted (weak)
+
+void system_after_wakeup(void);
+
 #endif
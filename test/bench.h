@@ -0,0 +1,63 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+// Helpers for host microbenchmarks
+//
+// The benchmarks measure the portable code on the development machine, not on
+// the Cortex-M0+. The absolute numbers are therefore only indicative; compare
+// the numbers printed for the current and the reference implementation side by
+// side instead.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+#else
+#define BENCH_UNIT "ns"
+#endif
+
+
+//! @brief Return the current value of the time stamp counter (or nanoseconds
+//! on architectures without one)
+static inline uint64_t bench_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+
+// The number of times each benchmark is repeated. The fastest run is reported
+// to filter out interruptions by the operating system.
+#define BENCH_RUNS 15
+
+
+//! @brief Run @p fn BENCH_RUNS times and return the fastest run divided by @p n
+static inline double bench_run(void (*fn)(void), unsigned long n)
+{
+    uint64_t start, elapsed, best = UINT64_MAX;
+
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        start = bench_now();
+        fn();
+        elapsed = bench_now() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    return (double)best / n;
+}
+
+
+//! @brief Print one result line
+static inline void bench_print(const char *name, double value, const char *per)
+{
+    printf("%-44s %10.2f " BENCH_UNIT "/%s\n", name, value, per);
+}
+
+#endif // _BENCH_H_
@@ -0,0 +1,266 @@
+// Microbenchmarks of the AT command interface in src/atci.c: command lookup
+// and payload ingest
+//
+// The module is included directly so that the benchmarks can call its static
+// functions. The LPUART is replaced with stubs that discard all output.
+
+#include "atci.c"
+
+#include <stdlib.h>
+#include "bench.h"
+
+
+volatile uint32_t host_primask;
+volatile unsigned system_sleep_lock;
+
+static uint8_t rx_buffer[512], tx_buffer[1024];
+volatile spsc_t lpuart_rx_fifo, lpuart_tx_fifo;
+
+void lpuart_init(unsigned int baudrate, bool flow_control)
+{
+    (void)baudrate;
+    (void)flow_control;
+    spsc_init(&lpuart_rx_fifo, rx_buffer, sizeof(rx_buffer));
+    spsc_init(&lpuart_tx_fifo, tx_buffer, sizeof(tx_buffer));
+}
+
+size_t lpuart_write(const char *buffer, size_t length) { (void)buffer; return length; }
+size_t lpuart_produce(size_t length) { return length; }
+void lpuart_wait_tx_space(size_t length) { (void)length; }
+void lpuart_consume(size_t length) { spsc_consume(&lpuart_rx_fifo, length); }
+bool lpuart_rx_overrun(void) { return false; }
+void lpuart_flush(void) { }
+void lpuart_resume_tx(void) { }
+bool lpuart_is_tx_paused(void) { return false; }
+
+__attribute__((noreturn)) void halt(const char *msg)
+{
+    fprintf(stderr, "halt: %s\n", msg);
+    exit(EXIT_FAILURE);
+}
+
+
+// The command names from the table in src/cmd.c, in table order
+static const char *names[] = {
+    "+UART", "+VER", "+DEV", "+REBOOT", "+FACNEW", "+BAND", "+CLASS", "+MODE",
+    "+DEVADDR", "+DEVEUI", "+APPEUI", "+NWKSKEY", "+APPSKEY", "+APPKEY",
+    "+JOIN", "+JOINDC", "+LNCHECK", "+RFPARAM", "+RFPOWER", "+NWK", "+ADR",
+    "+DR", "+DELAY", "+ADRACK", "+RX2", "+DUTYCYCLE", "+SLEEP", "+PORT",
+    "+REP", "+DFORMAT", "+TO", "+UTX", "+CTX", "+MCAST", "+PUTX", "+PCTX",
+    "+FRMCNT", "+MSIZE", "+RFQ", "+DWELL", "+MAXEIRP", "+RSSITH", "+CST",
+    "+BACKOFF", "+CHMASK", "+RTYNUM", "+NETID", "$VER", "$DBG", "$HALT",
+    "$JOINEUI", "$NWKKEY", "$APPKEY", "$FNWKSINTKEY", "$SNWKSINTKEY",
+    "$NWKSENCKEY", "$CHMASK", "$RX2", "$DR", "$RFPOWER", "$PAUSE", "$LOGLEVEL",
+    "$LOGMOD", "$SESSION", "$CERT", "$CW", "$CM", "$NVM", "$LOCKKEYS", "$DETACH",
+    "$TIME", "$DEVTIME", "$DEVNONCE", "$MCUID", "$STOPONERR", "$UARTSTATS",
+    "$LOGDUMP", "$NVMSTATS", "+CLAC", "$HELP", "$FRAMED"
+};
+
+#define NAMES (sizeof(names) / sizeof(names[0]))
+
+static atci_command_t commands[NAMES];
+static size_t lengths[NAMES];
+static unsigned long reads;
+
+static void read_handler(void)
+{
+    reads++;
+}
+
+
+#define LOOKUPS 20000
+
+static const void *volatile sink;
+
+// Look up every command name in turn with find_command
+static void lookup_binary(void)
+{
+    for (int i = 0; i < LOOKUPS; i++) {
+        size_t j = i % NAMES;
+        sink = find_command(names[j], lengths[j]);
+    }
+}
+
+
+// The lookup used before the sorted index: strlen and strncmp over the table
+// in order until the first match
+static const atci_command_t *find_linear(const char *name, size_t name_len)
+{
+    for (size_t i = 0; i < NAMES; i++) {
+        size_t cmd_len = strlen(commands[i].command);
+        if (name_len < cmd_len) continue;
+        if (strncmp(name, commands[i].command, cmd_len) != 0) continue;
+        if (cmd_len == name_len) return commands + i;
+    }
+    return NULL;
+}
+
+static void lookup_linear(void)
+{
+    for (int i = 0; i < LOOKUPS; i++) {
+        size_t j = i % NAMES;
+        sink = find_linear(names[j], lengths[j]);
+    }
+}
+
+
+// Feed AT<name>? lines for all commands through atci_process
+static char lines[NAMES * 16];
+static size_t lines_length;
+
+#define LINE_ROUNDS 200
+
+static void process_lines(void)
+{
+    cbuf_view_t v;
+    size_t n, i;
+
+    for (int r = 0; r < LINE_ROUNDS; r++) {
+        for (i = 0; i < lines_length; i += n) {
+            spsc_tail(&lpuart_rx_fifo, &v);
+            n = lines_length - i < v.len[0] ? lines_length - i : v.len[0];
+            memcpy(v.ptr[0], lines + i, n);
+            spsc_produce(&lpuart_rx_fifo, n);
+            atci_process();
+        }
+    }
+}
+
+
+// Payload ingest as in AT+UTX: the payload is announced with
+// atci_set_read_next_data and then arrives in the RX FIFO in two segments, as
+// if the FIFO had wrapped around in the middle of it.
+#define PAYLOAD_SIZE 242
+#define PAYLOAD_ROUNDS 1000
+
+static uint8_t payload[PAYLOAD_SIZE];
+static char payload_hex[PAYLOAD_SIZE * 2];
+static unsigned long received, corrupted;
+
+static void data_received(atci_data_status_t status, atci_param_t *param)
+{
+    if (status != ATCI_DATA_OK || param->length != PAYLOAD_SIZE
+        || memcmp(param->txt, payload, PAYLOAD_SIZE) != 0)
+        corrupted++;
+    else
+        received++;
+}
+
+static void ingest(atci_encoding_t encoding, const char *data, size_t length)
+{
+    for (int r = 0; r < PAYLOAD_ROUNDS; r++) {
+        atci_set_read_next_data(PAYLOAD_SIZE, encoding, data_received);
+        process_segment(data, length / 3);
+        process_segment(data + length / 3, length - length / 3);
+    }
+}
+
+static void ingest_bin(void)
+{
+    ingest(ATCI_ENCODING_BIN, (const char *)payload, sizeof(payload));
+}
+
+static void ingest_hex(void)
+{
+    ingest(ATCI_ENCODING_HEX, payload_hex, sizeof(payload_hex));
+}
+
+
+// The per-character payload decoder used before the bulk ingest
+static void process_data_char(char character)
+{
+    int c;
+    static bool even = true;
+
+    switch(state.read_next_data.encoding) {
+        case ATCI_ENCODING_BIN:
+            state.rx_buffer[state.rx_length++] = character;
+            break;
+
+        case ATCI_ENCODING_HEX:
+            c = hex2bin(character);
+            if (c < 0) {
+                state.rx_error = true;
+                break;
+            }
+            if (even) {
+                state.rx_buffer[state.rx_length] = c << 4;
+                even = false;
+            } else {
+                state.rx_buffer[state.rx_length++] |= c;
+                even = true;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    if (state.read_next_data.length == state.rx_length || state.rx_error) {
+        even = true;
+        finish_next_data(state.rx_error ? ATCI_DATA_ENCODING_ERROR : ATCI_DATA_OK);
+        state.rx_error = false;
+    }
+}
+
+static void ingest_char(atci_encoding_t encoding, const char *data, size_t length)
+{
+    for (int r = 0; r < PAYLOAD_ROUNDS; r++) {
+        atci_set_read_next_data(PAYLOAD_SIZE, encoding, data_received);
+        for (size_t i = 0; i < length; i++)
+            process_data_char(data[i]);
+    }
+}
+
+static void ingest_bin_char(void)
+{
+    ingest_char(ATCI_ENCODING_BIN, (const char *)payload, sizeof(payload));
+}
+
+static void ingest_hex_char(void)
+{
+    ingest_char(ATCI_ENCODING_HEX, payload_hex, sizeof(payload_hex));
+}
+
+
+int main(void)
+{
+    for (size_t i = 0; i < NAMES; i++) {
+        commands[i].command = names[i];
+        commands[i].read = read_handler;
+        lengths[i] = strlen(names[i]);
+        lines_length += sprintf(lines + lines_length, "AT%s?\r", names[i]);
+    }
+
+    atci_init(DEFAULT_UART_BAUDRATE, false, commands, NAMES);
+
+    printf("%zu commands\n", NAMES);
+    bench_print("find_command (sorted index)", bench_run(lookup_binary, LOOKUPS), "lookup");
+    bench_print("linear scan (reference)", bench_run(lookup_linear, LOOKUPS), "lookup");
+
+    reads = 0;
+    double line = bench_run(process_lines, LINE_ROUNDS * NAMES);
+    if (reads != BENCH_RUNS * LINE_ROUNDS * NAMES) {
+        printf("FAIL: %lu of %lu commands executed\n", reads,
+            (unsigned long)(BENCH_RUNS * LINE_ROUNDS * NAMES));
+        return EXIT_FAILURE;
+    }
+    bench_print("atci_process AT<cmd>?", line, "line");
+
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) {
+        payload[i] = i * 7 + 1;
+        sprintf(payload_hex + i * 2, "%02X", payload[i]);
+    }
+
+    const unsigned long bytes = PAYLOAD_ROUNDS * PAYLOAD_SIZE;
+    bench_print("binary payload (bulk)", bench_run(ingest_bin, bytes), "byte");
+    bench_print("binary payload (per character, reference)", bench_run(ingest_bin_char, bytes), "byte");
+    bench_print("hex payload (bulk)", bench_run(ingest_hex, bytes), "byte");
+    bench_print("hex payload (per character, reference)", bench_run(ingest_hex_char, bytes), "byte");
+
+    if (corrupted != 0 || received != 4 * BENCH_RUNS * PAYLOAD_ROUNDS) {
+        printf("FAIL: %lu payloads corrupted, %lu received\n", corrupted, received);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+// Microbenchmark of the FIFOs in src/cbuf.c and src/spsc.c
+//
+// Measures the throughput of a put/get round trip through each FIFO with
+// several chunk sizes. As in the firmware before the switch to spsc_t, every
+// cbuf_t operation runs in a critical section. Note that disabling interrupts
+// is only a variable update on the host, while the modulo in cbuf_t is a
+// library call on the Cortex-M0+, so the host numbers understate the
+// difference.
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "cbuf.h"
+#include "spsc.h"
+#include "irq.h"
+
+
+volatile uint32_t host_primask;
+
+#define FIFO_SIZE 1024
+#define FIFO_BYTES (1024 * 1024)
+
+static uint8_t cbuf_memory[FIFO_SIZE], spsc_memory[FIFO_SIZE];
+static volatile cbuf_t cbuf;
+static volatile spsc_t spsc;
+
+static uint8_t in[256], out[256];
+static size_t chunk;
+static unsigned long corrupted;
+
+
+static void run_cbuf(void)
+{
+    uint32_t mask;
+    size_t n;
+
+    for (size_t done = 0; done < FIFO_BYTES; done += chunk) {
+        mask = disable_irq();
+        n = cbuf_put(&cbuf, in, chunk);
+        reenable_irq(mask);
+
+        mask = disable_irq();
+        n = cbuf_get(&cbuf, out, n);
+        reenable_irq(mask);
+
+        if (n != chunk) corrupted++;
+    }
+}
+
+
+static void run_spsc(void)
+{
+    size_t n;
+
+    for (size_t done = 0; done < FIFO_BYTES; done += chunk) {
+        n = spsc_put(&spsc, in, chunk);
+        n = spsc_get(&spsc, out, n);
+        if (n != chunk) corrupted++;
+    }
+}
+
+
+int main(void)
+{
+    // Chunk sizes that do not divide the buffer size, so that the indices
+    // wrap around at different offsets
+    static const size_t chunks[] = { 1, 7, 61, 255 };
+    char name[64];
+
+    for (size_t i = 0; i < sizeof(in); i++) in[i] = i;
+
+    cbuf_init(&cbuf, cbuf_memory, sizeof(cbuf_memory));
+    spsc_init(&spsc, spsc_memory, sizeof(spsc_memory));
+
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        chunk = chunks[i];
+
+        snprintf(name, sizeof(name), "cbuf_t put/get, %zu-byte chunks", chunk);
+        bench_print(name, bench_run(run_cbuf, FIFO_BYTES), "byte");
+        if (memcmp(in, out, chunk) != 0) corrupted++;
+
+        memset(out, 0, sizeof(out));
+        snprintf(name, sizeof(name), "spsc_t put/get, %zu-byte chunks", chunk);
+        bench_print(name, bench_run(run_spsc, FIFO_BYTES), "byte");
+        if (memcmp(in, out, chunk) != 0) corrupted++;
+    }
+
+    if (corrupted) {
+        printf("FAIL: %lu short or corrupted transfers\n", corrupted);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,161 @@
+// Round-trip test of the COBS frame encoder and decoder in src/frame.c
+//
+// Every frame is encoded with frame_encode, fed byte by byte to frame_decode,
+// and compared with the original. The frames cover all lengths up to
+// FRAME_MAX_SIZE with a zero byte at every position, so that blocks of 253,
+// 254, and 255 bytes and zero bytes right after a full 254-byte block are all
+// exercised.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frame.h"
+
+// The largest frame sans CRC accepted by the decoder
+#define MAX_LENGTH (FRAME_MAX_SIZE - FRAME_CRC_SIZE)
+
+// The worst-case size of an encoded frame: one code byte per 254 data bytes,
+// an empty trailing block, and the terminator
+#define ENCODED_SIZE (FRAME_MAX_SIZE + FRAME_MAX_SIZE / 254 + 2)
+
+
+static struct {
+    uint8_t buffer[ENCODED_SIZE];
+    size_t length;
+    bool overflow;
+} encoded;
+
+static unsigned int failures, frames;
+
+
+static void write(const char *buffer, size_t length)
+{
+    if (encoded.length + length > sizeof(encoded.buffer)) {
+        encoded.overflow = true;
+        return;
+    }
+    memcpy(encoded.buffer + encoded.length, buffer, length);
+    encoded.length += length;
+}
+
+
+static void fail(const char *what, const uint8_t *frame, size_t length)
+{
+    size_t i;
+
+    failures++;
+    printf("FAIL: %s (length %zu, zeros at", what, length);
+    for (i = 0; i < length + FRAME_CRC_SIZE; i++)
+        if (frame[i] == 0) printf(" %zu", i);
+    printf(")\n");
+}
+
+
+static void round_trip(const uint8_t *frame, size_t length)
+{
+    uint8_t copy[FRAME_MAX_SIZE], decoded[FRAME_MAX_SIZE];
+    frame_decoder_t decoder;
+    size_t i;
+    int rc = 0;
+
+    frames++;
+    memcpy(copy, frame, length);
+    encoded.length = 0;
+    encoded.overflow = false;
+    frame_encode(copy, length, write);
+
+    if (encoded.overflow) {
+        fail("encoded frame too long", copy, length);
+        return;
+    }
+
+    if (encoded.length == 0 || encoded.buffer[encoded.length - 1] != 0) {
+        fail("missing terminator", copy, length);
+        return;
+    }
+
+    if (memchr(encoded.buffer, 0, encoded.length - 1) != NULL) {
+        fail("zero byte inside encoded frame", copy, length);
+        return;
+    }
+
+    frame_decoder_init(&decoder, decoded, sizeof(decoded));
+    for (i = 0; i < encoded.length; i++) {
+        rc = frame_decode(&decoder, encoded.buffer[i]);
+        if (rc != 0 && i != encoded.length - 1) {
+            fail("frame decoded before terminator", copy, length);
+            return;
+        }
+    }
+
+    if (rc != (int)length) {
+        fail(rc < 0 ? "decoder rejected frame" : "decoded length mismatch", copy, length);
+        return;
+    }
+
+    if (memcmp(decoded, frame, length) != 0)
+        fail("decoded frame differs", copy, length);
+}
+
+
+// Modify the sequence number and the following byte until the given CRC byte
+// becomes zero. This puts a zero byte right after the data, e.g., right after
+// a full 254-byte block.
+static bool zero_crc_byte(uint8_t *frame, size_t length, unsigned int which)
+{
+    uint16_t crc;
+
+    for (unsigned int i = 0; i < 255 * 255; i++) {
+        frame[1] = i % 255 + 1;
+        frame[2] = i / 255 + 1;
+        crc = frame_crc16(frame, length);
+        if (((which ? crc >> 8 : crc) & 0xff) == 0) return true;
+    }
+    return false;
+}
+
+
+int main(void)
+{
+    uint8_t frame[FRAME_MAX_SIZE];
+    size_t length, zero;
+    unsigned int which;
+
+    for (length = FRAME_HEADER_SIZE; length <= MAX_LENGTH; length++) {
+        // No zero bytes except possibly in the CRC
+        memset(frame, 0x55, length);
+        round_trip(frame, length);
+
+        // All zero bytes
+        memset(frame, 0, length);
+        round_trip(frame, length);
+
+        // A single zero byte at every position
+        for (zero = 0; zero < length; zero++) {
+            memset(frame, 0x55, length);
+            frame[zero] = 0;
+            round_trip(frame, length);
+        }
+
+        // A zero byte in the CRC that follows the data. With 253 and 254
+        // bytes of data, this is a zero byte right after a full block.
+        for (which = 0; which < FRAME_CRC_SIZE; which++) {
+            memset(frame, 0x55, length);
+            if (length > FRAME_HEADER_SIZE && zero_crc_byte(frame, length, which))
+                round_trip(frame, length);
+        }
+    }
+
+    // Make sure that the loop above did produce a zero byte at offset 254,
+    // right after a full block, in frames of 255 and 256 bytes with the CRC.
+    for (length = 253; length <= MAX_LENGTH; length++) {
+        memset(frame, 0x55, length);
+        if (!zero_crc_byte(frame, length, 254 - length)) {
+            printf("FAIL: no CRC with a zero byte at offset 254 (length %zu)\n", length);
+            failures++;
+        }
+    }
+
+    printf("%u frames, %u failures\n", frames, failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,287 @@
+// Tests of the AT command interface in src/atci.c
+//
+// The module is included directly so that the tests can inspect its state.
+// The LPUART is replaced with stubs around the two FIFOs. The tests feed input
+// into the RX FIFO, run atci_process as the main loop would, and transmit the
+// content of the TX FIFO at a limited rate, as a slow UART would.
+
+#include "atci.c"
+
+#include <stdlib.h>
+
+
+volatile uint32_t host_primask;
+volatile unsigned system_sleep_lock;
+
+static uint8_t rx_buffer[1024], tx_buffer[512];
+volatile spsc_t lpuart_rx_fifo, lpuart_tx_fifo;
+
+// The number of times the ATCI waited for the LPUART
+static unsigned int waits;
+
+// Set to simulate an RX FIFO overrun
+static bool overrun;
+
+static char sent[8192];
+static size_t sent_length;
+
+static unsigned int failures;
+
+
+// Move up to max bytes from the TX FIFO into the sent buffer
+static void transmit(size_t max)
+{
+    size_t n = sizeof(sent) - sent_length;
+    if (n > max) n = max;
+    sent_length += spsc_get(&lpuart_tx_fifo, sent + sent_length, n);
+}
+
+void lpuart_init(unsigned int baudrate, bool flow_control)
+{
+    (void)baudrate;
+    (void)flow_control;
+    spsc_init(&lpuart_rx_fifo, rx_buffer, sizeof(rx_buffer));
+    spsc_init(&lpuart_tx_fifo, tx_buffer, sizeof(tx_buffer));
+}
+
+size_t lpuart_write(const char *buffer, size_t length) { return spsc_put(&lpuart_tx_fifo, buffer, length); }
+size_t lpuart_produce(size_t length) { return spsc_produce(&lpuart_tx_fifo, length); }
+void lpuart_consume(size_t length) { spsc_consume(&lpuart_rx_fifo, length); }
+void lpuart_flush(void) { transmit(SIZE_MAX); }
+void lpuart_resume_tx(void) { }
+bool lpuart_is_tx_paused(void) { return false; }
+
+bool lpuart_rx_overrun(void)
+{
+    bool rv = overrun;
+    overrun = false;
+    return rv;
+}
+
+void lpuart_wait_tx_space(size_t length)
+{
+    (void)length;
+    waits++;
+    transmit(SIZE_MAX);
+}
+
+__attribute__((noreturn)) void halt(const char *msg)
+{
+    fprintf(stderr, "halt: %s\n", msg);
+    exit(EXIT_FAILURE);
+}
+
+
+// The command names from the table in src/cmd.c, in table order
+static const char *names[] = {
+    "+UART", "+VER", "+DEV", "+REBOOT", "+FACNEW", "+BAND", "+CLASS", "+MODE",
+    "+DEVADDR", "+DEVEUI", "+APPEUI", "+NWKSKEY", "+APPSKEY", "+APPKEY",
+    "+JOIN", "+JOINDC", "+LNCHECK", "+RFPARAM", "+RFPOWER", "+NWK", "+ADR",
+    "+DR", "+DELAY", "+ADRACK", "+RX2", "+DUTYCYCLE", "+SLEEP", "+PORT",
+    "+REP", "+DFORMAT", "+TO", "+UTX", "+CTX", "+MCAST", "+PUTX", "+PCTX",
+    "+FRMCNT", "+MSIZE", "+RFQ", "+DWELL", "+MAXEIRP", "+RSSITH", "+CST",
+    "+BACKOFF", "+CHMASK", "+RTYNUM", "+NETID", "$VER", "$DBG", "$HALT",
+    "$JOINEUI", "$NWKKEY", "$APPKEY", "$FNWKSINTKEY", "$SNWKSINTKEY",
+    "$NWKSENCKEY", "$CHMASK", "$RX2", "$DR", "$RFPOWER", "$PAUSE", "$LOGLEVEL",
+    "$LOGMOD", "$SESSION", "$CERT", "$CW", "$CM", "$NVM", "$LOCKKEYS", "$DETACH",
+    "$TIME", "$DEVTIME", "$DEVNONCE", "$MCUID", "$STOPONERR", "$UARTSTATS",
+    "$LOGDUMP", "$NVMSTATS", "+CLAC", "$HELP", "$FRAMED"
+};
+
+#define NAMES (sizeof(names) / sizeof(names[0]))
+
+static atci_command_t commands[NAMES];
+
+static const char hint[] = "A hint about as long as those in src/cmd.c";
+
+
+static void get_version(void)
+{
+    atci_print("+OK=1.0.0" ATCI_EOL);
+}
+
+
+static void check(bool condition, const char *what)
+{
+    if (condition) return;
+    printf("FAIL: %s\n", what);
+    failures++;
+}
+
+
+static void input(const char *data, size_t length)
+{
+    spsc_put(&lpuart_rx_fifo, data, length);
+}
+
+
+// Send a line to the ATCI and run the main loop until all output has been
+// transmitted, up to 64 bytes per iteration
+static void run(const char *line)
+{
+    waits = 0;
+    sent_length = 0;
+    input(line, strlen(line));
+
+    do {
+        atci_process();
+        transmit(64);
+    } while (state.output.count || spsc_length(&lpuart_tx_fifo));
+}
+
+
+static void test_listing(void)
+{
+    static char expected[sizeof(sent)];
+    size_t n = 0, i;
+
+    for (i = 0; i < NAMES; i++)
+        n += sprintf(expected + n, "AT%s %s\r\n", names[i], hint);
+    n += sprintf(expected + n, "%s", ATCI_OK);
+    check(n > sizeof(tx_buffer) + ATCI_OUTPUT_QUEUE_SIZE, "AT$HELP output fits into the buffers");
+
+    run("AT$HELP\r");
+    check(waits == 0, "AT$HELP waited for the LPUART");
+    check(sent_length == n && !memcmp(sent, expected, n), "AT$HELP output differs");
+
+    // The output of the next command on the line follows the listing
+    for (i = 0, n = 0; i < NAMES; i++)
+        n += sprintf(expected + n, "AT%s\r\n", names[i]);
+    n += sprintf(expected + n, "%s+OK=1.0.0" ATCI_EOL, ATCI_OK);
+
+    run("AT+CLAC;+VER?\r");
+    check(waits == 0, "AT+CLAC waited for the LPUART");
+    check(sent_length == n && !memcmp(sent, expected, n), "AT+CLAC;+VER? output differs");
+}
+
+
+// A stand-in for AT+UTX <length>: read the payload and print +OK
+static char payload[16];
+static atci_data_status_t payload_status;
+
+static void payload_received(atci_data_status_t status, atci_param_t *param)
+{
+    payload_status = status;
+    snprintf(payload, sizeof(payload), "%.*s", (int)param->length, param->txt);
+    if (status == ATCI_DATA_OK) atci_print(ATCI_OK);
+    else atci_error(-2);
+}
+
+static void utx(atci_param_t *param)
+{
+    uint32_t length;
+
+    if (!atci_param_get_uint(param, &length)
+        || !atci_set_read_next_data(length, ATCI_ENCODING_BIN, payload_received))
+        atci_error(-2);
+}
+
+
+static void send_frame(uint8_t type, uint8_t seq, uint8_t tag, const char *value)
+{
+    uint8_t f[FRAME_MAX_SIZE];
+    size_t n = strlen(value);
+
+    f[0] = type;
+    f[1] = seq;
+    f[2] = tag;
+    f[3] = n;
+    memcpy(f + 4, value, n);
+    frame_encode(f, 4 + n, input);
+    run("");
+}
+
+
+// Decode the frames sent by the ATCI and return the type of the one with the
+// given sequence number, or 0 if there is none
+static uint8_t find_frame(uint8_t seq)
+{
+    uint8_t f[FRAME_MAX_SIZE];
+    frame_decoder_t decoder;
+    int rc;
+
+    frame_decoder_init(&decoder, f, sizeof(f));
+    for (size_t i = 0; i < sent_length; i++) {
+        rc = frame_decode(&decoder, sent[i]);
+        if (rc >= FRAME_HEADER_SIZE && f[0] != FRAME_EVENT && f[1] == seq) return f[0];
+    }
+    return 0;
+}
+
+
+static void test_framed_command_during_read(void)
+{
+    run("AT$FRAMED\r");
+    check(state.frame.enabled, "AT$FRAMED failed");
+
+    send_frame(FRAME_COMMAND, 1, FRAME_TAG_TEXT, "AT+UTX 4");
+    check(state.read_next_data.length == 4, "AT+UTX did not start a read");
+
+    send_frame(FRAME_DATA, 2, FRAME_TAG_DATA, "ab");
+    check(state.rx_length == 2, "the first DATA frame was not received");
+
+    // A command in the middle of the payload is rejected and leaves the
+    // payload intact
+    send_frame(FRAME_COMMAND, 3, FRAME_TAG_TEXT, "AT+VER?");
+    check(find_frame(3) == FRAME_NAK, "COMMAND during a read was not NAKed");
+    check(state.read_next_data.length == 4 && state.rx_length == 2,
+        "COMMAND during a read changed the payload state");
+
+    send_frame(FRAME_DATA, 4, FRAME_TAG_DATA, "cd");
+    check(find_frame(4) == FRAME_RESPONSE, "no response to the last DATA frame");
+    check(payload_status == ATCI_DATA_OK && !strcmp(payload, "abcd"), "payload corrupted");
+
+    // Commands are accepted again once the payload is complete
+    send_frame(FRAME_COMMAND, 5, FRAME_TAG_TEXT, "AT+VER?");
+    check(find_frame(5) == FRAME_RESPONSE, "COMMAND after the read was not executed");
+
+    send_frame(FRAME_EXIT, 6, FRAME_TAG_TEXT, "");
+    check(!state.frame.enabled, "EXIT frame did not leave framed mode");
+}
+
+
+static void test_overrun(void)
+{
+    // An overrun in the middle of a payload fails the read
+    run("AT+UTX 4\r");
+    run("ab");
+    overrun = true;
+    run("cd");
+    check(payload_status == ATCI_DATA_OVERRUN, "overrun did not fail the payload read");
+    check(state.read_next_data.length == 0, "overrun left the read pending");
+    check(sent_length == strlen("+ERR=-2" ATCI_EOL) && !memcmp(sent, "+ERR=-2" ATCI_EOL, sent_length),
+        "no error response to the overrun payload");
+
+    run("AT+VER?\r");
+    check(sent_length == strlen("+OK=1.0.0" ATCI_EOL), "no response to the command after the overrun");
+
+    // An overrun in the middle of a command line fails the line
+    run("AT+VE");
+    overrun = true;
+    run("R?\r");
+    check(sent_length == ATCI_UKNOWN_CMD_LEN && !memcmp(sent, ATCI_UNKNOWN_CMD, sent_length),
+        "overrun did not fail the command line");
+}
+
+
+int main(void)
+{
+    for (size_t i = 0; i < NAMES; i++) {
+        commands[i].command = names[i];
+        commands[i].hint = hint;
+    }
+    commands[1].read = get_version;
+    commands[31].action = utx;
+    commands[NAMES - 3].action = atci_clac_action;
+    commands[NAMES - 2].action = atci_help_action;
+    commands[NAMES - 1].action = atci_framed_action;
+
+    atci_init(DEFAULT_UART_BAUDRATE, false, commands, NAMES);
+
+    test_listing();
+    test_framed_command_during_read();
+    test_overrun();
+
+    printf("%u failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+// Test of the virtual-time RTC in src/host/rtc.c
+//
+// With LORA_MODEM_CLOCK=virtual, the clock stands still while the firmware
+// runs and jumps to the next alarm once the firmware is idle. The test drives
+// the timer server from lib/LoRaWAN the way system_idle does and checks that
+// timers fire in deadline order, at their deadlines in virtual time, and
+// without waiting in wall-clock time.
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "rtc.h"
+#include "host/host.h"
+#include "system.h"
+
+
+volatile uint32_t host_primask;
+volatile unsigned system_stop_lock;
+
+#define MAX_EVENTS 16
+
+static struct {
+    int id;
+    TimerTime_t time;
+} fired[MAX_EVENTS];
+
+static size_t events;
+static unsigned int failures;
+
+static TimerEvent_t timers[6];
+static int repeats;
+
+
+static void check(bool condition, const char *what)
+{
+    if (condition) return;
+    printf("FAIL: %s\n", what);
+    failures++;
+}
+
+
+static void callback(void *context)
+{
+    int id = (int)(intptr_t)context;
+
+    if (events < MAX_EVENTS) {
+        fired[events].id = id;
+        fired[events].time = TimerGetCurrentTime();
+    }
+    events++;
+
+    // Timer 4 restarts itself twice, like the periodic timers in LoRaMac
+    if (id == 4 && ++repeats < 3) TimerStart(&timers[4]);
+
+    // Timer 1 starts timer 5 with a deadline before the pending ones
+    if (id == 1) {
+        TimerSetValue(&timers[5], 10);
+        TimerStart(&timers[5]);
+    }
+}
+
+
+static void start(int id, uint32_t timeout)
+{
+    TimerInit(&timers[id], callback);
+    TimerSetContext(&timers[id], (void *)(intptr_t)id);
+    TimerSetValue(&timers[id], timeout);
+    TimerStart(&timers[id]);
+}
+
+
+// The part of system_idle that concerns the RTC, with no other input pending
+static void idle(void)
+{
+    rtc_host_skip_to_alarm();
+    rtc_host_service();
+}
+
+
+int main(void)
+{
+    struct timespec t0, t1;
+    TimerTime_t base, delay;
+    size_t i;
+
+    // The deadlines in milliseconds since base and the expected order of the
+    // callbacks. Timer 5 is started by timer 1, timer 4 fires three times.
+    static const struct { int id; TimerTime_t at; } expected[] = {
+        { 1, 100 }, { 5, 110 }, { 2, 2500 }, { 4, 3000 }, { 4, 6000 },
+        { 3, 7000 }, { 4, 9000 }, { 0, 86400000 }
+    };
+    const size_t n = sizeof(expected) / sizeof(expected[0]);
+
+    setenv(HOST_ENV_CLOCK, "virtual", 1);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    rtc_init();
+
+    check(rtc_host_virtual_time(), "virtual time not enabled");
+
+    // Virtual time does not advance on its own
+    base = TimerGetCurrentTime();
+    for (i = 0; i < 1000; i++) rtc_get_timer_value();
+    check(TimerGetCurrentTime() == base, "virtual time advanced while busy");
+
+    // Started out of order, one day apart at most. Timer 5 is only started
+    // from the callback of timer 1.
+    TimerInit(&timers[5], callback);
+    TimerSetContext(&timers[5], (void *)5);
+    start(0, 86400000);
+    start(3, 7000);
+    start(1, 100);
+    start(4, 3000);
+    start(2, 2500);
+
+    for (i = 0; i < 100 && events < n; i++) idle();
+
+    check(events == n, "wrong number of timer callbacks");
+    for (i = 0; i < n && i < events; i++) {
+        if (fired[i].id != expected[i].id) {
+            printf("FAIL: callback %zu: timer %d instead of %d\n", i, fired[i].id, expected[i].id);
+            failures++;
+        }
+
+        // The tick is 1/1024 s, allow for the rounding of the timeout
+        delay = fired[i].time - base;
+        if (delay + 2 < expected[i].at || delay > expected[i].at + 2) {
+            printf("FAIL: timer %d fired at %lu ms instead of %lu ms\n", fired[i].id,
+                (unsigned long)delay, (unsigned long)expected[i].at);
+            failures++;
+        }
+    }
+
+    // No alarm is left, idling does not move the clock
+    base = TimerGetCurrentTime();
+    idle();
+    check(TimerGetCurrentTime() == base, "virtual time advanced without an alarm");
+
+    // Delays advance virtual time without sleeping
+    rtc_delay_ms(60000);
+    delay = TimerGetCurrentTime() - base;
+    check(delay + 1 >= 60000 && delay <= 60000, "rtc_delay_ms did not advance virtual time");
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    check(t1.tv_sec - t0.tv_sec < 2, "virtual time waited in wall-clock time");
+
+    printf("%zu timer callbacks, %u failures\n", events, failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}